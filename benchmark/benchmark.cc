@@ -0,0 +1,193 @@
+#include <base/log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "uvc/v4l2_core.h"
+#include "uvc/v4l2_define.h"
+#include "uvc/v4l2_device.h"
+#include "uvc/v4l2_fake_backend.h"
+
+/*
+ * frames captured before the measure starts (stream warm up)
+ */
+#define WARMUP_FRAMES 30
+
+/*
+ * per frame cost of one i/o mode
+ */
+struct BenchmarkResult {
+    int pixel_format;      //negotiated pixel format
+    uint64_t frames;       //measured frames
+    uint64_t cpu_ns;       //process cpu time spent over the frames
+    uint64_t wall_ns;      //wall time spent over the frames
+    uint64_t frame_bytes;  //total bytes delivered
+};
+
+static uint64_t clock_ns(clockid_t clock_id) {
+    struct timespec now;
+    clock_gettime(clock_id, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/*
+ * capture frames through one i/o mode
+ * args:
+ *   device - device to open
+ *   options - init options (i/o mode)
+ *   width - frame width
+ *   height - frame height
+ *   pixelformat - v4l2 pixel format
+ *   frames - number of frames to measure
+ *   result - pointer to the returned result
+ *
+ * returns: error code (E_OK)
+ */
+static int run_benchmark(const char *device, const uvc::V4L2InitOptions &options, int width,
+                         int height, int pixelformat, uint64_t frames, BenchmarkResult *result) {
+    uvc::V4L2Context *context = uvc::v4l2core_init_dev(device, options);
+    if (context == NULL) {
+        return E_DEVICE_ERR;
+    }
+
+    int ret = uvc::set_video_stream_format(context, width, height, pixelformat);
+    if (ret == E_OK) {
+        ret = uvc::v4l2core_start_stream(context);
+    }
+    result->pixel_format = context->format.fmt.pix.pixelformat;
+    result->frames = 0;
+    result->frame_bytes = 0;
+
+    uint64_t captured = 0;
+    uint64_t cpu_start = 0;
+    uint64_t wall_start = 0;
+    while (ret == E_OK && captured < frames + WARMUP_FRAMES) {
+        uvc::V4L2FrameBuff *frame = NULL;
+        ret = uvc::v4l2core_get_frame(context, 1000, &frame);
+        if (ret == E_NO_DATA) {
+            ret = E_OK;
+            continue;
+        } else if (ret != E_OK) {
+            base::LogError() << "get frame failed " << ret;
+            break;
+        }
+        if (captured >= WARMUP_FRAMES) {
+            result->frame_bytes += frame->raw_frame_size;
+        }
+        uvc::v4l2core_release_frame(context, frame);
+
+        captured++;
+        if (captured == WARMUP_FRAMES) {
+            cpu_start = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+            wall_start = clock_ns(CLOCK_MONOTONIC);
+        }
+    }
+    if (captured > WARMUP_FRAMES) {
+        result->frames = captured - WARMUP_FRAMES;
+        result->cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+        result->wall_ns = clock_ns(CLOCK_MONOTONIC) - wall_start;
+    }
+
+    uvc::v4l2core_stop_stream(context);
+    uvc::v4l2core_close_dev(context);
+    return ret;
+}
+
+static void print_result(const char *name, const BenchmarkResult &result) {
+    if (result.frames == 0) {
+        printf("%-8s no frames\n", name);
+        return;
+    }
+    printf("%-8s %c%c%c%c %8.1f us cpu/frame %8.2f ms/frame %10llu bytes/frame\n", name,
+           result.pixel_format & 0xFF, (result.pixel_format >> 8) & 0xFF,
+           (result.pixel_format >> 16) & 0xFF, (result.pixel_format >> 24) & 0xFF,
+           result.cpu_ns / 1000.0 / result.frames, result.wall_ns / 1000000.0 / result.frames,
+           (unsigned long long)(result.frame_bytes / result.frames));
+}
+
+/*
+ * load test the capture loop on the fake device (no camera needed)
+ */
+static int run_fake_benchmark(int width, int height, int pixelformat, uint64_t frames) {
+    uvc::V4L2FakeConfig config;
+    config.frame_rate = 1000;
+    uvc::V4L2FakeBackend fake_backend(config);
+
+    uvc::V4L2InitOptions options;
+    options.lazy_formats = 1;
+    options.backend = &fake_backend;
+
+    BenchmarkResult result = {};
+    int ret = run_benchmark("fake", options, width, height, pixelformat, frames, &result);
+    print_result("fake", result);
+    printf("%.0f fps, %llu frames dropped by the fake device\n",
+           result.wall_ns > 0 ? result.frames * 1e9 / result.wall_ns : 0.0,
+           (unsigned long long)fake_backend.get_dropped_frames());
+    return ret == E_OK ? 0 : 1;
+}
+
+/*
+ * compare the per frame cpu cost of libv4l2 and direct i/o
+ * usage: benchmark [fake] [width height [fourcc [frames]]]
+ */
+int main(int argc, const char *argv[]) {
+    bool fake = argc > 1 && strcmp(argv[1], "fake") == 0;
+    if (fake) {
+        argc--;
+        argv++;
+    }
+
+    int width = argc > 2 ? atoi(argv[1]) : 1280;
+    int height = argc > 2 ? atoi(argv[2]) : 720;
+    int pixelformat = V4L2_PIX_FMT_MJPEG;
+    if (argc > 3) {
+        const char *fourcc = argv[3];
+        pixelformat = v4l2_fourcc(fourcc[0], fourcc[1], fourcc[2], fourcc[3]);
+    }
+    uint64_t frames = argc > 4 ? strtoull(argv[4], NULL, 10) : 300;
+
+    if (fake) {
+        return run_fake_benchmark(width, height, pixelformat, frames);
+    }
+
+    uvc::V4l2Device device;
+    device.init_device_list();
+    if (device.get_device_count() <= 0) {
+        base::LogError() << "no capture device";
+        device.free_device_list();
+        return 1;
+    }
+
+    auto device_sys_data = device.get_device_sys_data(0);
+    printf("%s %dx%d, %llu frames\n", device_sys_data.device.c_str(), width, height,
+           (unsigned long long)frames);
+
+    uvc::V4L2InitOptions options;
+    options.lazy_formats = 1;
+    BenchmarkResult libv4l2_result = {};
+    BenchmarkResult direct_result = {};
+    options.direct_io = 0;
+    run_benchmark(device_sys_data.device.c_str(), options, width, height, pixelformat, frames,
+                  &libv4l2_result);
+    options.direct_io = 1;
+    run_benchmark(device_sys_data.device.c_str(), options, width, height, pixelformat, frames,
+                  &direct_result);
+    print_result("libv4l2", libv4l2_result);
+    print_result("direct", direct_result);
+
+    /*
+     * libv4l2 emulates the formats the device lacks: the driver (direct)
+     * then negotiates another format and libv4l2 converts every frame
+     */
+    if (libv4l2_result.frames > 0 && direct_result.frames > 0) {
+        if (libv4l2_result.pixel_format == direct_result.pixel_format) {
+            printf("same native format, no libv4l2 conversion\n");
+        } else {
+            printf("libv4l2 converts the frames\n");
+        }
+    }
+
+    device.free_device_list();
+    return 0;
+}
\ No newline at end of file
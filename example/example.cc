@@ -1,7 +1,5 @@
 #include <base/log.h>
 
-#include <thread>
-
 #include "uvc/v4l2_core.h"
 #include "uvc/v4l2_define.h"
 #include "uvc/v4l2_device.h"
@@ -19,8 +17,19 @@ int main(int argc, const char *argv[]) {
         set_video_stream_format(context, 640, 480, V4L2_PIX_FMT_MJPEG);
         ret = v4l2core_start_stream(context);
         while (true) {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+            uvc::V4L2FrameBuff *frame = NULL;
+            ret = uvc::v4l2core_get_frame(context, 1000, &frame);
+            if (ret == E_SELECT_TIMEOUT_ERR || ret == E_NO_DATA) {
+                continue;
+            } else if (ret != E_OK) {
+                base::LogError() << "get frame failed " << ret;
+                break;
+            }
+            base::LogDebug() << "frame " << frame->index << " size " << frame->raw_frame_size
+                             << " timestamp " << frame->timestamp;
+            uvc::v4l2core_release_frame(context, frame);
         }
+        uvc::v4l2core_close_dev(context);
     }
     device.free_device_list();
     return 0;
@@ -0,0 +1,131 @@
+#include <linux/videodev2.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "uvc/v4l2_convert.h"
+#include "uvc/v4l2_define.h"
+
+/*
+ * every simd kernel must give the scalar reference output byte for byte
+ *
+ * the widths cover the vector tails (not a multiple of 16 or 32 pixels,
+ * odd chroma widths), the heights an odd last line pair, and a padded
+ * line stride; a kernel the cpu lacks is skipped
+ */
+
+static const int SIMD_LEVELS[] = {CONVERT_SSE41, CONVERT_AVX2, CONVERT_NEON};
+static const char *SIMD_NAMES[] = {"SSE4.1", "AVX2", "NEON"};
+
+static const uint32_t IN_FORMATS[] = {V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_UYVY, V4L2_PIX_FMT_YVYU,
+                                      V4L2_PIX_FMT_VYUY};
+static const uint32_t OUT_FORMATS[] = {V4L2_PIX_FMT_YUV420, V4L2_PIX_FMT_NV12};
+
+static const int WIDTHS[] = {2, 6, 14, 16, 18, 30, 32, 34, 46, 62, 66, 94, 130, 642};
+static const int HEIGHTS[] = {1, 2, 3, 5, 7, 8, 17};
+static const uint32_t STRIDE_PADDINGS[] = {0, 6};
+
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+
+/*
+ * convert a frame with one kernel and compare it to the scalar output
+ * args:
+ *   level - CONVERT_* kernel
+ *   in - packed input frame
+ *   bytesperline - input line stride
+ *   in_format - packed 4:2:2 pixel format
+ *   width - frame width
+ *   height - frame height
+ *   out_format - V4L2_PIX_FMT_YUV420 or V4L2_PIX_FMT_NV12
+ *   reference - scalar output
+ *
+ * returns: 1 if the outputs match, 0 otherwise
+ */
+static int check_level(int level, const uint8_t *in, uint32_t bytesperline, uint32_t in_format,
+                       int width, int height, uint32_t out_format,
+                       const std::vector<uint8_t> &reference) {
+    /*a kernel that skips a byte leaves the fill pattern behind*/
+    std::vector<uint8_t> out(reference.size(), 0xA5);
+    int ret = uvc::convert_packed422_level(level, in, bytesperline, in_format, width, height,
+                                           out.data(), out_format);
+    if (ret != E_OK) {
+        printf("level %d: %dx%d stride %u returned %d\n", level, width, height, bytesperline, ret);
+        return 0;
+    }
+    for (size_t i = 0; i < out.size(); i++) {
+        if (out[i] != reference[i]) {
+            printf("level %d: %.4s -> %.4s %dx%d stride %u differs at byte %zu (%d, scalar %d)\n",
+                   level, (const char *)&in_format, (const char *)&out_format, width, height,
+                   bytesperline, i, out[i], reference[i]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main() {
+    srand(1);
+    int checks = 0;
+    int failures = 0;
+
+    std::vector<int> levels;
+    for (size_t i = 0; i < ARRAY_SIZE(SIMD_LEVELS); i++) {
+        std::vector<uint8_t> in(4), out(uvc::yuv420_frame_size(2, 1));
+        int ret = uvc::convert_packed422_level(SIMD_LEVELS[i], in.data(), 0, V4L2_PIX_FMT_YUYV, 2,
+                                               1, out.data(), V4L2_PIX_FMT_YUV420);
+        printf("%s: %s\n", SIMD_NAMES[i], ret == E_NO_CODEC ? "not supported, skipped" : "checked");
+        if (ret != E_NO_CODEC) {
+            levels.push_back(SIMD_LEVELS[i]);
+        }
+    }
+
+    for (uint32_t in_format : IN_FORMATS) {
+        for (uint32_t out_format : OUT_FORMATS) {
+            for (int width : WIDTHS) {
+                for (int height : HEIGHTS) {
+                    for (uint32_t padding : STRIDE_PADDINGS) {
+                        uint32_t bytesperline = width * 2 + padding;
+                        std::vector<uint8_t> in((size_t)bytesperline * height);
+                        for (uint8_t &byte : in) {
+                            byte = rand();
+                        }
+
+                        std::vector<uint8_t> reference(uvc::yuv420_frame_size(width, height));
+                        int ret = uvc::convert_packed422_level(
+                            CONVERT_SCALAR, in.data(), bytesperline, in_format, width, height,
+                            reference.data(), out_format);
+                        if (ret != E_OK) {
+                            printf("scalar: %dx%d returned %d\n", width, height, ret);
+                            failures++;
+                            continue;
+                        }
+
+                        for (int level : levels) {
+                            checks++;
+                            if (!check_level(level, in.data(), bytesperline, in_format, width,
+                                             height, out_format, reference)) {
+                                failures++;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /*an odd pixel width splits a 4:2:2 pair, every kernel refuses it*/
+    std::vector<uint8_t> in(64 * 2 * 4), out(uvc::yuv420_frame_size(64, 4));
+    for (int level = CONVERT_SCALAR; level <= CONVERT_NEON; level++) {
+        int ret = uvc::convert_packed422_level(level, in.data(), 0, V4L2_PIX_FMT_YUYV, 63, 4,
+                                               out.data(), V4L2_PIX_FMT_YUV420);
+        checks++;
+        if (ret != E_FORMAT_ERR) {
+            printf("level %d: odd width returned %d\n", level, ret);
+            failures++;
+        }
+    }
+
+    printf("convert_test: %d checks, %d failures\n", checks, failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,265 @@
+#include <linux/videodev2.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "test/jpeg_frame.h"
+#include "uvc/v4l2_capture_thread.h"
+#include "uvc/v4l2_core.h"
+#include "uvc/v4l2_define.h"
+#include "uvc/v4l2_fake_backend.h"
+
+/*
+ * capture paths on the fake camera (no device needed): frame leases,
+ * sequence and drop counting, buffer pool growth, a format switch while
+ * streaming, the capture thread ring and the decode pool ordering
+ */
+
+/*
+ * generated frames per second (fast enough to keep the test short, slow
+ * enough for a loaded machine to keep up)
+ */
+#define FAKE_FRAME_RATE 200
+
+/*
+ * frames taken in each streaming check
+ */
+#define FAKE_FRAMES 40
+
+static int checks = 0;
+static int failures = 0;
+
+#define CHECK(condition)                                                                   \
+    do {                                                                                   \
+        checks++;                                                                          \
+        if (!(condition)) {                                                                \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);           \
+            failures++;                                                                    \
+        }                                                                                  \
+    } while (0)
+
+/*
+ * get a frame, retrying on the wakeups without data
+ * args:
+ *   context - pointer to V4L2Context
+ *   frame - pointer to the returned frame view
+ *
+ * returns: error code (E_OK or the last v4l2core_get_frame error)
+ */
+static int get_frame(uvc::V4L2Context *context, uvc::V4L2FrameBuff **frame) {
+    int ret = E_NO_DATA;
+    for (int tries = 0; tries < 100 && (ret == E_NO_DATA || ret == E_SELECT_TIMEOUT_ERR);
+         tries++) {
+        ret = uvc::v4l2core_get_frame(context, 1000, frame);
+    }
+    return ret;
+}
+
+/*
+ * a frame is requeued on its last lease only, never twice
+ */
+static void check_leases(uvc::V4L2Context *context) {
+    uvc::V4L2FrameBuff *frame = NULL;
+    CHECK(get_frame(context, &frame) == E_OK);
+    if (frame == NULL) {
+        return;
+    }
+    CHECK(frame->refcount == 1);
+    CHECK(uvc::v4l2core_frame_ref(frame) == frame);
+    CHECK(frame->refcount == 2);
+
+    uint32_t queued = context->queued_buffers;
+    CHECK(uvc::v4l2core_release_frame(context, frame) == E_OK);
+    CHECK(frame->refcount == 1);
+    CHECK(context->queued_buffers == queued);
+
+    CHECK(uvc::v4l2core_release_frame(context, frame) == E_OK);
+    CHECK(frame->refcount == 0);
+    CHECK(context->queued_buffers >= queued);
+
+    /*one release too many is refused and leaves the count alone*/
+    CHECK(uvc::v4l2core_release_frame(context, frame) == E_QBUF_ERR);
+    CHECK(frame->refcount == 0);
+}
+
+/*
+ * frames the driver drops while every buffer is held show up as sequence
+ * gaps and in the dropped frame count
+ */
+static void check_drops(uvc::V4L2Context *context) {
+    /*no growth: holding every buffer must starve the driver*/
+    uvc::v4l2core_set_buffer_count(context, context->requested_buffers, 0);
+
+    std::vector<uvc::V4L2FrameBuff *> held;
+    uvc::V4L2FrameBuff *frame = NULL;
+    CHECK(get_frame(context, &frame) == E_OK);
+    if (frame == NULL) {
+        return;
+    }
+    uint32_t first_sequence = frame->sequence;
+    uint64_t first_dropped = uvc::v4l2core_get_dropped_frames(context);
+    uint64_t first_count = uvc::v4l2core_get_frame_count(context);
+    held.push_back(frame);
+
+    while (held.size() < context->nb_buffers && get_frame(context, &frame) == E_OK) {
+        held.push_back(frame);
+    }
+    CHECK(held.size() == context->nb_buffers);
+    CHECK(context->queued_buffers == 0);
+
+    /*the driver has nowhere to put the next frames*/
+    usleep(20 * 1000000 / FAKE_FRAME_RATE);
+    for (uvc::V4L2FrameBuff *held_frame : held) {
+        CHECK(uvc::v4l2core_release_frame(context, held_frame) == E_OK);
+    }
+
+    uint32_t last_sequence = first_sequence;
+    for (int i = 0; i < FAKE_FRAMES && get_frame(context, &frame) == E_OK; i++) {
+        CHECK(frame->sequence > last_sequence);
+        last_sequence = frame->sequence;
+        uvc::v4l2core_release_frame(context, frame);
+    }
+
+    uint64_t frames = uvc::v4l2core_get_frame_count(context) - first_count + 1;
+    uint64_t dropped = uvc::v4l2core_get_dropped_frames(context) - first_dropped;
+    CHECK(dropped > 0);
+    CHECK(dropped == last_sequence - first_sequence + 1 - frames);
+}
+
+/*
+ * buffers added while streaming are mapped, queued and filled
+ */
+static void check_grow(uvc::V4L2Context *context) {
+    uint32_t nb_buffers = context->nb_buffers;
+    CHECK(uvc::v4l2core_grow_buffers(context, 2) == E_OK);
+    CHECK(context->nb_buffers == nb_buffers + 2);
+    CHECK(context->frame_queue.size() == context->nb_buffers);
+
+    int max_index = -1;
+    uvc::V4L2FrameBuff *frame = NULL;
+    for (int i = 0; i < FAKE_FRAMES && get_frame(context, &frame) == E_OK; i++) {
+        max_index = std::max(max_index, frame->index);
+        uvc::v4l2core_release_frame(context, frame);
+    }
+    CHECK(max_index >= (int)nb_buffers);
+}
+
+/*
+ * a format switch restarts the stream with the new size, a leased frame
+ * blocks it
+ */
+static void check_format_switch(uvc::V4L2Context *context) {
+    uvc::V4L2FrameBuff *frame = NULL;
+    CHECK(get_frame(context, &frame) == E_OK);
+    CHECK(uvc::set_video_stream_format(context, 1280, 720, V4L2_PIX_FMT_YUYV) == E_BUSY_ERR);
+    CHECK(context->streaming == STRM_OK);
+    if (frame != NULL) {
+        uvc::v4l2core_release_frame(context, frame);
+    }
+
+    CHECK(uvc::set_video_stream_format(context, 1280, 720, V4L2_PIX_FMT_YUYV) == E_OK);
+    CHECK(context->streaming == STRM_OK);
+    CHECK(get_frame(context, &frame) == E_OK);
+    if (frame != NULL) {
+        CHECK(frame->width == 1280 && frame->height == 720);
+        CHECK(frame->raw_frame_size == 1280 * 720 * 2);
+        uvc::v4l2core_release_frame(context, frame);
+    }
+}
+
+/*
+ * the capture thread publishes the frames in the ring in sequence order
+ */
+static void check_ring(uvc::V4L2Context *context) {
+    CHECK(uvc::v4l2core_start_capture_thread(context, 8) == E_OK);
+
+    int frames = 0;
+    int64_t last_sequence = -1;
+    uvc::V4L2FrameBuff *frame = NULL;
+    while (frames < FAKE_FRAMES && uvc::v4l2core_get_ring_frame(context, 1000, &frame) == E_OK) {
+        CHECK((int64_t)frame->sequence > last_sequence);
+        last_sequence = frame->sequence;
+        CHECK(uvc::v4l2core_release_frame(context, frame) == E_OK);
+        frames++;
+    }
+    CHECK(frames == FAKE_FRAMES);
+
+    CHECK(uvc::v4l2core_stop_capture_thread(context) == E_OK);
+    CHECK(uvc::v4l2core_get_ring_frame(context, 0, &frame) == E_NO_STREAM_ERR);
+}
+
+/*
+ * the decode pool delivers the MJPEG frames decoded and in dequeue order
+ */
+static void check_decode_pool() {
+    uvc::V4L2FakeConfig config;
+    config.pixel_formats = {V4L2_PIX_FMT_MJPEG};
+    config.sizes = {{JPEG_WIDTH, JPEG_HEIGHT}};
+    config.frame_rate = FAKE_FRAME_RATE;
+    config.mjpeg_frame.assign(JPEG_422, JPEG_422 + sizeof(JPEG_422));
+    uvc::V4L2FakeBackend fake(config);
+
+    uvc::V4L2InitOptions options;
+    options.backend = &fake;
+    uvc::V4L2Context *context = uvc::v4l2core_init_dev("fake0", options);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    CHECK(uvc::set_video_stream_format(context, JPEG_WIDTH, JPEG_HEIGHT, V4L2_PIX_FMT_MJPEG) ==
+          E_OK);
+    CHECK(uvc::v4l2core_start_stream(context) == E_OK);
+    CHECK(uvc::v4l2core_start_decode_pool(context, 3, 6) == E_OK);
+
+    int frames = 0;
+    int64_t last_sequence = -1;
+    uvc::V4L2DecodedFrame *frame = NULL;
+    while (frames < FAKE_FRAMES &&
+           uvc::v4l2core_get_decoded_frame(context, 1000, &frame) == E_OK) {
+        CHECK((int64_t)frame->sequence > last_sequence);
+        last_sequence = frame->sequence;
+        CHECK(frame->status == E_OK);
+        CHECK(frame->width == JPEG_WIDTH && frame->height == JPEG_HEIGHT);
+        CHECK(memcmp(frame->yuv_frame, JPEG_422_I420, sizeof(JPEG_422_I420)) == 0);
+        CHECK(uvc::v4l2core_release_decoded_frame(context, frame) == E_OK);
+        frames++;
+    }
+    CHECK(frames == FAKE_FRAMES);
+
+    CHECK(uvc::v4l2core_stop_decode_pool(context) == E_OK);
+    uvc::v4l2core_close_dev(context);
+}
+
+int main() {
+    uvc::V4L2FakeConfig config;
+    config.frame_rate = FAKE_FRAME_RATE;
+    uvc::V4L2FakeBackend fake(config);
+
+    uvc::V4L2InitOptions options;
+    options.backend = &fake;
+    uvc::V4L2Context *context = uvc::v4l2core_init_dev("fake0", options);
+    CHECK(context != NULL);
+    if (context != NULL) {
+        /*room in the buffer tables for check_grow*/
+        CHECK(uvc::v4l2core_set_buffer_count(context, 4, 8) == E_OK);
+        CHECK(uvc::set_video_stream_format(context, 640, 480, V4L2_PIX_FMT_YUYV) == E_OK);
+        CHECK(uvc::v4l2core_start_stream(context) == E_OK);
+
+        check_leases(context);
+        check_grow(context);
+        check_drops(context);
+        check_format_switch(context);
+        check_ring(context);
+
+        uvc::v4l2core_stop_stream(context);
+        uvc::v4l2core_close_dev(context);
+    }
+
+    check_decode_pool();
+
+    printf("fake_test: %d checks, %d failures\n", checks, failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
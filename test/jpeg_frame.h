@@ -0,0 +1,225 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * known baseline jpeg frame shared by the tests
+ *
+ * a 32x16 4:2:2 frame encoded by libjpeg (quality 75, once without and
+ * once with a restart interval of one MCU); JPEG_422_I420 is the libjpeg
+ * islow decode with the chroma lines averaged in pairs, the output
+ * V4L2JpegDecoder must match exactly
+ */
+
+#define JPEG_WIDTH 32
+#define JPEG_HEIGHT 16
+
+static const uint8_t JPEG_422[] = {
+    0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 0x4a, 0x46, 0x49, 0x46, 0x00, 0x01,
+    0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0xff, 0xdb, 0x00, 0x43,
+    0x00, 0x08, 0x06, 0x06, 0x07, 0x06, 0x05, 0x08, 0x07, 0x07, 0x07, 0x09,
+    0x09, 0x08, 0x0a, 0x0c, 0x14, 0x0d, 0x0c, 0x0b, 0x0b, 0x0c, 0x19, 0x12,
+    0x13, 0x0f, 0x14, 0x1d, 0x1a, 0x1f, 0x1e, 0x1d, 0x1a, 0x1c, 0x1c, 0x20,
+    0x24, 0x2e, 0x27, 0x20, 0x22, 0x2c, 0x23, 0x1c, 0x1c, 0x28, 0x37, 0x29,
+    0x2c, 0x30, 0x31, 0x34, 0x34, 0x34, 0x1f, 0x27, 0x39, 0x3d, 0x38, 0x32,
+    0x3c, 0x2e, 0x33, 0x34, 0x32, 0xff, 0xdb, 0x00, 0x43, 0x01, 0x09, 0x09,
+    0x09, 0x0c, 0x0b, 0x0c, 0x18, 0x0d, 0x0d, 0x18, 0x32, 0x21, 0x1c, 0x21,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0xff, 0xc0, 0x00, 0x11, 0x08, 0x00, 0x10, 0x00, 0x20, 0x03,
+    0x01, 0x21, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01, 0xff, 0xc4, 0x00,
+    0x1f, 0x00, 0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+    0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0xff, 0xc4, 0x00, 0xb5, 0x10, 0x00,
+    0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04, 0x04, 0x00,
+    0x00, 0x01, 0x7d, 0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21,
+    0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81,
+    0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24,
+    0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25,
+    0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a,
+    0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56,
+    0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+    0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86,
+    0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99,
+    0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3,
+    0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6,
+    0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9,
+    0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1,
+    0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xff, 0xc4, 0x00,
+    0x1f, 0x01, 0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+    0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0xff, 0xc4, 0x00, 0xb5, 0x11, 0x00,
+    0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04, 0x00,
+    0x01, 0x02, 0x77, 0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31,
+    0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08,
+    0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15,
+    0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18,
+    0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39,
+    0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55,
+    0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84,
+    0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97,
+    0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa,
+    0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4,
+    0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7,
+    0xd8, 0xd9, 0xda, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
+    0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xff, 0xda, 0x00,
+    0x0c, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11, 0x00, 0x3f, 0x00, 0xf4,
+    0xfb, 0x0b, 0x68, 0x74, 0xab, 0x3c, 0x93, 0xf7, 0x47, 0x5a, 0xe0, 0x3c,
+    0x69, 0xe2, 0xc1, 0x14, 0x72, 0x22, 0x3e, 0x41, 0xf4, 0x3c, 0xd3, 0xe2,
+    0x88, 0xfd, 0x63, 0x36, 0xc2, 0xe0, 0x63, 0xb4, 0x6c, 0x77, 0x4a, 0x6a,
+    0x39, 0xd6, 0x2a, 0xaf, 0x4a, 0x54, 0xad, 0xf8, 0x1e, 0x3b, 0x34, 0xb3,
+    0x6a, 0xb7, 0xbc, 0x13, 0x82, 0xd8, 0x1c, 0x71, 0x5e, 0x97, 0xe0, 0x9f,
+    0x09, 0x6e, 0x29, 0x33, 0xa7, 0x7e, 0x06, 0x0e, 0x3f, 0x3a, 0x38, 0x8a,
+    0x3f, 0x5b, 0xcf, 0xb0, 0xf8, 0x35, 0xb4, 0x6c, 0x78, 0xb4, 0xe8, 0xdf,
+    0x2b, 0xcb, 0xf0, 0xfd, 0x6a, 0x54, 0xe6, 0x7f, 0x79, 0xd6, 0x78, 0xbf,
+    0xc5, 0x09, 0x6f, 0x1c, 0x91, 0xac, 0xb8, 0x23, 0x3f, 0xd6, 0xbc, 0x37,
+    0x55, 0xd4, 0x27, 0xd4, 0xee, 0xf6, 0xab, 0x12, 0x0f, 0xe5, 0x55, 0x81,
+    0x7f, 0x5d, 0xe2, 0x9a, 0x95, 0x5e, 0xaa, 0x06, 0xf5, 0x2b, 0xdf, 0x0d,
+    0x9a, 0x62, 0xff, 0x00, 0x9a, 0x5c, 0xa8, 0xec, 0x7c, 0x19, 0xe1, 0x66,
+    0x9e, 0x54, 0x69, 0x23, 0xf9, 0x47, 0x38, 0xc7, 0x7a, 0xf6, 0xcb, 0x3b,
+    0x28, 0x74, 0xbb, 0x25, 0x24, 0x28, 0x60, 0xbe, 0x9c, 0xd2, 0xc9, 0x9f,
+    0xd7, 0x78, 0x92, 0xb6, 0x25, 0xed, 0x0b, 0x9d, 0xd4, 0xa9, 0x5b, 0x32,
+    0xcb, 0xb0, 0xdd, 0x29, 0xc3, 0x99, 0xfd, 0xc7, 0xff, 0xd9,
+};
+
+static const uint8_t JPEG_422_DRI[] = {
+    0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 0x4a, 0x46, 0x49, 0x46, 0x00, 0x01,
+    0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0xff, 0xdb, 0x00, 0x43,
+    0x00, 0x08, 0x06, 0x06, 0x07, 0x06, 0x05, 0x08, 0x07, 0x07, 0x07, 0x09,
+    0x09, 0x08, 0x0a, 0x0c, 0x14, 0x0d, 0x0c, 0x0b, 0x0b, 0x0c, 0x19, 0x12,
+    0x13, 0x0f, 0x14, 0x1d, 0x1a, 0x1f, 0x1e, 0x1d, 0x1a, 0x1c, 0x1c, 0x20,
+    0x24, 0x2e, 0x27, 0x20, 0x22, 0x2c, 0x23, 0x1c, 0x1c, 0x28, 0x37, 0x29,
+    0x2c, 0x30, 0x31, 0x34, 0x34, 0x34, 0x1f, 0x27, 0x39, 0x3d, 0x38, 0x32,
+    0x3c, 0x2e, 0x33, 0x34, 0x32, 0xff, 0xdb, 0x00, 0x43, 0x01, 0x09, 0x09,
+    0x09, 0x0c, 0x0b, 0x0c, 0x18, 0x0d, 0x0d, 0x18, 0x32, 0x21, 0x1c, 0x21,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0xff, 0xc0, 0x00, 0x11, 0x08, 0x00, 0x10, 0x00, 0x20, 0x03,
+    0x01, 0x21, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01, 0xff, 0xc4, 0x00,
+    0x1f, 0x00, 0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+    0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0xff, 0xc4, 0x00, 0xb5, 0x10, 0x00,
+    0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04, 0x04, 0x00,
+    0x00, 0x01, 0x7d, 0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21,
+    0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81,
+    0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24,
+    0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25,
+    0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a,
+    0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56,
+    0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+    0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86,
+    0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99,
+    0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3,
+    0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6,
+    0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9,
+    0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1,
+    0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xff, 0xc4, 0x00,
+    0x1f, 0x01, 0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+    0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0xff, 0xc4, 0x00, 0xb5, 0x11, 0x00,
+    0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04, 0x00,
+    0x01, 0x02, 0x77, 0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31,
+    0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08,
+    0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15,
+    0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18,
+    0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39,
+    0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55,
+    0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84,
+    0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97,
+    0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa,
+    0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4,
+    0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7,
+    0xd8, 0xd9, 0xda, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
+    0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xff, 0xdd, 0x00,
+    0x04, 0x00, 0x01, 0xff, 0xda, 0x00, 0x0c, 0x03, 0x01, 0x00, 0x02, 0x11,
+    0x03, 0x11, 0x00, 0x3f, 0x00, 0xf4, 0xfb, 0x0b, 0x68, 0x74, 0xab, 0x3c,
+    0x93, 0xf7, 0x47, 0x5a, 0xe0, 0x3c, 0x69, 0xe2, 0xc1, 0x14, 0x72, 0x22,
+    0x3e, 0x41, 0xf4, 0x3c, 0xd3, 0xe2, 0x88, 0xfd, 0x63, 0x36, 0xc2, 0xe0,
+    0x63, 0xb4, 0x6c, 0x77, 0x4a, 0x6a, 0x39, 0xd6, 0x2a, 0xaf, 0x4a, 0x54,
+    0xad, 0xf8, 0x1f, 0xff, 0xd0, 0xf2, 0xd9, 0xa5, 0x9b, 0x55, 0xbd, 0xe0,
+    0x9c, 0x16, 0xc0, 0xe3, 0x8a, 0xf4, 0xbf, 0x04, 0xf8, 0x4b, 0x71, 0x49,
+    0x9d, 0x3b, 0xf0, 0x30, 0x71, 0xf9, 0xd3, 0xe2, 0x28, 0xfd, 0x6f, 0x3e,
+    0xc3, 0xe0, 0xd6, 0xd1, 0xb1, 0xc7, 0x4e, 0x8d, 0xf2, 0xbc, 0xbf, 0x0f,
+    0xd6, 0xa5, 0x4e, 0x67, 0xf7, 0x9f, 0xff, 0xd1, 0xe9, 0x7c, 0x5f, 0xe2,
+    0x84, 0xb7, 0x8e, 0x48, 0xd6, 0x5c, 0x11, 0x9f, 0xeb, 0x5e, 0x1b, 0xaa,
+    0xea, 0x13, 0xea, 0x77, 0x7b, 0x55, 0x89, 0x07, 0xf2, 0xab, 0xc0, 0xbf,
+    0xae, 0xf1, 0x4d, 0x4a, 0xaf, 0x55, 0x03, 0x2a, 0x95, 0xef, 0x86, 0xcd,
+    0x31, 0x7f, 0xcd, 0x2e, 0x54, 0x7f, 0xff, 0xd2, 0xc3, 0xf0, 0x67, 0x85,
+    0x9a, 0x79, 0x51, 0xa4, 0x8f, 0xe5, 0x1c, 0xe3, 0x1d, 0xeb, 0xdb, 0x2c,
+    0xec, 0xa1, 0xd2, 0xec, 0x94, 0x90, 0xa1, 0x82, 0xfa, 0x73, 0x55, 0x93,
+    0x3f, 0xae, 0xf1, 0x25, 0x6c, 0x4b, 0xda, 0x17, 0x3a, 0x69, 0x52, 0xb6,
+    0x65, 0x97, 0x61, 0xba, 0x53, 0x87, 0x33, 0xfb, 0x8f, 0xff, 0xd9,
+};
+
+static const uint8_t JPEG_422_I420[] = {
+    0x88, 0x9a, 0xb0, 0xbe, 0xca, 0xd8, 0xe3, 0xe9, 0xeb, 0xe0, 0xd4, 0xcb,
+    0xc4, 0xb4, 0x9c, 0x8a, 0x64, 0x5a, 0x4c, 0x3d, 0x2f, 0x24, 0x1f, 0x1f,
+    0x1b, 0x22, 0x2e, 0x3b, 0x46, 0x57, 0x72, 0x88, 0x8d, 0xa0, 0xb6, 0xc6,
+    0xd1, 0xdc, 0xe3, 0xe6, 0xde, 0xd6, 0xcb, 0xc4, 0xb9, 0xa5, 0x88, 0x72,
+    0x64, 0x55, 0x40, 0x30, 0x24, 0x1f, 0x20, 0x24, 0x1f, 0x26, 0x34, 0x44,
+    0x53, 0x64, 0x7c, 0x90, 0x9b, 0xac, 0xc1, 0xd0, 0xda, 0xe2, 0xe4, 0xe2,
+    0xd8, 0xce, 0xc1, 0xb6, 0xa9, 0x94, 0x79, 0x65, 0x56, 0x43, 0x2f, 0x22,
+    0x1b, 0x18, 0x1c, 0x21, 0x39, 0x3a, 0x42, 0x51, 0x64, 0x7c, 0x99, 0xaf,
+    0xaf, 0xbd, 0xcd, 0xd9, 0xe1, 0xe6, 0xe4, 0xdf, 0xd6, 0xc7, 0xb2, 0xa1,
+    0x92, 0x81, 0x6d, 0x5f, 0x43, 0x33, 0x25, 0x21, 0x1f, 0x1c, 0x1d, 0x22,
+    0x39, 0x3d, 0x49, 0x5e, 0x75, 0x8b, 0xa2, 0xb4, 0xc4, 0xcd, 0xd6, 0xdd,
+    0xe2, 0xe5, 0xe0, 0xd9, 0xcb, 0xbb, 0xa4, 0x8f, 0x7d, 0x6b, 0x58, 0x4b,
+    0x3a, 0x2b, 0x21, 0x23, 0x25, 0x24, 0x29, 0x33, 0x38, 0x46, 0x62, 0x81,
+    0x98, 0xa5, 0xae, 0xb6, 0xd2, 0xd7, 0xdb, 0xde, 0xe0, 0xdf, 0xd6, 0xcb,
+    0xbb, 0xae, 0x9b, 0x87, 0x72, 0x5b, 0x43, 0x33, 0x31, 0x22, 0x19, 0x1d,
+    0x21, 0x24, 0x33, 0x46, 0x52, 0x5f, 0x76, 0x91, 0xa5, 0xb4, 0xc3, 0xcf,
+    0xd6, 0xda, 0xdc, 0xdd, 0xde, 0xd8, 0xc9, 0xba, 0xa8, 0x9d, 0x8c, 0x79,
+    0x65, 0x4e, 0x38, 0x29, 0x25, 0x1a, 0x17, 0x1f, 0x24, 0x27, 0x3a, 0x52,
+    0x60, 0x6a, 0x7d, 0x91, 0xa2, 0xb2, 0xc8, 0xda, 0xd6, 0xd9, 0xdc, 0xdd,
+    0xdc, 0xd3, 0xc0, 0xad, 0x97, 0x8a, 0x76, 0x63, 0x51, 0x41, 0x32, 0x28,
+    0x1e, 0x19, 0x20, 0x2e, 0x33, 0x33, 0x43, 0x5a, 0x66, 0x7a, 0x9a, 0xb6,
+    0xc3, 0xca, 0xd3, 0xde, 0xee, 0xe1, 0xe8, 0xda, 0xd6, 0xbf, 0xb9, 0xa2,
+    0x82, 0x77, 0x67, 0x56, 0x46, 0x36, 0x27, 0x1e, 0x13, 0x14, 0x22, 0x37,
+    0x3e, 0x3e, 0x4f, 0x68, 0x84, 0x97, 0xa9, 0xb1, 0xbc, 0xce, 0xdb, 0xe0,
+    0xea, 0xdc, 0xe0, 0xd1, 0xca, 0xb2, 0xa9, 0x91, 0x79, 0x6b, 0x56, 0x42,
+    0x33, 0x29, 0x22, 0x1e, 0x1e, 0x21, 0x2d, 0x3c, 0x46, 0x50, 0x65, 0x7c,
+    0x90, 0xa7, 0xbe, 0xca, 0xd3, 0xdd, 0xe2, 0xe0, 0xe5, 0xd4, 0xd6, 0xc4,
+    0xbb, 0xa0, 0x95, 0x7c, 0x66, 0x59, 0x44, 0x31, 0x24, 0x1e, 0x1b, 0x1b,
+    0x22, 0x2a, 0x35, 0x3f, 0x4c, 0x62, 0x7d, 0x90, 0x9e, 0xb5, 0xcc, 0xd6,
+    0xdd, 0xe2, 0xe2, 0xdc, 0xe1, 0xce, 0xcd, 0xb8, 0xaf, 0x93, 0x87, 0x6d,
+    0x53, 0x4a, 0x3b, 0x2d, 0x22, 0x1b, 0x18, 0x17, 0x24, 0x31, 0x3d, 0x45,
+    0x57, 0x75, 0x91, 0x9e, 0xae, 0xc0, 0xd1, 0xd7, 0xda, 0xe0, 0xdf, 0xd9,
+    0xdd, 0xc7, 0xc2, 0xac, 0xa3, 0x88, 0x7d, 0x63, 0x47, 0x3f, 0x33, 0x26,
+    0x1e, 0x1b, 0x1c, 0x1e, 0x2a, 0x3c, 0x4c, 0x56, 0x6a, 0x8a, 0xa3, 0xac,
+    0xbf, 0xcf, 0xdd, 0xe0, 0xe1, 0xe3, 0xde, 0xd6, 0xd4, 0xbb, 0xb2, 0x9a,
+    0x91, 0x78, 0x6e, 0x55, 0x3f, 0x36, 0x28, 0x1c, 0x16, 0x1b, 0x25, 0x2d,
+    0x36, 0x46, 0x59, 0x68, 0x7e, 0x99, 0xad, 0xb5, 0xc9, 0xd9, 0xe8, 0xea,
+    0xe8, 0xe4, 0xd7, 0xc9, 0xc7, 0xab, 0x9e, 0x83, 0x7a, 0x62, 0x5a, 0x42,
+    0x32, 0x2c, 0x22, 0x1a, 0x19, 0x21, 0x2f, 0x3a, 0x48, 0x55, 0x68, 0x7c,
+    0x91, 0xa6, 0xb8, 0xc2, 0xd4, 0xe0, 0xe9, 0xe6, 0xe0, 0xda, 0xcb, 0xbc,
+    0xbc, 0x9f, 0x90, 0x73, 0x69, 0x52, 0x4b, 0x33, 0x24, 0x24, 0x23, 0x21,
+    0x23, 0x2a, 0x35, 0x3d, 0x5c, 0x65, 0x77, 0x8d, 0xa2, 0xb4, 0xc5, 0xd1,
+    0xe1, 0xe8, 0xe8, 0xdd, 0xd5, 0xd0, 0xc6, 0xba, 0x99, 0xd5, 0xe1, 0xa6,
+    0x55, 0x1c, 0x29, 0x66, 0xb5, 0xdc, 0xd0, 0x8c, 0x45, 0x1b, 0x34, 0x74,
+    0xbd, 0xde, 0xcc, 0x83, 0x3e, 0x1b, 0x3c, 0x83, 0xce, 0xdd, 0xb7, 0x6b,
+    0x32, 0x21, 0x4c, 0x96, 0xd9, 0xde, 0xab, 0x5c, 0x2b, 0x25, 0x5b, 0xaa,
+    0xdf, 0xd6, 0x95, 0x47, 0x25, 0x30, 0x6f, 0xbf, 0xdc, 0xd3, 0x94, 0x47,
+    0x28, 0x35, 0x75, 0xc6, 0xdf, 0xc9, 0x7f, 0x35, 0x25, 0x42, 0x88, 0xd8,
+    0xe9, 0xb8, 0x6e, 0x31, 0x25, 0x52, 0x9d, 0xd5, 0xe1, 0x9c, 0x5a, 0x2e,
+    0x24, 0x62, 0xb7, 0xdd, 0xd4, 0x9a, 0x4e, 0x22, 0x32, 0x70, 0xb9, 0xe9,
+    0xce, 0x83, 0x42, 0x27, 0x35, 0x7e, 0xca, 0xe1, 0xc9, 0x84, 0x37, 0x1f,
+    0x49, 0x8d, 0xc3, 0xdb, 0xae, 0x5f, 0x28, 0x2b, 0x58, 0xa6, 0xda, 0xd7,
+    0xac, 0x67, 0x23, 0x23, 0x64, 0xae, 0xd1, 0xd6, 0x93, 0x46, 0x1c, 0x36,
+    0x78, 0xc4, 0xdf, 0xc3, 0xa7, 0xd9, 0x93, 0x30, 0x36, 0x9f, 0xde, 0xa2,
+    0x41, 0x24, 0x7c, 0xd8, 0xb9, 0x46, 0x1f, 0x7b, 0xc2, 0xd3, 0x7b, 0x29,
+    0x46, 0xae, 0xdc, 0x92, 0x23, 0x3a, 0xa9, 0xe2, 0x9d, 0x32, 0x2a, 0x98,
+    0xd7, 0xc2, 0x59, 0x26, 0x65, 0xc5, 0xcf, 0x6d, 0x19, 0x59, 0xcd, 0xd7,
+    0x78, 0x28, 0x43, 0xba, 0xdb, 0xae, 0x42, 0x2a, 0x80, 0xd5, 0xc0, 0x46,
+    0x28, 0x6f, 0xd3, 0xbe, 0x5e, 0x2d, 0x5b, 0xce, 0xe3, 0x83, 0x2e, 0x44,
+    0xa6, 0xd8, 0x98, 0x39, 0x2c, 0x9a, 0xd1, 0xaf, 0x4b, 0x25, 0x87, 0xdc,
+    0xd9, 0x69, 0x1e, 0x54, 0xc0, 0xd8, 0x84, 0x26, 0x40, 0xb2, 0xd5, 0x93,
+    0x2f, 0x29, 0x9d, 0xeb, 0xb9, 0x4a, 0x1e, 0x79, 0xd7, 0xc2, 0x64, 0x1e,
+    0x63, 0xcb, 0xc9, 0x6a, 0x21, 0x4b, 0xbc, 0xe1, 0x94, 0x38, 0x2d, 0x9b,
+    0xde, 0xa2, 0x49, 0x26, 0x81, 0xd5, 0xb3, 0x4c, 0x29, 0x77, 0xd1, 0xc5,
+};
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include <linux/videodev2.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "test/jpeg_frame.h"
+#include "uvc/v4l2_define.h"
+#include "uvc/v4l2_jpeg.h"
+
+/*
+ * V4L2JpegDecoder against the known baseline frame (jpeg_frame.h), with and
+ * without its DHT segments and restart markers, on one or more threads and
+ * at every scale
+ */
+
+/*scaled frames are compared to a box average of the full size output*/
+#define JPEG_SCALED_MIN_PSNR 28.0
+
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+
+/*
+ * copy a frame without its DHT segments (MJPEG cameras rely on the
+ * default tables)
+ * args:
+ *   data - jpeg frame
+ *   size - frame size
+ *
+ * returns: frame without DHT
+ */
+static std::vector<uint8_t> strip_dht(const uint8_t *data, size_t size) {
+    std::vector<uint8_t> frame(data, data + 2);
+    size_t offset = 2;
+    while (offset + 4 <= size) {
+        if (data[offset + 1] == 0xDA) {
+            frame.insert(frame.end(), data + offset, data + size);
+            break;
+        }
+        size_t length = 2 + ((data[offset + 2] << 8) | data[offset + 3]);
+        if (data[offset + 1] != 0xC4) {
+            frame.insert(frame.end(), data + offset, data + offset + length);
+        }
+        offset += length;
+    }
+    return frame;
+}
+
+/*
+ * interleave the chroma planes of an I420 frame
+ * args:
+ *   i420 - I420 frame
+ *   width - frame width
+ *   height - frame height
+ *
+ * returns: NV12 frame
+ */
+static std::vector<uint8_t> to_nv12(const std::vector<uint8_t> &i420, int width, int height) {
+    size_t luma_size = (size_t)width * height;
+    size_t chroma_size = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+    std::vector<uint8_t> nv12(i420.begin(), i420.begin() + luma_size);
+    for (size_t i = 0; i < chroma_size; i++) {
+        nv12.push_back(i420[luma_size + i]);
+        nv12.push_back(i420[luma_size + chroma_size + i]);
+    }
+    return nv12;
+}
+
+/*
+ * shrink an I420 frame by scale, averaging each scale x scale box
+ * args:
+ *   i420 - I420 frame
+ *   width - frame width
+ *   height - frame height
+ *   scale - 1, 2, 4 or 8
+ *
+ * returns: I420 frame of the scaled size
+ */
+static std::vector<uint8_t> box_average(const std::vector<uint8_t> &i420, int width, int height,
+                                        int scale) {
+    int out_width = uvc::V4L2JpegDecoder::get_scaled_size(width, scale);
+    int out_height = uvc::V4L2JpegDecoder::get_scaled_size(height, scale);
+    int plane_widths[] = {width, (width + 1) / 2, (width + 1) / 2};
+    int plane_heights[] = {height, (height + 1) / 2, (height + 1) / 2};
+    int out_widths[] = {out_width, (out_width + 1) / 2, (out_width + 1) / 2};
+    int out_heights[] = {out_height, (out_height + 1) / 2, (out_height + 1) / 2};
+
+    std::vector<uint8_t> out;
+    const uint8_t *plane = i420.data();
+    for (int p = 0; p < 3; p++) {
+        for (int y = 0; y < out_heights[p]; y++) {
+            for (int x = 0; x < out_widths[p]; x++) {
+                int sum = 0;
+                int count = 0;
+                for (int j = y * scale; j < (y + 1) * scale && j < plane_heights[p]; j++) {
+                    for (int i = x * scale; i < (x + 1) * scale && i < plane_widths[p]; i++) {
+                        sum += plane[j * plane_widths[p] + i];
+                        count++;
+                    }
+                }
+                out.push_back(count ? (sum + count / 2) / count : 128);
+            }
+        }
+        plane += plane_widths[p] * plane_heights[p];
+    }
+    return out;
+}
+
+static double psnr(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b) {
+    double error = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        double diff = (double)a[i] - b[i];
+        error += diff * diff;
+    }
+    if (error == 0) {
+        return 99.0;
+    }
+    return 10.0 * log10(255.0 * 255.0 * a.size() / error);
+}
+
+/*
+ * decode a frame and compare it to the expected output byte for byte
+ * args:
+ *   name - test case name
+ *   decoder - decoder under test
+ *   frame - jpeg frame
+ *   out_format - V4L2_PIX_FMT_YUV420 or V4L2_PIX_FMT_NV12
+ *   expected - expected output
+ *
+ * returns: 1 if the output matches, 0 otherwise
+ */
+static int check_decode(const char *name, uvc::V4L2JpegDecoder &decoder,
+                        const std::vector<uint8_t> &frame, uint32_t out_format,
+                        const std::vector<uint8_t> &expected) {
+    std::vector<uint8_t> scratch(uvc::V4L2JpegDecoder::get_scratch_size(frame.size()));
+    std::vector<uint8_t> out(expected.size(), 0xA5);
+    int ret = decoder.decode(frame.data(), frame.size(), JPEG_WIDTH, JPEG_HEIGHT, out.data(),
+                             out_format, scratch.data(), scratch.size());
+    if (ret != E_OK) {
+        printf("%s %.4s: decode returned %d\n", name, (const char *)&out_format, ret);
+        return 0;
+    }
+    for (size_t i = 0; i < out.size(); i++) {
+        if (out[i] != expected[i]) {
+            printf("%s %.4s: differs at byte %zu (%d, expected %d)\n", name,
+                   (const char *)&out_format, i, out[i], expected[i]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * decode a frame at 1/scale in I420 and NV12, the I420 output must be close
+ * to the box average of the full size output (exact at scale 1) and the NV12
+ * output the same samples interleaved
+ * args:
+ *   name - test case name
+ *   decoder - decoder under test
+ *   frame - jpeg frame
+ *   scale - 1, 2, 4 or 8
+ *   expected - expected full size I420 output
+ *
+ * returns: 1 if the outputs are right, 0 otherwise
+ */
+static int check_scaled(const char *name, uvc::V4L2JpegDecoder &decoder,
+                        const std::vector<uint8_t> &frame, int scale,
+                        const std::vector<uint8_t> &expected) {
+    int width = uvc::V4L2JpegDecoder::get_scaled_size(JPEG_WIDTH, scale);
+    int height = uvc::V4L2JpegDecoder::get_scaled_size(JPEG_HEIGHT, scale);
+    std::vector<uint8_t> reference = box_average(expected, JPEG_WIDTH, JPEG_HEIGHT, scale);
+    std::vector<uint8_t> scratch(uvc::V4L2JpegDecoder::get_scratch_size(frame.size()));
+    std::vector<uint8_t> i420(reference.size(), 0xA5), nv12(reference.size(), 0xA5);
+
+    int ret = decoder.decode_scaled(frame.data(), frame.size(), JPEG_WIDTH, JPEG_HEIGHT, scale,
+                                    i420.data(), V4L2_PIX_FMT_YUV420, scratch.data(),
+                                    scratch.size());
+    if (ret == E_OK) {
+        ret = decoder.decode_scaled(frame.data(), frame.size(), JPEG_WIDTH, JPEG_HEIGHT, scale,
+                                    nv12.data(), V4L2_PIX_FMT_NV12, scratch.data(),
+                                    scratch.size());
+    }
+    if (ret != E_OK) {
+        printf("%s 1/%d: decode_scaled returned %d\n", name, scale, ret);
+        return 0;
+    }
+
+    double quality = psnr(i420, reference);
+    if (scale == 1 ? i420 != reference : quality < JPEG_SCALED_MIN_PSNR) {
+        printf("%s 1/%d: %.1f dB against the box average\n", name, scale, quality);
+        return 0;
+    }
+    if (nv12 != to_nv12(i420, width, height)) {
+        printf("%s 1/%d: NV12 output differs from I420\n", name, scale);
+        return 0;
+    }
+    return 1;
+}
+
+int main() {
+    int checks = 0;
+    int failures = 0;
+
+    std::vector<uint8_t> expected(JPEG_422_I420, JPEG_422_I420 + ARRAY_SIZE(JPEG_422_I420));
+    std::vector<uint8_t> expected_nv12 = to_nv12(expected, JPEG_WIDTH, JPEG_HEIGHT);
+
+    struct {
+        const char *name;
+        std::vector<uint8_t> frame;
+    } frames[] = {
+        {"dht", std::vector<uint8_t>(JPEG_422, JPEG_422 + ARRAY_SIZE(JPEG_422))},
+        {"no dht", strip_dht(JPEG_422, ARRAY_SIZE(JPEG_422))},
+        {"dht dri", std::vector<uint8_t>(JPEG_422_DRI, JPEG_422_DRI + ARRAY_SIZE(JPEG_422_DRI))},
+        {"no dht dri", strip_dht(JPEG_422_DRI, ARRAY_SIZE(JPEG_422_DRI))},
+    };
+
+    uvc::V4L2JpegDecoder decoder;
+    for (auto &frame : frames) {
+        checks += 2;
+        failures += !check_decode(frame.name, decoder, frame.frame, V4L2_PIX_FMT_YUV420, expected);
+        failures += !check_decode(frame.name, decoder, frame.frame, V4L2_PIX_FMT_NV12,
+                                  expected_nv12);
+    }
+
+    /*restart intervals split over threads must give the serial output*/
+    uvc::V4L2JpegDecoder threaded;
+    for (int threads = 2; threads <= 4; threads++) {
+        /*the same decoder, its helpers must not rerun the jobs of the previous ones*/
+        threaded.set_threads(threads);
+        for (auto &frame : frames) {
+            checks++;
+            if (!check_decode(frame.name, threaded, frame.frame, V4L2_PIX_FMT_YUV420, expected)) {
+                printf("(with %d threads)\n", threads);
+                failures++;
+            }
+        }
+    }
+
+    for (int scale : {1, 2, 4, 8}) {
+        for (auto &frame : frames) {
+            checks++;
+            failures += !check_scaled(frame.name, decoder, frame.frame, scale, expected);
+        }
+    }
+
+    /*other scales are refused*/
+    std::vector<uint8_t> scratch(ARRAY_SIZE(JPEG_422)), out(expected.size());
+    checks++;
+    int ret = decoder.decode_scaled(JPEG_422, ARRAY_SIZE(JPEG_422), JPEG_WIDTH, JPEG_HEIGHT, 3,
+                                    out.data(), V4L2_PIX_FMT_YUV420, scratch.data(),
+                                    scratch.size());
+    if (ret != E_FORMAT_ERR) {
+        printf("scale 3 returned %d\n", ret);
+        failures++;
+    }
+
+    printf("jpeg_test: %d checks, %d failures\n", checks, failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
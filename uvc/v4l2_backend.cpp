@@ -0,0 +1,63 @@
+#include "v4l2_backend.h"
+
+#include <fcntl.h>
+#include <libv4l2.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace uvc {
+
+/*
+ * libv4l2 backend (format emulation and conversions)
+ */
+class V4L2LibV4l2Backend final : public V4L2Backend {
+public:
+    int open(const char *device, int flags) override { return v4l2_open(device, flags, 0); };
+    int close(int fd) override { return v4l2_close(fd); };
+    int ioctl(int fd, unsigned long request, void *arg) override {
+        return v4l2_ioctl(fd, request, arg);
+    };
+    void *mmap(size_t length, int prot, int flags, int fd, int64_t offset) override {
+        return v4l2_mmap(NULL, length, prot, flags, fd, offset);
+    };
+    int munmap(void *start, size_t length) override { return v4l2_munmap(start, length); };
+    ssize_t read(int fd, void *buffer, size_t size) override {
+        return v4l2_read(fd, buffer, size);
+    };
+    int poll(struct pollfd *fds, nfds_t count, int timeout_ms) override {
+        return ::poll(fds, count, timeout_ms);
+    };
+};
+
+/*
+ * direct backend (raw system calls)
+ */
+class V4L2DirectBackend final : public V4L2Backend {
+public:
+    int open(const char *device, int flags) override { return ::open(device, flags, 0); };
+    int close(int fd) override { return ::close(fd); };
+    int ioctl(int fd, unsigned long request, void *arg) override {
+        return ::ioctl(fd, request, arg);
+    };
+    void *mmap(size_t length, int prot, int flags, int fd, int64_t offset) override {
+        return ::mmap(NULL, length, prot, flags, fd, offset);
+    };
+    int munmap(void *start, size_t length) override { return ::munmap(start, length); };
+    ssize_t read(int fd, void *buffer, size_t size) override { return ::read(fd, buffer, size); };
+    int poll(struct pollfd *fds, nfds_t count, int timeout_ms) override {
+        return ::poll(fds, count, timeout_ms);
+    };
+};
+
+V4L2Backend *libv4l2_backend() {
+    static V4L2LibV4l2Backend backend;
+    return &backend;
+}
+
+V4L2Backend *direct_backend() {
+    static V4L2DirectBackend backend;
+    return &backend;
+}
+
+}  // namespace uvc
\ No newline at end of file
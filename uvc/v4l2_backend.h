@@ -0,0 +1,51 @@
+#pragma once
+
+#include <poll.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace uvc {
+
+/*
+ * device i/o backend: every system call a V4L2Context makes on its device
+ *
+ * calls follow the system call conventions (-1 and errno on error); the
+ * descriptors returned by open must be real pollable fds (they are also
+ * watched with epoll by V4L2Reactor)
+ *
+ * a backend must outlive the contexts using it
+ */
+class V4L2Backend {
+public:
+    virtual ~V4L2Backend() = default;
+    /*
+    * open a device
+    * return: device descriptor or -1
+    */
+    virtual int open(const char *device, int flags) = 0;
+    virtual int close(int fd) = 0;
+    virtual int ioctl(int fd, unsigned long request, void *arg) = 0;
+    /*
+    * map a driver buffer (offset from VIDIOC_QUERYBUF)
+    * return: pointer to the mapped buffer or MAP_FAILED
+    */
+    virtual void *mmap(size_t length, int prot, int flags, int fd, int64_t offset) = 0;
+    virtual int munmap(void *start, size_t length) = 0;
+    virtual ssize_t read(int fd, void *buffer, size_t size) = 0;
+    virtual int poll(struct pollfd *fds, nfds_t count, int timeout_ms) = 0;
+};
+
+/*
+ * get the libv4l2 backend (v4l2_open, v4l2_ioctl, ... - default)
+ * returns: pointer to the shared backend
+ */
+V4L2Backend *libv4l2_backend();
+
+/*
+ * get the direct backend (raw open, ioctl, ... - bypasses libv4l2)
+ * returns: pointer to the shared backend
+ */
+V4L2Backend *direct_backend();
+
+}  // namespace uvc
\ No newline at end of file
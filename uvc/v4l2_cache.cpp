@@ -0,0 +1,394 @@
+#include "v4l2_cache.h"
+
+#include <base/log.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "v4l2_control.h"
+#include "v4l2_define.h"
+#include "v4l2_format.h"
+
+namespace uvc {
+
+#define FORMAT_CACHE_MAGIC 0x43435655  //"UVCC"
+#define FORMAT_CACHE_VERSION 1         //bump when the layout changes
+
+#define FORMAT_CACHE_MAX_SIZE (16 * 1024 * 1024)  //sanity limit for cache files
+
+/*
+ * append data to the cache buffer
+ */
+static void put_data(std::vector<uint8_t> &buffer, const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+template <typename T>
+static void put_value(std::vector<uint8_t> &buffer, T value) {
+    put_data(buffer, &value, sizeof(T));
+}
+
+static void put_string(std::vector<uint8_t> &buffer, const std::string &value) {
+    put_value<uint32_t>(buffer, value.size());
+    put_data(buffer, value.data(), value.size());
+}
+
+/*
+ * bounds checked reader over a cache buffer
+ */
+struct CacheReader {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+
+    bool get(void *value, size_t length) {
+        if (length > size - pos) {
+            return false;
+        }
+        memcpy(value, data + pos, length);
+        pos += length;
+        return true;
+    }
+
+    template <typename T>
+    bool get_value(T *value) {
+        return get(value, sizeof(T));
+    }
+
+    bool get_string(std::string *value) {
+        uint32_t length = 0;
+        if (!get_value(&length) || length > size - pos) {
+            return false;
+        }
+        value->assign((const char *)data + pos, length);
+        pos += length;
+        return true;
+    }
+};
+
+/*
+ * FNV-1a checksum of the cache payload
+ */
+static uint32_t cache_checksum(const uint8_t *data, size_t size) {
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+std::string format_cache_key(const V4L2DeviceSysData &device) {
+    char ids[32];
+    snprintf(ids, sizeof(ids), "%04x_%04x_%04x", device.vendor, device.product,
+             device.bcd_device);
+    return std::string(ids) + "_" + device.serial;
+}
+
+std::string format_cache_path(const std::string &cache_dir, const V4L2DeviceSysData &device) {
+    /*serial numbers are free text, keep the file name safe*/
+    std::string name = format_cache_key(device);
+    for (size_t i = 0; i < name.size(); i++) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '_' && name[i] != '-') {
+            name[i] = '_';
+        }
+    }
+    return cache_dir + "/" + name + ".cache";
+}
+
+/*
+ * serialize the stream formats and controls
+ * args:
+ *   context - pointer to V4L2Context
+ *   buffer - buffer to append the payload to
+ *
+ * returns: void
+ */
+static void write_payload(V4L2Context *context, std::vector<uint8_t> &buffer) {
+    put_value<uint32_t>(buffer, context->stream_formats.size());
+    for (size_t i = 0; i < context->stream_formats.size(); i++) {
+        const V4L2StreamFormat &stream_format = context->stream_formats[i];
+        put_value<uint8_t>(buffer, stream_format.dec_support);
+        put_value<int32_t>(buffer, stream_format.pixel_format);
+        put_data(buffer, stream_format.fourcc, sizeof(stream_format.fourcc));
+        put_data(buffer, stream_format.description, sizeof(stream_format.description));
+
+        put_value<uint32_t>(buffer, stream_format.list_stream_cap.size());
+        for (size_t j = 0; j < stream_format.list_stream_cap.size(); j++) {
+            const V4l2StreamCapability &stream_cap = stream_format.list_stream_cap[j];
+            put_value<int32_t>(buffer, stream_cap.width);
+            put_value<int32_t>(buffer, stream_cap.height);
+            put_value<uint32_t>(buffer, stream_cap.size_type);
+            put_value<int32_t>(buffer, stream_cap.max_width);
+            put_value<int32_t>(buffer, stream_cap.max_height);
+            put_value<int32_t>(buffer, stream_cap.step_width);
+            put_value<int32_t>(buffer, stream_cap.step_height);
+            put_value<uint32_t>(buffer, stream_cap.interval_type);
+            put_value<V4L2Rational>(buffer, stream_cap.min_interval);
+            put_value<V4L2Rational>(buffer, stream_cap.max_interval);
+            put_value<V4L2Rational>(buffer, stream_cap.step_interval);
+
+            put_value<uint32_t>(buffer, stream_cap.framerates.size());
+            for (size_t k = 0; k < stream_cap.framerates.size(); k++) {
+                put_value<V4L2Rational>(buffer, stream_cap.framerates[k]);
+            }
+        }
+    }
+
+    put_value<uint8_t>(buffer, !context->list_device_controls.empty());
+    put_value<uint32_t>(buffer, context->list_device_controls.size());
+    for (size_t i = 0; i < context->list_device_controls.size(); i++) {
+        const V4L2ControlData *control = context->list_device_controls[i];
+        put_value<struct v4l2_queryctrl>(buffer, control->control);
+
+        /*the menu ends with an entry past the control maximum*/
+        uint32_t menu_entries = 0;
+        while (control->menu != NULL &&
+               (int32_t)control->menu[menu_entries].index <= control->control.maximum) {
+            menu_entries++;
+        }
+        put_value<uint32_t>(buffer, menu_entries);
+        for (uint32_t j = 0; j < menu_entries; j++) {
+            put_value<struct v4l2_querymenu>(buffer, control->menu[j]);
+        }
+    }
+}
+
+/*
+ * parse the stream formats and controls
+ * args:
+ *   reader - payload reader
+ *   stream_formats - parsed stream formats
+ *   has_controls - set if the cache holds the device controls
+ *   controls - parsed controls
+ *   menus - parsed control menus
+ *
+ * returns: true if the payload is complete
+ */
+static bool read_payload(CacheReader &reader, std::vector<V4L2StreamFormat> &stream_formats,
+                         uint8_t *has_controls, std::vector<struct v4l2_queryctrl> &controls,
+                         std::vector<std::vector<struct v4l2_querymenu>> &menus) {
+    uint32_t format_count = 0;
+    if (!reader.get_value(&format_count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < format_count; i++) {
+        V4L2StreamFormat stream_format;
+        int32_t pixel_format = 0;
+        uint32_t cap_count = 0;
+        if (!reader.get_value(&stream_format.dec_support) || !reader.get_value(&pixel_format) ||
+            !reader.get(stream_format.fourcc, sizeof(stream_format.fourcc)) ||
+            !reader.get(stream_format.description, sizeof(stream_format.description)) ||
+            !reader.get_value(&cap_count)) {
+            return false;
+        }
+        stream_format.pixel_format = pixel_format;
+        stream_format.fourcc[sizeof(stream_format.fourcc) - 1] = 0;
+        stream_format.description[sizeof(stream_format.description) - 1] = 0;
+
+        for (uint32_t j = 0; j < cap_count; j++) {
+            V4l2StreamCapability stream_cap;
+            uint32_t framerate_count = 0;
+            if (!reader.get_value(&stream_cap.width) || !reader.get_value(&stream_cap.height) ||
+                !reader.get_value(&stream_cap.size_type) ||
+                !reader.get_value(&stream_cap.max_width) ||
+                !reader.get_value(&stream_cap.max_height) ||
+                !reader.get_value(&stream_cap.step_width) ||
+                !reader.get_value(&stream_cap.step_height) ||
+                !reader.get_value(&stream_cap.interval_type) ||
+                !reader.get_value(&stream_cap.min_interval) ||
+                !reader.get_value(&stream_cap.max_interval) ||
+                !reader.get_value(&stream_cap.step_interval) ||
+                !reader.get_value(&framerate_count)) {
+                return false;
+            }
+            for (uint32_t k = 0; k < framerate_count; k++) {
+                V4L2Rational framerate;
+                if (!reader.get_value(&framerate)) {
+                    return false;
+                }
+                stream_cap.framerates.push_back(framerate);
+            }
+            stream_format.list_stream_cap.push_back(stream_cap);
+        }
+        stream_formats.push_back(stream_format);
+    }
+
+    uint32_t control_count = 0;
+    if (!reader.get_value(has_controls) || !reader.get_value(&control_count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < control_count; i++) {
+        struct v4l2_queryctrl control;
+        uint32_t menu_entries = 0;
+        if (!reader.get_value(&control) || !reader.get_value(&menu_entries)) {
+            return false;
+        }
+        std::vector<struct v4l2_querymenu> menu;
+        for (uint32_t j = 0; j < menu_entries; j++) {
+            struct v4l2_querymenu entry;
+            if (!reader.get_value(&entry)) {
+                return false;
+            }
+            menu.push_back(entry);
+        }
+        controls.push_back(control);
+        menus.push_back(menu);
+    }
+
+    return reader.pos == reader.size;
+}
+
+int load_format_cache(V4L2Context *context, uint8_t need_controls) {
+    FILE *file = fopen(context->cache_file.c_str(), "rb");
+    if (file == NULL) {
+        base::LogDebug() << "V4L2_CORE: no format cache " << context->cache_file;
+        return E_FILE_IO_ERR;
+    }
+
+    std::vector<uint8_t> buffer;
+    uint8_t chunk[4096];
+    size_t bytes = 0;
+    while ((bytes = fread(chunk, 1, sizeof(chunk), file)) > 0 &&
+           buffer.size() < FORMAT_CACHE_MAX_SIZE) {
+        buffer.insert(buffer.end(), chunk, chunk + bytes);
+    }
+    fclose(file);
+
+    CacheReader reader = {buffer.data(), buffer.size(), 0};
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    std::string key;
+    uint8_t driver[sizeof(context->cap.driver)];
+    uint8_t card[sizeof(context->cap.card)];
+    uint32_t driver_version = 0;
+    uint32_t capabilities = 0;
+    uint32_t device_caps = 0;
+    uint32_t payload_size = 0;
+    uint32_t checksum = 0;
+    if (!reader.get_value(&magic) || !reader.get_value(&version) || !reader.get_string(&key) ||
+        !reader.get(driver, sizeof(driver)) || !reader.get(card, sizeof(card)) ||
+        !reader.get_value(&driver_version) || !reader.get_value(&capabilities) ||
+        !reader.get_value(&device_caps) || !reader.get_value(&payload_size) ||
+        !reader.get_value(&checksum)) {
+        base::LogWarn() << "V4L2_CORE: truncated format cache " << context->cache_file;
+        return E_FILE_IO_ERR;
+    }
+
+    /*a firmware or driver update may change the formats, re-enumerate then*/
+    if (magic != FORMAT_CACHE_MAGIC || version != FORMAT_CACHE_VERSION ||
+        key != context->cache_key || memcmp(driver, context->cap.driver, sizeof(driver)) != 0 ||
+        memcmp(card, context->cap.card, sizeof(card)) != 0 ||
+        driver_version != context->cap.version || capabilities != context->cap.capabilities ||
+        device_caps != context->cap.device_caps) {
+        base::LogDebug() << "V4L2_CORE: stale format cache " << context->cache_file;
+        return E_FILE_IO_ERR;
+    }
+
+    if (payload_size != reader.size - reader.pos ||
+        cache_checksum(reader.data + reader.pos, payload_size) != checksum) {
+        base::LogWarn() << "V4L2_CORE: corrupted format cache " << context->cache_file;
+        return E_FILE_IO_ERR;
+    }
+
+    std::vector<V4L2StreamFormat> stream_formats;
+    uint8_t has_controls = 0;
+    std::vector<struct v4l2_queryctrl> controls;
+    std::vector<std::vector<struct v4l2_querymenu>> menus;
+    CacheReader payload = {reader.data + reader.pos, payload_size, 0};
+    if (!read_payload(payload, stream_formats, &has_controls, controls, menus)) {
+        base::LogWarn() << "V4L2_CORE: invalid format cache " << context->cache_file;
+        return E_FILE_IO_ERR;
+    }
+    if (need_controls && !has_controls) {
+        base::LogDebug() << "V4L2_CORE: format cache " << context->cache_file
+                         << " has no controls";
+        return E_FILE_IO_ERR;
+    }
+
+    /*same rule as enum_frame_formats: a decodable format with frame sizes*/
+    int valid_formats = 0;
+    for (size_t i = 0; i < stream_formats.size(); i++) {
+        if (stream_formats[i].dec_support && !stream_formats[i].list_stream_cap.empty()) {
+            valid_formats++;
+        }
+    }
+    if (valid_formats == 0) {
+        base::LogWarn() << "V4L2_CORE: format cache " << context->cache_file
+                        << " has no valid formats";
+        return E_FILE_IO_ERR;
+    }
+
+    context->stream_formats = std::move(stream_formats);
+    for (size_t i = 0; i < context->stream_formats.size(); i++) {
+        context->stream_formats[i].caps_enumerated = 1;
+    }
+    context->formats_enumerated = FORMATS_COMPLETE;
+    index_frame_formats(context);
+
+    /*controls were not asked for, the cached ones stay unused*/
+    if (!need_controls) {
+        controls.clear();
+    }
+    V4L2Control control;
+    for (size_t i = 0; i < controls.size(); i++) {
+        control.add_cached_control(context, controls[i], menus[i]);
+    }
+
+    base::LogDebug() << "V4L2_CORE: loaded " << context->stream_formats.size() << " formats and "
+                     << controls.size() << " controls from " << context->cache_file;
+    return E_OK;
+}
+
+int save_format_cache(V4L2Context *context) {
+    std::vector<uint8_t> payload;
+    write_payload(context, payload);
+
+    std::vector<uint8_t> buffer;
+    put_value<uint32_t>(buffer, FORMAT_CACHE_MAGIC);
+    put_value<uint32_t>(buffer, FORMAT_CACHE_VERSION);
+    put_string(buffer, context->cache_key);
+    put_data(buffer, context->cap.driver, sizeof(context->cap.driver));
+    put_data(buffer, context->cap.card, sizeof(context->cap.card));
+    put_value<uint32_t>(buffer, context->cap.version);
+    put_value<uint32_t>(buffer, context->cap.capabilities);
+    put_value<uint32_t>(buffer, context->cap.device_caps);
+    put_value<uint32_t>(buffer, payload.size());
+    put_value<uint32_t>(buffer, cache_checksum(payload.data(), payload.size()));
+    buffer.insert(buffer.end(), payload.begin(), payload.end());
+
+    /*create the cache directory on first use*/
+    size_t separator = context->cache_file.rfind('/');
+    if (separator != std::string::npos && separator > 0) {
+        mkdir(context->cache_file.substr(0, separator).c_str(), 0755);
+    }
+
+    /*write aside and rename: devices coming up together may share the cache*/
+    std::string tmp_file = context->cache_file + "." + std::to_string(getpid()) + "." +
+                           std::to_string((uintptr_t)context) + ".tmp";
+    FILE *file = fopen(tmp_file.c_str(), "wb");
+    if (file == NULL) {
+        base::LogWarn() << "V4L2_CORE: couldn't write format cache " << tmp_file << ": "
+                        << strerror(errno);
+        return E_FILE_IO_ERR;
+    }
+    size_t written = fwrite(buffer.data(), 1, buffer.size(), file);
+    if (fclose(file) != 0 || written != buffer.size() ||
+        rename(tmp_file.c_str(), context->cache_file.c_str()) != 0) {
+        base::LogWarn() << "V4L2_CORE: couldn't write format cache " << context->cache_file
+                        << ": " << strerror(errno);
+        unlink(tmp_file.c_str());
+        return E_FILE_IO_ERR;
+    }
+
+    base::LogDebug() << "V4L2_CORE: saved format cache " << context->cache_file;
+    return E_OK;
+}
+
+}  // namespace uvc
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+
+#include "v4l2_context.h"
+#include "v4l2_device.h"
+
+namespace uvc {
+
+/*
+ * get the format cache key of a device
+ * args:
+ *   device - device sys data (from V4l2Device)
+ *
+ * returns: key made of VID, PID, bcdDevice and serial number
+ */
+std::string format_cache_key(const V4L2DeviceSysData &device);
+
+/*
+ * get the format cache file of a device
+ * args:
+ *   cache_dir - cache directory
+ *   device - device sys data (from V4l2Device)
+ *
+ * returns: cache file path
+ */
+std::string format_cache_path(const std::string &cache_dir, const V4L2DeviceSysData &device);
+
+/*
+ * load the stream formats (and controls) from the format cache
+ * args:
+ *   context - pointer to V4L2Context (context->cap must be queried)
+ *   need_controls - the cache must hold the device controls (0 - controls are not loaded)
+ *
+ * notes:
+ *   the cache is only used if its key and the VIDIOC_QUERYCAP driver, card,
+ *   version and capabilities match the device, its checksum is valid and
+ *   it has a decodable format with frame sizes; cached controls skip the
+ *   control queries but are still subscribed to control events (one ioctl
+ *   per control)
+ *
+ * returns: error code (E_OK or E_FILE_IO_ERR if there is no valid cache)
+ */
+int load_format_cache(V4L2Context *context, uint8_t need_controls);
+
+/*
+ * save the stream formats and controls to the format cache
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * notes:
+ *   the file is written aside and renamed, so concurrent readers never
+ *   see a partial cache
+ *
+ * returns: error code (E_OK or E_FILE_IO_ERR)
+ */
+int save_format_cache(V4L2Context *context);
+
+}  // namespace uvc
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "v4l2_capture_thread.h"
+
+#include <base/log.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "v4l2_core.h"
+#include "v4l2_define.h"
+#include "v4l2_frame_ring.h"
+
+namespace uvc {
+
+/*
+ * capture thread poll timeout (ms), bounds the time to notice a stop request
+ */
+#define CAPTURE_THREAD_TIMEOUT 100
+
+/*
+ * capture thread loop: dequeue frames and publish them in the ring
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: void
+ */
+static void capture_thread_loop(V4L2Context *context) {
+    base::LogDebug() << "V4L2_CORE: capture thread started for " << context->videodevice;
+
+    while (context->capture_thread_running.load(std::memory_order_acquire)) {
+        V4L2FrameBuff *frame = NULL;
+        int ret = v4l2core_get_frame(context, CAPTURE_THREAD_TIMEOUT, &frame);
+        if (ret == E_SELECT_TIMEOUT_ERR || ret == E_NO_DATA) {
+            continue;
+        } else if (ret == E_NO_STREAM_ERR) {
+            /*stream went down under us: nothing left to dequeue*/
+            break;
+        } else if (ret != E_OK) {
+            base::LogError() << "V4L2_CORE: (capture thread) get frame failed: " << ret;
+            /*don't spin on a broken device*/
+            usleep(CAPTURE_THREAD_TIMEOUT * 1000);
+            continue;
+        }
+
+        if (!context->frame_ring->push(frame)) {
+            /*consumer is not keeping up, give the buffer back to the driver*/
+            context->ring_dropped_frames++;
+            v4l2core_release_frame(context, frame);
+            continue;
+        }
+
+        uint64_t event = 1;
+        if (write(context->ring_event_fd, &event, sizeof(event)) < 0) {
+            base::LogError() << "V4L2_CORE: (capture thread) event write failed: "
+                             << strerror(errno);
+        }
+    }
+
+    /*the thread may stop on its own, a later start must not take it for running*/
+    context->capture_thread_running.store(false, std::memory_order_release);
+
+    /*wake a consumer sleeping on an empty ring, it gets E_NO_STREAM_ERR*/
+    uint64_t event = 1;
+    if (write(context->ring_event_fd, &event, sizeof(event)) < 0) {
+        base::LogError() << "V4L2_CORE: (capture thread) event write failed: " << strerror(errno);
+    }
+    base::LogDebug() << "V4L2_CORE: capture thread stopped for " << context->videodevice;
+}
+
+/*
+ * Start the capture thread of a context
+ * args:
+ *   context - pointer to V4L2Context (stream must be on)
+ *   ring_size - number of frame slots in the ring between the capture thread and the consumer
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_start_capture_thread(V4L2Context *context, uint32_t ring_size) {
+    if (context->capture_thread_running) {
+        base::LogWarn() << "V4L2_CORE: capture thread already running";
+        return E_OK;
+    }
+    /*a thread that stopped on its own still holds its ring and event fd*/
+    v4l2core_stop_capture_thread(context);
+    if (context->streaming != STRM_OK) {
+        base::LogError() << "V4L2_CORE: (capture thread) video stream is not on";
+        return E_NO_STREAM_ERR;
+    }
+    if (context->decode_pool != NULL) {
+        base::LogError() << "V4L2_CORE: (capture thread) the decode pool owns the stream";
+        return E_BUSY_ERR;
+    }
+    if (context->reactor_watched) {
+        base::LogError() << "V4L2_CORE: (capture thread) a reactor owns the stream";
+        return E_BUSY_ERR;
+    }
+    if (context->cap_meth == IO_READ) {
+        base::LogError() << "V4L2_CORE: (capture thread) needs a streaming capture method";
+        return E_DEVICE_ERR;
+    }
+    if (ring_size == 0) {
+        base::LogError() << "V4L2_CORE: (capture thread) invalid ring size";
+        return E_ALLOC_ERR;
+    }
+
+    context->ring_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (context->ring_event_fd < 0) {
+        base::LogError() << "V4L2_CORE: (capture thread) eventfd failed: " << strerror(errno);
+        return E_ALLOC_ERR;
+    }
+
+    context->frame_ring = new V4L2FrameRing(ring_size);
+    context->ring_dropped_frames = 0;
+
+    context->capture_thread_running = true;
+    context->capture_thread = std::thread(capture_thread_loop, context);
+    return E_OK;
+}
+
+/*
+ * Stop the capture thread of a context
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_stop_capture_thread(V4L2Context *context) {
+    if (!context->capture_thread.joinable()) {
+        return E_OK;
+    }
+
+    context->capture_thread_running.store(false, std::memory_order_release);
+    context->capture_thread.join();
+
+    /*give the frames nobody picked up back to the driver*/
+    V4L2FrameBuff *frame = NULL;
+    while (context->frame_ring->pop(&frame)) {
+        v4l2core_release_frame(context, frame);
+    }
+
+    delete context->frame_ring;
+    context->frame_ring = NULL;
+
+    close(context->ring_event_fd);
+    context->ring_event_fd = -1;
+    return E_OK;
+}
+
+/*
+ * take a frame from the ring
+ * args:
+ *   context - pointer to V4L2Context
+ *   frame - pointer to the returned frame view (NULL if the ring is empty)
+ *
+ * returns: error code (E_OK, E_NO_DATA or E_NO_STREAM_ERR if the capture thread stopped)
+ */
+static int pop_ring_frame(V4L2Context *context, V4L2FrameBuff **frame) {
+    /*read before the pop: a thread seen stopped has published all its frames*/
+    bool running = context->capture_thread_running.load(std::memory_order_acquire);
+    if (context->frame_ring->pop(frame)) {
+        return E_OK;
+    }
+    return running ? E_NO_DATA : E_NO_STREAM_ERR;
+}
+
+/*
+ * Get the next frame published by the capture thread (consumer side)
+ * args:
+ *   context - pointer to V4L2Context
+ *   timeout_ms - time to wait for a frame if the ring is empty (0 - don't wait, -1 - forever)
+ *   frame - pointer to the returned frame view (NULL on error)
+ *
+ * returns: error code (E_OK, E_NO_DATA or E_NO_STREAM_ERR)
+ */
+int v4l2core_get_ring_frame(V4L2Context *context, int timeout_ms, V4L2FrameBuff **frame) {
+    *frame = NULL;
+    if (context->frame_ring == NULL) {
+        base::LogError() << "V4L2_CORE: (get ring frame) capture thread is not running";
+        return E_NO_STREAM_ERR;
+    }
+
+    int ret = pop_ring_frame(context, frame);
+    if (ret != E_NO_DATA || timeout_ms == 0) {
+        return ret;
+    }
+
+    /*ring is empty: sleep on the event fd until the capture thread publishes a frame*/
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    struct pollfd poll_fd;
+    poll_fd.fd = context->ring_event_fd;
+    poll_fd.events = POLLIN;
+    poll_fd.revents = 0;
+    while (true) {
+        uint64_t events = 0;
+        if (read(context->ring_event_fd, &events, sizeof(events)) < 0 && errno != EAGAIN) {
+            base::LogError() << "V4L2_CORE: (get ring frame) event read failed: "
+                             << strerror(errno);
+            return E_NO_DATA;
+        }
+        /*a frame may have been published before the event counter was cleared*/
+        ret = pop_ring_frame(context, frame);
+        if (ret != E_NO_DATA) {
+            return ret;
+        }
+
+        /*an empty wakeup (or a signal) only waits for what is left of the timeout*/
+        int wait_ms = -1;
+        if (timeout_ms > 0) {
+            wait_ms = std::chrono::ceil<std::chrono::milliseconds>(
+                          deadline - std::chrono::steady_clock::now())
+                          .count();
+            if (wait_ms <= 0) {
+                return E_NO_DATA;
+            }
+        }
+        if (poll(&poll_fd, 1, wait_ms) < 0 && errno != EINTR) {
+            base::LogError() << "V4L2_CORE: (get ring frame) poll failed: " << strerror(errno);
+            return E_NO_DATA;
+        }
+    }
+}
+
+}  // namespace uvc
\ No newline at end of file
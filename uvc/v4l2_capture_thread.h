@@ -0,0 +1,53 @@
+#pragma once
+
+#include "v4l2_context.h"
+
+namespace uvc {
+
+/*
+ * Start the capture thread of a context
+ * args:
+ *   context - pointer to V4L2Context (stream must be on)
+ *   ring_size - number of frame slots in the ring between the capture thread and the consumer
+ *
+ * notes:
+ *   the capture thread dequeues every frame and publishes it in a lock-free
+ *   ring; the consumer takes frames with v4l2core_get_ring_frame and hands
+ *   them back with v4l2core_release_frame (never call v4l2core_get_frame
+ *   while the thread runs); when the ring is full the new frame is requeued
+ *   and counted in ring_dropped_frames; E_BUSY_ERR while the decode pool
+ *   runs or a V4l2Reactor watches the context
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_start_capture_thread(V4L2Context *context, uint32_t ring_size);
+
+/*
+ * Stop the capture thread of a context
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * notes:
+ *   frames still in the ring are released, frames already taken by the
+ *   consumer must still be released by it
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_stop_capture_thread(V4L2Context *context);
+
+/*
+ * Get the next frame published by the capture thread (consumer side)
+ * args:
+ *   context - pointer to V4L2Context
+ *   timeout_ms - time to wait for a frame if the ring is empty (0 - don't wait, -1 - forever)
+ *   frame - pointer to the returned frame view (NULL on error)
+ *
+ * notes:
+ *   frames published before the capture thread stopped on its own (stream
+ *   went down) are still handed out, then E_NO_STREAM_ERR is returned
+ *
+ * returns: error code (E_OK, E_NO_DATA or E_NO_STREAM_ERR)
+ */
+int v4l2core_get_ring_frame(V4L2Context *context, int timeout_ms, V4L2FrameBuff **frame);
+
+}  // namespace uvc
\ No newline at end of file
@@ -3,11 +3,21 @@
 #include <linux/videodev2.h>
 #include <stdint.h>
 
+#include <atomic>
+#include <deque>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace uvc {
 
+class V4L2Backend;
+class V4L2DecodePool;
+class V4L2FrameRing;
+class V4L2JpegDecoder;
+class V4L2LatencyHistogram;
+class V4L2ModeIndex;
+
 /*
  * LOGITECH Dynamic controls defs
  */
@@ -35,6 +45,7 @@ namespace uvc {
  */
 #define IO_MMAP 1
 #define IO_READ 2
+#define IO_USERPTR 3
 
 /*
  * stream status codes
@@ -43,12 +54,32 @@ namespace uvc {
 #define STRM_REQ_STOP (1)
 #define STRM_OK (2)
 
+/*
+ * frame status codes
+ */
+#define FRAME_DONE (0)      //frame is owned by the driver (queued)
+#define FRAME_DECODING (1)  //frame is being processed
+#define FRAME_READY (2)     //frame was dequeued and is owned by the consumer
+
 /*
  * buffer number (for driver mmap ops)
  */
-#define NB_BUFFER 4
+#define NB_BUFFER 4   //default number of buffers requested
+#define MIN_BUFFER 2  //minimum number of buffers (latency critical mode)
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)  //huge page size for USERPTR buffers (MAP_HUGETLB)
 
-static int frame_queue_size = 1; /*just one frame in queue (enough for a single thread)*/
+/*
+ * stream formats enumeration state
+ */
+#define FORMATS_NONE 0      //not enumerated yet (lazy open)
+#define FORMATS_LISTED 1    //pixel formats listed, sizes and intervals on demand
+#define FORMATS_COMPLETE 2  //every format, size and interval enumerated
+
+/*
+ * number of frames in the real fps sliding window
+ */
+#define FPS_WINDOW 32
 
 /*
  * v4l2 control data
@@ -73,11 +104,23 @@ struct V4L2Rational {
 };
 /*
  * v4l2 stream capability data
+ *
+ * stepwise/continuous sizes are kept as one range entry, their frame
+ * intervals are the ones the driver reports for the maximum size
  */
 struct V4l2StreamCapability {
-    int32_t width;                         //width
-    int32_t height;                        //height
-    std::vector<V4L2Rational> framerates;  //list of framerates, should be 1 in almost all cases
+    int32_t width;                                        //width (minimum width for size ranges)
+    int32_t height;                                       //height (minimum height for size ranges)
+    uint32_t size_type = V4L2_FRMSIZE_TYPE_DISCRETE;      //V4L2_FRMSIZE_TYPE_*
+    int32_t max_width = 0;                                //maximum width (= width if discrete)
+    int32_t max_height = 0;                               //maximum height (= height if discrete)
+    int32_t step_width = 0;                               //width step (0 if discrete)
+    int32_t step_height = 0;                              //height step (0 if discrete)
+    std::vector<V4L2Rational> framerates;                 //discrete frame intervals (usually 1)
+    uint32_t interval_type = V4L2_FRMIVAL_TYPE_DISCRETE;  //V4L2_FRMIVAL_TYPE_*
+    V4L2Rational min_interval = {0, 0};                   //shortest frame interval (all types)
+    V4L2Rational max_interval = {0, 0};                   //longest frame interval (all types)
+    V4L2Rational step_interval = {0, 0};                  //interval step (interval ranges)
 };
 
 /*
@@ -89,6 +132,17 @@ struct V4L2StreamFormat {
     char fourcc[5];        //corresponding fourcc (mode)
     char description[32];  //format description
     std::vector<V4l2StreamCapability> list_stream_cap;  //list of stream capabilities for format
+    uint8_t caps_enumerated = 0;  //list_stream_cap was enumerated (lazy enumeration)
+};
+
+/*
+ * stream mode (format, resolution and frame interval)
+ */
+struct V4L2StreamMode {
+    int pixel_format;             //v4l2 pixel format
+    int32_t width;                //frame width
+    int32_t height;               //frame height
+    V4L2Rational frame_interval;  //time between frames (s), e.g. 1/30
 };
 
 /*
@@ -108,21 +162,62 @@ struct V4L2FrameBuff {
     size_t h264_frame_size;      // h264 frame size (bytes)
     size_t h264_frame_max_size;  //size limit for h264 frame (bytes)
     size_t tmp_buffer_max_size;  //maximum size for temp buffer (bytes)
+    size_t yuv_frame_max_size;   //allocated size of the yuv frame (bytes)
 
     uint64_t timestamp;  // captured frame timestamp
+    uint32_t sequence;   // driver frame sequence number (v4l2_buffer.sequence)
 
-    uint8_t *raw_frame;   // pointer to raw frame
+    uint64_t dequeue_timestamp;   // CLOCK_MONOTONIC time the frame was dequeued (ns)
+    uint8_t monotonic_timestamp;  // timestamp is CLOCK_MONOTONIC (comparable to dequeue_timestamp)
+
+    int dmabuf_fd;  // dmabuf fd exported for the driver buffer (-1 if not exported)
+
+    std::atomic<int> refcount;  // number of leases held on the frame (v4l2core_frame_ref)
+
+    uint8_t *raw_frame;   // pointer to raw frame (points into the mmap driver buffer)
     uint8_t *yuv_frame;   // pointer to decoded yuv frame
     uint8_t *h264_frame;  // pointer to regular or demultiplexed h264 frame
     uint8_t *tmp_buffer;  //temporary buffer used in decoding
 };
 
+/*
+ * frame decoded by the decode pool
+ */
+struct V4L2DecodedFrame {
+    uint32_t sequence;      //driver frame sequence number
+    uint64_t timestamp;     //capture timestamp of the compressed frame
+    int width;              //frame width
+    int height;             //frame height
+    uint32_t format;        //yuv_frame format (V4L2_PIX_FMT_YUV420 or V4L2_PIX_FMT_NV12)
+    int status;             //decode result (E_OK, otherwise yuv_frame is incomplete)
+    size_t raw_frame_size;  //compressed frame size (bytes)
+    uint8_t *yuv_frame;     //decoded frame (yuv420_frame_size bytes)
+};
+
+/*
+ * options for v4l2core_init_dev
+ */
+struct V4L2InitOptions {
+    std::string cache_dir;           //format/control cache directory ("" - no cache)
+    uint8_t enumerate_controls = 0;  //enumerate the device controls at init
+    uint8_t lazy_formats = 0;        //enumerate the stream formats on first use, not at init
+    uint8_t direct_io = 0;           //raw open/ioctl/mmap/read, bypass libv4l2
+    V4L2Backend *backend = NULL;     //device backend (NULL - libv4l2 or direct_io)
+};
+
 struct V4L2Context {
     int fd;
+    V4L2Backend *backend;     // device backend (every open, ioctl, mmap... goes through it)
     std::string videodevice;  // video device string (e.g. "/dev/video0")
 
-    int cap_meth;                                  // capture method: IO_READ or IO_MMAP
+    int cap_meth;                                  // capture method: IO_READ, IO_MMAP or IO_USERPTR
     std::vector<V4L2StreamFormat> stream_formats;  //list of available stream formats
+    V4L2ModeIndex *mode_index;                     //lookup index over stream_formats
+    uint8_t formats_enumerated;                    //stream_formats state (FORMATS_*)
+
+    V4L2InitOptions options;  //options given to v4l2core_init_dev
+    std::string cache_file;   //format cache file ("" - no cache)
+    std::string cache_key;    //format cache key (VID, PID, bcdDevice and serial)
 
     struct v4l2_capability cap;            // v4l2 capability struct
     struct v4l2_format format;             // v4l2 format struct
@@ -134,21 +229,58 @@ struct V4L2Context {
     int requested_fmt;  //requested format (may differ from format.fmt.pix.pixelformat)
 
     uint8_t streaming;  // flag device stream : STRM_STOP ; STRM_REQ_STOP; STRM_OK
+    uint64_t switch_time;  // duration of the last set_video_stream_format (ns)
     int has_focus_control_id;  //it's set to control id if a focus control is available (enables software autofocus)
     int has_pantilt_control_id;  //it's set to 1 if a pan/tilt control is available
     uint8_t pantilt_unit_id;     //logitech peripheral V3 unit id (if any)
 
-    int fps_num;    //fps numerator
-    int fps_denom;  //fps denominator
+    int fps_num;        //fps numerator
+    int fps_denom;      //fps denominator
+    uint8_t fps_fixed;  //fps_num/fps_denom set by the caller, applied again after every S_FMT
+
+    std::atomic<double> real_fps;          //real fps (calculated from the driver timestamps)
+    std::atomic<uint64_t> frame_count;     //frames dequeued since stream start
+    std::atomic<uint64_t> dropped_frames;  //frames dropped by the driver (sequence number gaps)
+    uint32_t last_sequence;                //sequence number of the last dequeued frame
+    uint64_t fps_window[FPS_WINDOW];       //timestamps of the last dequeued frames (ns)
+    uint32_t fps_window_count;             //number of timestamps added to fps_window
+
+    uint64_t short_reads;  //number of frames shorter than sizeimage (read i/o)
+
+    V4L2LatencyHistogram *latency_stats;  //LATENCY_STAGES per frame latency histograms (NULL - disabled)
+
+    uint32_t requested_buffers;  //number of buffers requested in set_video_stream_format
+    uint32_t max_buffers;        //limit for growing the buffer pool while streaming (0 - no growth)
+    uint32_t nb_buffers;         //number of buffers granted by the driver
+
+    std::atomic<uint32_t> queued_buffers;  //number of buffers currently queued in the driver
+
+    std::vector<void *> mem;            // memory buffers for mmap driver frames
+    std::vector<uint32_t> buff_length;  // memory buffers length as set by VIDIOC_QUERYBUF
+    std::vector<uint32_t> buff_offset;  // memory buffers offset as set by VIDIOC_QUERYBUF
+
+    uint8_t export_dmabuf;       //export the mmap buffers as dmabuf fds (VIDIOC_EXPBUF)
+    std::vector<int> dmabuf_fd;  //exported dmabuf fds (-1 if not exported)
+
+    std::vector<void *> userptr_pool;  //caller supplied USERPTR buffers (empty - library allocated)
+    size_t userptr_pool_length;        //length of each caller supplied USERPTR buffer
+    uint8_t userptr_hugepages;         //back library allocated USERPTR buffers with huge pages
+
+    std::deque<V4L2FrameBuff> frame_queue;  //frame queue (one frame view per driver buffer)
 
-    double real_fps;  //real fps (calculated from number of captured frames)
+    uint32_t yuv_format;            //yuv_frame format (V4L2_PIX_FMT_YUV420 or V4L2_PIX_FMT_NV12)
+    V4L2JpegDecoder *jpeg_decoder;  //MJPEG decoder (created on the first MJPEG frame)
+    uint32_t decode_threads;        //threads decoding one MJPEG frame (v4l2core_set_decode_threads)
+    V4L2FrameBuff *preview_frame;   //reduced size MJPEG decode (v4l2core_decode_preview)
 
-    void *mem[NB_BUFFER];             // memory buffers for mmap driver frames
-    uint32_t buff_length[NB_BUFFER];  // memory buffers length as set by VIDIOC_QUERYBUF
-    uint32_t buff_offset[NB_BUFFER];  // memory buffers offset as set by VIDIOC_QUERYBUF
+    std::thread capture_thread;                 //capture thread (v4l2core_start_capture_thread)
+    std::atomic<bool> capture_thread_running;   //capture thread keeps running while set
+    V4L2FrameRing *frame_ring;                  //frames published by the capture thread
+    int ring_event_fd;                          //eventfd signaled for every published frame
+    std::atomic<uint64_t> ring_dropped_frames;  //frames dropped because the ring was full
 
-    V4L2FrameBuff *frame_queue;  //frame queue
-    int frame_queue_size;        //size of frame queue (in frames)
+    V4L2DecodePool *decode_pool;  //MJPEG decode pool (v4l2core_start_decode_pool)
+    uint8_t reactor_watched;      //dequeued by a V4l2Reactor (V4l2Reactor::add_context)
 
     uint8_t h264_unit_id;  // uvc h264 unit id, if <= 0 then uvc h264 is not supported
     uint8_t
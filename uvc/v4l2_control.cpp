@@ -3,9 +3,10 @@
 #include <assert.h>
 #include <base/log.h>
 #include <libintl.h>
-#include <libv4l2.h>
 #include <string.h>
 
+#include "v4l2_backend.h"
+#include "v4l2_ioctl_stats.h"
 #include "v4l2_util.h"
 
 namespace uvc {
@@ -15,15 +16,20 @@ namespace uvc {
  * returns: error code
  */
 static int query_ioctl(V4L2Context *context, int current_ctrl, struct v4l2_queryctrl *ctrl) {
+    uint64_t begin = ioctl_stats_begin();
+    uint32_t retries = 0;
     int ret = 0;
     int tries = 4;
     do {
         if (ret != 0) {
             ctrl->id = current_ctrl | V4L2_CTRL_FLAG_NEXT_CTRL;
+            ioctl_retry_backoff(errno, retries);
+            retries++;
         }
-        ret = v4l2_ioctl(context->fd, VIDIOC_QUERYCTRL, ctrl);
+        ret = context->backend->ioctl(context->fd, VIDIOC_QUERYCTRL, ctrl);
     } while (ret && tries-- && ((errno == EIO || errno == EPIPE || errno == ETIMEDOUT)));
 
+    record_ioctl(VIDIOC_QUERYCTRL, begin, retries, ret);
     return ret;
 };
 
@@ -39,7 +45,7 @@ void v4l2_subscribe_control_events(V4L2Context *context, unsigned int control_id
     context->evsub.type = V4L2_EVENT_CTRL;
     context->evsub.id = control_id;
 
-    int ret = xioctl(context->fd, VIDIOC_SUBSCRIBE_EVENT, &context->evsub);
+    int ret = xioctl(context, VIDIOC_SUBSCRIBE_EVENT, &context->evsub);
 
     if (ret != 0) {
         base::LogError() << "V4L2_CORE: failed to subscribe events for control " << control_id
@@ -48,88 +54,61 @@ void v4l2_subscribe_control_events(V4L2Context *context, unsigned int control_id
 }
 
 /*
- * add control to control list
+ * query the menu entries of a menu control
  * args:
  *   context - pointer to V4L2Context
  *   queryctrl - pointer to v4l2_queryctrl data
+ *
+ * returns: menu entries (empty if not a menu control)
  */
-static bool add_control(V4L2Context *context, struct v4l2_queryctrl *queryctrl) {
-    int menu_entries = 0;
-
-    V4L2ControlData control_data;
-    struct v4l2_querymenu *menu = NULL;      //menu list
-    struct v4l2_querymenu *old_menu = menu;  //temp menu list pointer
-
-    if (queryctrl->flags & V4L2_CTRL_FLAG_DISABLED) {
-        base::LogWarn() << "Control " << queryctrl->id
-                        << " is disabled: remove it from control list";
-        return false;
+static std::vector<struct v4l2_querymenu> query_menu(V4L2Context *context,
+                                                     const struct v4l2_queryctrl *queryctrl) {
+    std::vector<struct v4l2_querymenu> menu_list;
+    if (queryctrl->type != V4L2_CTRL_TYPE_MENU && queryctrl->type != V4L2_CTRL_TYPE_INTEGER_MENU) {
+        return menu_list;
     }
 
-    //check menu items if needed
-    if (queryctrl->type == V4L2_CTRL_TYPE_MENU || queryctrl->type == V4L2_CTRL_TYPE_INTEGER_MENU) {
-        int i = 0;
-        struct v4l2_querymenu querymenu = {0};
-
-        for (querymenu.index = queryctrl->minimum; querymenu.index <= queryctrl->maximum;
-             querymenu.index++) {
-            querymenu.id = queryctrl->id;
-            if (xioctl(context->fd, VIDIOC_QUERYMENU, &querymenu) < 0) {
-                continue;
-            }
-
-            old_menu = menu;
-
-            if (menu == nullptr) {
-                menu = (struct v4l2_querymenu *)calloc(i + 1, sizeof(struct v4l2_querymenu));
-            } else {
-                menu =
-                    (struct v4l2_querymenu *)realloc(menu, (i + 1) * sizeof(struct v4l2_querymenu));
-            }
-
-            if (menu == NULL) {
-                /*since we exit on failure there was no need to free any previous */
-                /* menu allocation (realloc), but silence cppcheck anyway */
-                if (old_menu != NULL) {
-                    free(old_menu);
-                }
-
-                base::LogError() << "V4L2_CORE: FATAL memory allocation failure (add_control): "
-                                 << strerror(errno);
-                exit(-1);
-            }
-
-            memcpy(&(menu[i]), &querymenu, sizeof(struct v4l2_querymenu));
-            i++;
+    struct v4l2_querymenu querymenu = {0};
+    for (querymenu.index = queryctrl->minimum; querymenu.index <= queryctrl->maximum;
+         querymenu.index++) {
+        querymenu.id = queryctrl->id;
+        if (xioctl(context, VIDIOC_QUERYMENU, &querymenu) < 0) {
+            continue;
         }
+        menu_list.push_back(querymenu);
+    }
+    return menu_list;
+}
+
+/*
+ * add control data to control list
+ * args:
+ *   context - pointer to V4L2Context
+ *   queryctrl - pointer to v4l2_queryctrl data
+ *   menu_list - menu entries (for menu controls)
+ */
+static void add_control_data(V4L2Context *context, const struct v4l2_queryctrl *queryctrl,
+                             const std::vector<struct v4l2_querymenu> &menu_list) {
+    int menu_entries = 0;
+    struct v4l2_querymenu *menu = NULL;  //menu list
 
-        old_menu = menu;
+    //copy menu items if needed
+    if (queryctrl->type == V4L2_CTRL_TYPE_MENU || queryctrl->type == V4L2_CTRL_TYPE_INTEGER_MENU) {
+        menu_entries = menu_list.size();
 
         /*last entry (NULL name)*/
-        if (menu != NULL) {
-            menu = (struct v4l2_querymenu *)calloc(i + 1, sizeof(struct v4l2_querymenu));
-        } else {
-            menu = (struct v4l2_querymenu *)realloc(menu, (i + 1) * sizeof(struct v4l2_querymenu));
-        }
-
+        menu = (struct v4l2_querymenu *)calloc(menu_entries + 1, sizeof(struct v4l2_querymenu));
         if (menu == NULL) {
-            /*since we exit on failure there was no need to free any previous */
-            /* menu allocation (realloc), but silence cppcheck anyway */
-            if (old_menu != NULL) {
-                free(old_menu);
-            }
-
             base::LogError() << "V4L2_CORE: FATAL memory allocation failure (add_control): "
                              << strerror(errno);
             exit(-1);
         }
-
-        menu[i].id = querymenu.id;
-        menu[i].index = queryctrl->maximum + 1;
-        if (queryctrl->type == V4L2_CTRL_TYPE_MENU) {
-            menu[i].name[0] = 0;
+        if (menu_entries > 0) {
+            memcpy(menu, menu_list.data(), menu_entries * sizeof(struct v4l2_querymenu));
         }
-        menu_entries = i;
+
+        menu[menu_entries].id = queryctrl->id;
+        menu[menu_entries].index = queryctrl->maximum + 1;
     }
 
     /*check for focus control to enable software autofocus*/
@@ -143,19 +122,15 @@ static bool add_control(V4L2Context *context, struct v4l2_queryctrl *queryctrl)
         // context->pantilt_unit_id = get_logitech_peripheral_unit_id(context);
     }
     // Add the control to the linked list
-    V4L2ControlData *control = (V4L2ControlData *)calloc(1, sizeof(V4L2ControlData));
-    if (control == NULL) {
-        base::LogError() << "FATAL memory allocation failure (add_control): " << strerror(errno);
-        exit(-1);
-    }
+    V4L2ControlData *control = new V4L2ControlData();
     memcpy(&(control->control), queryctrl, sizeof(struct v4l2_queryctrl));
     control->cclass = V4L2_CTRL_ID2CLASS(control->control.id);
-    control->name = strdup(dgettext(GETTEXT_PACKAGE_V4L2CORE, (char *)control->control.name));
+    control->name = dgettext(GETTEXT_PACKAGE_V4L2CORE, (char *)control->control.name);
     //add the menu adress (NULL if not a menu)
     control->menu = menu;
     if (control->menu != NULL && control->control.type == V4L2_CTRL_TYPE_MENU) {
         control->menu_entry = (char **)calloc(menu_entries, sizeof(char *));
-        if (control->menu_entry == NULL) {
+        if (menu_entries > 0 && control->menu_entry == NULL) {
             base::LogError() << "FATAL memory allocation failure (add_control): "
                              << strerror(errno);
             exit(-1);
@@ -185,6 +160,22 @@ static bool add_control(V4L2Context *context, struct v4l2_queryctrl *queryctrl)
 
     //subscribe control events
     v4l2_subscribe_control_events(context, queryctrl->id);
+}
+
+/*
+ * add control to control list
+ * args:
+ *   context - pointer to V4L2Context
+ *   queryctrl - pointer to v4l2_queryctrl data
+ */
+static bool add_control(V4L2Context *context, struct v4l2_queryctrl *queryctrl) {
+    if (queryctrl->flags & V4L2_CTRL_FLAG_DISABLED) {
+        base::LogWarn() << "Control " << queryctrl->id
+                        << " is disabled: remove it from control list";
+        return false;
+    }
+
+    add_control_data(context, queryctrl, query_menu(context, queryctrl));
     return true;
 }
 
@@ -212,4 +203,23 @@ int V4L2Control::enumerate_control(V4L2Context *context) {
     return 0;
 }
 
+void V4L2Control::add_cached_control(V4L2Context *context, const struct v4l2_queryctrl &queryctrl,
+                                     const std::vector<struct v4l2_querymenu> &menu_list) {
+    add_control_data(context, &queryctrl, menu_list);
+}
+
+void V4L2Control::free_control_list(V4L2Context *context) {
+    for (size_t i = 0; i < context->list_device_controls.size(); i++) {
+        V4L2ControlData *control = context->list_device_controls[i];
+        for (int j = 0; j < control->menu_entries; j++) {
+            free(control->menu_entry[j]);
+        }
+        free(control->menu_entry);
+        free(control->menu);
+        free(control->string);
+        delete control;
+    }
+    context->list_device_controls.clear();
+}
+
 }  // namespace uvc
\ No newline at end of file
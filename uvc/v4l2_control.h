@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "v4l2_context.h"
 
@@ -12,6 +13,16 @@ public:
     * enumerate device (read/write) controls
     */
     int enumerate_control(V4L2Context *context);
+    /*
+    * add a control read from the format cache (no QUERYCTRL/QUERYMENU, the
+    * control events are still subscribed: one VIDIOC_SUBSCRIBE_EVENT)
+    */
+    void add_cached_control(V4L2Context *context, const struct v4l2_queryctrl &queryctrl,
+                            const std::vector<struct v4l2_querymenu> &menu_list);
+    /*
+    * free the device control list
+    */
+    void free_control_list(V4L2Context *context);
 };
 
 }  // namespace uvc
\ No newline at end of file
@@ -0,0 +1,384 @@
+#include "v4l2_convert.h"
+
+#include <linux/videodev2.h>
+#include <string.h>
+
+#include "v4l2_define.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CONVERT_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define CONVERT_ARM_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace uvc {
+
+/*
+ * byte offsets of the components in a packed pixel pair (4 bytes)
+ */
+struct PackedLayout {
+    uint8_t y0;
+    uint8_t u;
+    uint8_t y1;
+    uint8_t v;
+};
+
+/*
+ * frame being converted
+ */
+struct ConvertFrame {
+    const uint8_t *in;    //packed input frame
+    uint32_t stride;      //input line stride (bytes)
+    PackedLayout layout;  //input component offsets
+    int width;
+    int height;
+    uint8_t *y;  //luma plane
+    uint8_t *u;  //U plane (I420) or interleaved UV plane (NV12)
+    uint8_t *v;  //V plane (I420) or NULL (NV12)
+};
+
+/*
+ * input and output lines of one line pair
+ */
+struct RowPair {
+    const uint8_t *in0;
+    const uint8_t *in1;  //same as in0 for an odd last line
+    uint8_t *y0;
+    uint8_t *y1;  //same as y0 for an odd last line
+    uint8_t *u;
+    uint8_t *v;
+};
+
+/*
+ * get the component offsets of a packed 4:2:2 format
+ * args:
+ *   pixelformat - v4l2 pixel format
+ *   layout - pointer to the returned offsets
+ *
+ * returns: TRUE if packed 4:2:2, FALSE otherwise
+ */
+static int packed_layout(uint32_t pixelformat, PackedLayout *layout) {
+    switch (pixelformat) {
+        case V4L2_PIX_FMT_YUYV:
+            *layout = {0, 1, 2, 3};
+            return TRUE;
+        case V4L2_PIX_FMT_UYVY:
+            *layout = {1, 0, 3, 2};
+            return TRUE;
+        case V4L2_PIX_FMT_YVYU:
+            *layout = {0, 3, 2, 1};
+            return TRUE;
+        case V4L2_PIX_FMT_VYUY:
+            *layout = {1, 2, 3, 0};
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+static RowPair row_pair(const ConvertFrame &frame, int row) {
+    RowPair rows;
+    rows.in0 = frame.in + (size_t)row * frame.stride;
+    rows.in1 = row + 1 < frame.height ? rows.in0 + frame.stride : rows.in0;
+    rows.y0 = frame.y + (size_t)row * frame.width;
+    rows.y1 = row + 1 < frame.height ? rows.y0 + frame.width : rows.y0;
+    if (frame.v != NULL) {
+        rows.u = frame.u + (size_t)(row / 2) * (frame.width / 2);
+        rows.v = frame.v + (size_t)(row / 2) * (frame.width / 2);
+    } else {
+        rows.u = frame.u + (size_t)(row / 2) * frame.width;
+        rows.v = NULL;
+    }
+    return rows;
+}
+
+/*
+ * scalar reference: convert the pixel pairs [first, pairs) of a line pair
+ */
+static void convert_pairs_scalar(const ConvertFrame &frame, const RowPair &rows, int first,
+                                 int pairs) {
+    const PackedLayout &layout = frame.layout;
+    for (int i = first; i < pairs; ++i) {
+        const uint8_t *p0 = rows.in0 + i * 4;
+        const uint8_t *p1 = rows.in1 + i * 4;
+        rows.y0[2 * i] = p0[layout.y0];
+        rows.y0[2 * i + 1] = p0[layout.y1];
+        rows.y1[2 * i] = p1[layout.y0];
+        rows.y1[2 * i + 1] = p1[layout.y1];
+
+        uint8_t u = (p0[layout.u] + p1[layout.u] + 1) >> 1;
+        uint8_t v = (p0[layout.v] + p1[layout.v] + 1) >> 1;
+        if (rows.v != NULL) {
+            rows.u[i] = u;
+            rows.v[i] = v;
+        } else {
+            rows.u[2 * i] = u;
+            rows.u[2 * i + 1] = v;
+        }
+    }
+}
+
+static void convert_frame_scalar(const ConvertFrame &frame) {
+    for (int row = 0; row < frame.height; row += 2) {
+        convert_pairs_scalar(frame, row_pair(frame, row), 0, frame.width / 2);
+    }
+}
+
+#ifdef CONVERT_X86
+/*
+ * pshufb masks for 4 pixel pairs (16 bytes), 0x80 clears the byte
+ */
+struct ShuffleMasks {
+    uint8_t luma_lo[16];    //luma to bytes 0-7
+    uint8_t luma_hi[16];    //luma to bytes 8-15
+    uint8_t chroma_lo[16];  //I420: U to 0-3, V to 8-11; NV12: UV to 0-7
+    uint8_t chroma_hi[16];  //I420: U to 4-7, V to 12-15; NV12: UV to 8-15
+};
+
+static void build_masks(const PackedLayout &layout, int nv12, ShuffleMasks *masks) {
+    memset(masks, 0x80, sizeof(ShuffleMasks));
+    for (int k = 0; k < 4; ++k) {
+        masks->luma_lo[2 * k] = masks->luma_hi[8 + 2 * k] = 4 * k + layout.y0;
+        masks->luma_lo[2 * k + 1] = masks->luma_hi[8 + 2 * k + 1] = 4 * k + layout.y1;
+        if (nv12) {
+            masks->chroma_lo[2 * k] = masks->chroma_hi[8 + 2 * k] = 4 * k + layout.u;
+            masks->chroma_lo[2 * k + 1] = masks->chroma_hi[8 + 2 * k + 1] = 4 * k + layout.v;
+        } else {
+            masks->chroma_lo[k] = masks->chroma_hi[4 + k] = 4 * k + layout.u;
+            masks->chroma_lo[8 + k] = masks->chroma_hi[12 + k] = 4 * k + layout.v;
+        }
+    }
+}
+
+/*
+ * SSSE3 (pshufb) / SSE4.1 kernel: 8 pixel pairs per step
+ */
+__attribute__((target("sse4.1"))) static void convert_frame_sse41(const ConvertFrame &frame) {
+    ShuffleMasks masks;
+    build_masks(frame.layout, frame.v == NULL, &masks);
+    const __m128i luma_lo = _mm_loadu_si128((const __m128i *)masks.luma_lo);
+    const __m128i luma_hi = _mm_loadu_si128((const __m128i *)masks.luma_hi);
+    const __m128i chroma_lo = _mm_loadu_si128((const __m128i *)masks.chroma_lo);
+    const __m128i chroma_hi = _mm_loadu_si128((const __m128i *)masks.chroma_hi);
+
+    int pairs = frame.width / 2;
+    int block_pairs = pairs & ~7;
+    for (int row = 0; row < frame.height; row += 2) {
+        RowPair rows = row_pair(frame, row);
+        for (int i = 0; i < block_pairs; i += 8) {
+            __m128i a0 = _mm_loadu_si128((const __m128i *)(rows.in0 + i * 4));
+            __m128i a1 = _mm_loadu_si128((const __m128i *)(rows.in0 + i * 4 + 16));
+            __m128i b0 = _mm_loadu_si128((const __m128i *)(rows.in1 + i * 4));
+            __m128i b1 = _mm_loadu_si128((const __m128i *)(rows.in1 + i * 4 + 16));
+
+            __m128i y0 =
+                _mm_or_si128(_mm_shuffle_epi8(a0, luma_lo), _mm_shuffle_epi8(a1, luma_hi));
+            __m128i y1 =
+                _mm_or_si128(_mm_shuffle_epi8(b0, luma_lo), _mm_shuffle_epi8(b1, luma_hi));
+            _mm_storeu_si128((__m128i *)(rows.y0 + 2 * i), y0);
+            _mm_storeu_si128((__m128i *)(rows.y1 + 2 * i), y1);
+
+            __m128i c = _mm_or_si128(_mm_shuffle_epi8(_mm_avg_epu8(a0, b0), chroma_lo),
+                                     _mm_shuffle_epi8(_mm_avg_epu8(a1, b1), chroma_hi));
+            if (rows.v != NULL) {
+                _mm_storel_epi64((__m128i *)(rows.u + i), c);
+                _mm_storel_epi64((__m128i *)(rows.v + i), _mm_srli_si128(c, 8));
+            } else {
+                _mm_storeu_si128((__m128i *)(rows.u + 2 * i), c);
+            }
+        }
+        convert_pairs_scalar(frame, rows, block_pairs, pairs);
+    }
+}
+
+/*
+ * AVX2 kernel: 16 pixel pairs per step, vpshufb works per 128 bit lane so
+ * the lanes are put back in order with a cross lane permute
+ */
+__attribute__((target("avx2"))) static void convert_frame_avx2(const ConvertFrame &frame) {
+    ShuffleMasks masks;
+    build_masks(frame.layout, frame.v == NULL, &masks);
+    const __m256i luma_lo =
+        _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)masks.luma_lo));
+    const __m256i luma_hi =
+        _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)masks.luma_hi));
+    const __m256i chroma_lo =
+        _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)masks.chroma_lo));
+    const __m256i chroma_hi =
+        _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)masks.chroma_hi));
+    /*I420 dwords [U0 U2 V0 V2 | U1 U3 V1 V3] -> [U0 U1 U2 U3 | V0 V1 V2 V3]*/
+    const __m256i chroma_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    int pairs = frame.width / 2;
+    int block_pairs = pairs & ~15;
+    for (int row = 0; row < frame.height; row += 2) {
+        RowPair rows = row_pair(frame, row);
+        for (int i = 0; i < block_pairs; i += 16) {
+            __m256i a0 = _mm256_loadu_si256((const __m256i *)(rows.in0 + i * 4));
+            __m256i a1 = _mm256_loadu_si256((const __m256i *)(rows.in0 + i * 4 + 32));
+            __m256i b0 = _mm256_loadu_si256((const __m256i *)(rows.in1 + i * 4));
+            __m256i b1 = _mm256_loadu_si256((const __m256i *)(rows.in1 + i * 4 + 32));
+
+            /*qwords [Y0 Y2 | Y1 Y3] -> [Y0 Y1 Y2 Y3]*/
+            __m256i y0 = _mm256_or_si256(_mm256_shuffle_epi8(a0, luma_lo),
+                                         _mm256_shuffle_epi8(a1, luma_hi));
+            __m256i y1 = _mm256_or_si256(_mm256_shuffle_epi8(b0, luma_lo),
+                                         _mm256_shuffle_epi8(b1, luma_hi));
+            _mm256_storeu_si256((__m256i *)(rows.y0 + 2 * i),
+                                _mm256_permute4x64_epi64(y0, _MM_SHUFFLE(3, 1, 2, 0)));
+            _mm256_storeu_si256((__m256i *)(rows.y1 + 2 * i),
+                                _mm256_permute4x64_epi64(y1, _MM_SHUFFLE(3, 1, 2, 0)));
+
+            __m256i c = _mm256_or_si256(_mm256_shuffle_epi8(_mm256_avg_epu8(a0, b0), chroma_lo),
+                                        _mm256_shuffle_epi8(_mm256_avg_epu8(a1, b1), chroma_hi));
+            if (rows.v != NULL) {
+                c = _mm256_permutevar8x32_epi32(c, chroma_order);
+                _mm_storeu_si128((__m128i *)(rows.u + i), _mm256_castsi256_si128(c));
+                _mm_storeu_si128((__m128i *)(rows.v + i), _mm256_extracti128_si256(c, 1));
+            } else {
+                _mm256_storeu_si256((__m256i *)(rows.u + 2 * i),
+                                    _mm256_permute4x64_epi64(c, _MM_SHUFFLE(3, 1, 2, 0)));
+            }
+        }
+        convert_pairs_scalar(frame, rows, block_pairs, pairs);
+    }
+}
+#endif
+
+#ifdef CONVERT_ARM_NEON
+/*
+ * NEON kernel: 16 pixel pairs per step, vld4 splits the components
+ */
+static void convert_frame_neon(const ConvertFrame &frame) {
+    const PackedLayout &layout = frame.layout;
+    int pairs = frame.width / 2;
+    int block_pairs = pairs & ~15;
+    for (int row = 0; row < frame.height; row += 2) {
+        RowPair rows = row_pair(frame, row);
+        for (int i = 0; i < block_pairs; i += 16) {
+            uint8x16x4_t a = vld4q_u8(rows.in0 + i * 4);
+            uint8x16x4_t b = vld4q_u8(rows.in1 + i * 4);
+
+            uint8x16x2_t y0 = {{a.val[layout.y0], a.val[layout.y1]}};
+            uint8x16x2_t y1 = {{b.val[layout.y0], b.val[layout.y1]}};
+            vst2q_u8(rows.y0 + 2 * i, y0);
+            vst2q_u8(rows.y1 + 2 * i, y1);
+
+            uint8x16_t u = vrhaddq_u8(a.val[layout.u], b.val[layout.u]);
+            uint8x16_t v = vrhaddq_u8(a.val[layout.v], b.val[layout.v]);
+            if (rows.v != NULL) {
+                vst1q_u8(rows.u + i, u);
+                vst1q_u8(rows.v + i, v);
+            } else {
+                uint8x16x2_t uv = {{u, v}};
+                vst2q_u8(rows.u + 2 * i, uv);
+            }
+        }
+        convert_pairs_scalar(frame, rows, block_pairs, pairs);
+    }
+}
+#endif
+
+static int detect_simd_level() {
+#if defined(CONVERT_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return CONVERT_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return CONVERT_SSE41;
+    }
+#elif defined(CONVERT_ARM_NEON)
+    return CONVERT_NEON;
+#endif
+    return CONVERT_SCALAR;
+}
+
+int convert_simd_level() {
+    static const int level = detect_simd_level();
+    return level;
+}
+
+int is_packed422_format(uint32_t pixelformat) {
+    PackedLayout layout;
+    return packed_layout(pixelformat, &layout);
+}
+
+size_t yuv420_frame_size(int width, int height) {
+    return (size_t)width * height + 2 * (size_t)((width + 1) / 2) * ((height + 1) / 2);
+}
+
+int convert_packed422(const uint8_t *in, uint32_t bytesperline, uint32_t in_format, int width,
+                      int height, uint8_t *out, uint32_t out_format) {
+    return convert_packed422_level(convert_simd_level(), in, bytesperline, in_format, width,
+                                   height, out, out_format);
+}
+
+int convert_packed422_level(int level, const uint8_t *in, uint32_t bytesperline,
+                            uint32_t in_format, int width, int height, uint8_t *out,
+                            uint32_t out_format) {
+    ConvertFrame frame;
+    if (!packed_layout(in_format, &frame.layout)) {
+        return E_FORMAT_ERR;
+    }
+    if (width <= 0 || height <= 0 || (width & 1)) {
+        return E_FORMAT_ERR;
+    }
+    if (bytesperline == 0) {
+        bytesperline = width * 2;
+    }
+    if (bytesperline < (uint32_t)width * 2) {
+        return E_FORMAT_ERR;
+    }
+
+    frame.in = in;
+    frame.stride = bytesperline;
+    frame.width = width;
+    frame.height = height;
+    frame.y = out;
+    frame.u = out + (size_t)width * height;
+    switch (out_format) {
+        case V4L2_PIX_FMT_YUV420:
+            frame.v = frame.u + (size_t)(width / 2) * ((height + 1) / 2);
+            break;
+        case V4L2_PIX_FMT_NV12:
+            frame.v = NULL;
+            break;
+        default:
+            return E_FORMAT_ERR;
+    }
+
+    switch (level) {
+        case CONVERT_SCALAR:
+            convert_frame_scalar(frame);
+            return E_OK;
+#ifdef CONVERT_X86
+        case CONVERT_SSE41:
+            if (convert_simd_level() != CONVERT_SSE41 && convert_simd_level() != CONVERT_AVX2) {
+                return E_NO_CODEC;
+            }
+            convert_frame_sse41(frame);
+            return E_OK;
+        case CONVERT_AVX2:
+            if (convert_simd_level() != CONVERT_AVX2) {
+                return E_NO_CODEC;
+            }
+            convert_frame_avx2(frame);
+            return E_OK;
+#endif
+#ifdef CONVERT_ARM_NEON
+        case CONVERT_NEON:
+            if (convert_simd_level() != CONVERT_NEON) {
+                return E_NO_CODEC;
+            }
+            convert_frame_neon(frame);
+            return E_OK;
+#endif
+        default:
+            return E_NO_CODEC;
+    }
+}
+
+}  // namespace uvc
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace uvc {
+
+/*
+ * converter kernels (convert_simd_level)
+ */
+#define CONVERT_SCALAR 0  //plain c reference
+#define CONVERT_SSE41 1   //x86 SSSE3/SSE4.1, 16 pixels per step
+#define CONVERT_AVX2 2    //x86 AVX2, 32 pixels per step
+#define CONVERT_NEON 3    //arm NEON, 32 pixels per step
+
+/*
+ * fastest converter kernel supported by the cpu
+ * args:
+ *   none
+ *
+ * returns: CONVERT_* level (detected once)
+ */
+int convert_simd_level();
+
+/*
+ * check if a pixel format is packed 4:2:2 (YUYV, UYVY, YVYU or VYUY)
+ * args:
+ *   pixelformat - v4l2 pixel format
+ *
+ * returns: TRUE if packed 4:2:2, FALSE otherwise
+ */
+int is_packed422_format(uint32_t pixelformat);
+
+/*
+ * size of a 4:2:0 frame (I420 or NV12)
+ * args:
+ *   width - frame width
+ *   height - frame height
+ *
+ * returns: frame size (bytes)
+ */
+size_t yuv420_frame_size(int width, int height);
+
+/*
+ * convert a packed 4:2:2 frame to planar 4:2:0 with the fastest kernel
+ * args:
+ *   in - packed input frame
+ *   bytesperline - input line stride (0 - width * 2)
+ *   in_format - V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_UYVY, V4L2_PIX_FMT_YVYU or V4L2_PIX_FMT_VYUY
+ *   width - frame width (even)
+ *   height - frame height
+ *   out - output frame (yuv420_frame_size bytes)
+ *   out_format - V4L2_PIX_FMT_YUV420 (I420) or V4L2_PIX_FMT_NV12
+ *
+ * notes:
+ *   chroma is the rounded average of each line pair, an odd last line
+ *   keeps its own chroma
+ *
+ * returns: error code (E_OK or E_FORMAT_ERR)
+ */
+int convert_packed422(const uint8_t *in, uint32_t bytesperline, uint32_t in_format, int width,
+                      int height, uint8_t *out, uint32_t out_format);
+
+/*
+ * convert a packed 4:2:2 frame to planar 4:2:0 with the given kernel
+ * args:
+ *   level - CONVERT_* kernel (CONVERT_SCALAR is the reference)
+ *   others as convert_packed422
+ *
+ * notes:
+ *   every kernel gives the same output as the scalar reference
+ *
+ * returns: error code (E_OK, E_FORMAT_ERR or E_NO_CODEC if the cpu lacks the kernel)
+ */
+int convert_packed422_level(int level, const uint8_t *in, uint32_t bytesperline,
+                            uint32_t in_format, int width, int height, uint8_t *out,
+                            uint32_t out_format);
+
+}  // namespace uvc
\ No newline at end of file
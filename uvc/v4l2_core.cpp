@@ -3,12 +3,26 @@
 #include <base/log.h>
 #include <fcntl.h>
 #include <libintl.h>
-#include <libv4l2.h>
+#include <poll.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
 
+#include <algorithm>
+
+#include "v4l2_backend.h"
+#include "v4l2_cache.h"
+#include "v4l2_capture_thread.h"
+#include "v4l2_control.h"
+#include "v4l2_convert.h"
+#include "v4l2_decode_pool.h"
 #include "v4l2_define.h"
 #include "v4l2_format.h"
+#include "v4l2_jpeg.h"
+#include "v4l2_frame_ring.h"
+#include "v4l2_latency.h"
+#include "v4l2_mode_index.h"
 #include "v4l2_util.h"
 
 namespace uvc {
@@ -23,19 +37,26 @@ namespace uvc {
 static void clean_v4l2_dev(V4L2Context *context) {
     // if (vd->has_focus_control_id) v4l2core_soft_autofocus_close();
 
-    // if (vd->list_device_controls) free_v4l2_control_list(vd);
+    V4L2Control control;
+    control.free_control_list(context);
 
     // if (vd->list_stream_formats) free_frame_formats(vd);
 
-    // if (vd->frame_queue) free(vd->frame_queue);
-
     /*close descriptor*/
     if (context->fd > 0) {
-        v4l2_close(context->fd);
+        xclose(context);
         context->fd = 0;
     }
 
-    free(context);
+    delete[] context->latency_stats;
+    delete context->mode_index;
+    delete context->jpeg_decoder;
+    if (context->preview_frame != NULL) {
+        free(context->preview_frame->yuv_frame);
+        free(context->preview_frame->tmp_buffer);
+        delete context->preview_frame;
+    }
+    delete context;
 }
 
 /*
@@ -48,7 +69,7 @@ static void clean_v4l2_dev(V4L2Context *context) {
 static int check_v4l2_dev(V4L2Context *context) {
     memset(&context->cap, 0, sizeof(struct v4l2_capability));
 
-    if (xioctl(context->fd, VIDIOC_QUERYCAP, &context->cap) < 0) {
+    if (xioctl(context, VIDIOC_QUERYCAP, &context->cap) < 0) {
         base::LogError() << "(VIDIOC_QUERYCAP) error: " << strerror(errno);
         return E_QUERYCAP_ERR;
     }
@@ -59,9 +80,14 @@ static int check_v4l2_dev(V4L2Context *context) {
         return E_QUERYCAP_ERR;
     }
     if (!(context->cap.capabilities & V4L2_CAP_STREAMING)) {
-        base::LogError() << "V4L2_CORE: " << context->videodevice
-                         << " does not support streaming i/o";
-        return E_QUERYCAP_ERR;
+        if (!(context->cap.capabilities & V4L2_CAP_READWRITE)) {
+            base::LogError() << "V4L2_CORE: " << context->videodevice
+                             << " does not support streaming or read i/o";
+            return E_QUERYCAP_ERR;
+        }
+        base::LogWarn() << "V4L2_CORE: " << context->videodevice
+                        << " does not support streaming i/o, using read";
+        context->cap_meth = IO_READ;
     }
 
     if (context->cap_meth == IO_READ) {
@@ -73,18 +99,39 @@ static int check_v4l2_dev(V4L2Context *context) {
     }
     base::LogDebug() << "Init. " << context->cap.card << "location: " << context->cap.bus_info;
 
-    /*enumerate frame formats supported by device*/
-    int ret = enum_frame_formats(context);
-    if (ret != E_OK) {
-        base::LogError() << "No valid frame formats (with valid sizes) found for device";
-        return ret;
+    /*enumerate frame formats supported by device (unless they are cached)*/
+    int ret = E_FILE_IO_ERR;
+    if (!context->cache_file.empty()) {
+        ret = load_format_cache(context, context->options.enumerate_controls);
+    }
+    if (ret != E_OK && context->options.lazy_formats) {
+        /*known mode path: formats are enumerated on first use*/
+        base::LogDebug() << "V4L2_CORE: stream formats enumerated on demand";
+        if (context->options.enumerate_controls) {
+            V4L2Control control;
+            control.enumerate_control(context);
+        }
+    } else if (ret != E_OK) {
+        ret = enum_frame_formats(context);
+        if (ret != E_OK) {
+            base::LogError() << "No valid frame formats (with valid sizes) found for device";
+            return ret;
+        }
+
+        /*enumerate device controls*/
+        if (context->options.enumerate_controls) {
+            V4L2Control control;
+            control.enumerate_control(context);
+        }
+
+        if (!context->cache_file.empty()) {
+            save_format_cache(context);
+        }
     }
 
     // /*add h264 (uvc muxed) to format list if supported by device*/
     // add_h264_format(vd);
 
-    // /*enumerate device controls*/
-    // enumerate_v4l2_control(vd);
     // /*gets the current control values and sets their flags*/
     // get_v4l2_control_values(vd);
 
@@ -97,13 +144,16 @@ static int check_v4l2_dev(V4L2Context *context) {
 }
 
 /*
- * Initiate video device handler with default values
+ * Initiate video device handler
  * args:
  *   device - device name (e.g: "/dev/video0")
+ *   options - init options
+ *   sys_data - device sys data (NULL if unknown, disables the format cache)
  *
  * returns: pointer to V4L2Context handler (or NULL on error)
  */
-V4L2Context *v4l2core_init_dev(const char *device) {
+static V4L2Context *init_v4l2_dev(const char *device, const V4L2InitOptions &options,
+                                  const V4L2DeviceSysData *sys_data) {
     /*localization*/
     char *lc_all = setlocale(LC_ALL, "");
     char *lc_dir = bindtextdomain(GETTEXT_PACKAGE_V4L2CORE, PACKAGE_LOCALE_DIR);
@@ -112,18 +162,35 @@ V4L2Context *v4l2core_init_dev(const char *device) {
                      << " cat:" << GETTEXT_PACKAGE_V4L2CORE << ".mo";
 
     /*alloc the device data*/
-    V4L2Context *context = (V4L2Context *)calloc(1, sizeof(V4L2Context));
+    V4L2Context *context = new V4L2Context();
 
     /*MMAP by default*/
     context->cap_meth = IO_MMAP;
 
     context->videodevice = device;
 
+    if (options.backend != NULL) {
+        context->backend = options.backend;
+    } else if (options.direct_io) {
+        context->backend = direct_backend();
+    } else {
+        context->backend = libv4l2_backend();
+    }
+
+    context->options = options;
+    if (sys_data != NULL && !options.cache_dir.empty()) {
+        context->cache_file = format_cache_path(options.cache_dir, *sys_data);
+        context->cache_key = format_cache_key(*sys_data);
+    }
+
     base::LogDebug() << "capture method mmap " << context->cap_meth;
     base::LogDebug() << "video device: " << context->videodevice;
-    context->frame_queue_size = frame_queue_size;
-    /*alloc frame buffer queue*/
-    // vd->frame_queue = calloc(vd->frame_queue_size, sizeof(v4l2_frame_buff_t));
+    /*frame queue is allocated with the driver buffers (set_video_stream_format)*/
+    context->requested_buffers = NB_BUFFER;
+    context->max_buffers = 0;
+    context->ring_event_fd = -1;
+    context->yuv_format = V4L2_PIX_FMT_YUV420;
+    context->decode_threads = 1;
 
     context->h264_no_probe_default = 0;
     context->h264_SPS = NULL;
@@ -133,15 +200,16 @@ V4L2Context *v4l2core_init_dev(const char *device) {
     context->h264_last_IDR = NULL;
     context->h264_last_IDR_size = 0;
 
-    /*set some defaults*/
+    /*set some defaults (the driver interval is read back at the first format)*/
     context->fps_num = 1;
     context->fps_denom = 25;
+    context->fps_fixed = 0;
 
     context->pan_step = 128;
     context->tilt_step = 128;
 
     /*open device*/
-    if ((context->fd = v4l2_open(context->videodevice.c_str(), O_RDWR | O_NONBLOCK, 0)) < 0) {
+    if ((context->fd = xopen(context, O_RDWR | O_NONBLOCK)) < 0) {
         base::LogError() << "V4L2_CORE: ERROR opening V4L interface: " << strerror(errno);
         // clean_v4l2_dev(vd);
         return NULL;
@@ -166,6 +234,135 @@ V4L2Context *v4l2core_init_dev(const char *device) {
     return context;
 }
 
+/*
+ * Initiate video device handler with default values
+ * args:
+ *   device - device name (e.g: "/dev/video0")
+ *
+ * returns: pointer to V4L2Context handler (or NULL on error)
+ */
+V4L2Context *v4l2core_init_dev(const char *device) {
+    return init_v4l2_dev(device, V4L2InitOptions(), NULL);
+}
+
+/*
+ * Initiate video device handler with options
+ * args:
+ *   device - device sys data (from V4l2Device)
+ *   options - init options (format cache, controls)
+ *
+ * returns: pointer to V4L2Context handler (or NULL on error)
+ */
+V4L2Context *v4l2core_init_dev(const V4L2DeviceSysData &device, const V4L2InitOptions &options) {
+    return init_v4l2_dev(device.device.c_str(), options, &device);
+}
+
+/*
+ * Initiate video device handler with options (no device sys data)
+ * args:
+ *   device - device name (e.g: "/dev/video0", any name for a fake backend)
+ *   options - init options (the format cache needs the device sys data)
+ *
+ * returns: pointer to V4L2Context handler (or NULL on error)
+ */
+V4L2Context *v4l2core_init_dev(const char *device, const V4L2InitOptions &options) {
+    return init_v4l2_dev(device, options, NULL);
+}
+
+/*
+ * get the current CLOCK_MONOTONIC time
+ * args:
+ *   none
+ *
+ * returns: time in ns
+ */
+static uint64_t monotonic_time_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/*
+ * reset the frame statistics (fps and dropped frames)
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: void
+ */
+static void reset_frame_stats(V4L2Context *context) {
+    context->frame_count = 0;
+    context->dropped_frames = 0;
+    context->real_fps = 0;
+    context->fps_window_count = 0;
+
+    if (context->latency_stats) {
+        for (int i = 0; i < LATENCY_STAGES; i++) {
+            context->latency_stats[i].reset();
+        }
+    }
+}
+
+/*
+ * update the frame statistics with a dequeued frame
+ * args:
+ *   context - pointer to V4L2Context
+ *   sequence - frame sequence number (v4l2_buffer.sequence)
+ *   timestamp - frame timestamp (ns)
+ *
+ * returns: void
+ */
+static void update_frame_stats(V4L2Context *context, uint32_t sequence, uint64_t timestamp) {
+    /*driver sequence numbers skip the frames it had to drop*/
+    if (context->frame_count > 0 && sequence != context->last_sequence + 1) {
+        uint32_t gap = sequence - context->last_sequence - 1;
+        if (gap < (1U << 31)) {
+            context->dropped_frames.fetch_add(gap, std::memory_order_relaxed);
+        }
+    }
+    context->last_sequence = sequence;
+    context->frame_count.fetch_add(1, std::memory_order_relaxed);
+
+    /*fps over the last FPS_WINDOW frames*/
+    context->fps_window[context->fps_window_count % FPS_WINDOW] = timestamp;
+    context->fps_window_count++;
+
+    uint32_t frames = std::min(context->fps_window_count, (uint32_t)FPS_WINDOW);
+    /*oldest timestamp still in the window (next slot to overwrite once it is full)*/
+    uint64_t first = context->fps_window_count < FPS_WINDOW
+                         ? context->fps_window[0]
+                         : context->fps_window[context->fps_window_count % FPS_WINDOW];
+    if (frames > 1 && timestamp > first) {
+        double fps = (double)(frames - 1) * 1000000000.0 / (double)(timestamp - first);
+        context->real_fps.store(fps, std::memory_order_relaxed);
+    }
+}
+
+/*
+ * record the latencies of a frame on its last release
+ * args:
+ *   context - pointer to V4L2Context
+ *   frame - pointer to the released frame view
+ *
+ * notes:
+ *   driver timestamps are only comparable with the dequeue time when they
+ *   are CLOCK_MONOTONIC, the driver stages are skipped otherwise
+ *
+ * returns: void
+ */
+static void record_frame_latency(V4L2Context *context, V4L2FrameBuff *frame) {
+    uint64_t release_timestamp = monotonic_time_ns();
+
+    context->latency_stats[LATENCY_DEQUEUE_TO_RELEASE].record(release_timestamp -
+                                                              frame->dequeue_timestamp);
+
+    if (frame->monotonic_timestamp && frame->timestamp <= frame->dequeue_timestamp) {
+        context->latency_stats[LATENCY_DRIVER_TO_DEQUEUE].record(frame->dequeue_timestamp -
+                                                                 frame->timestamp);
+        context->latency_stats[LATENCY_DRIVER_TO_RELEASE].record(release_timestamp -
+                                                                 frame->timestamp);
+    }
+}
+
 /*
  * Start video stream
  * args:
@@ -186,8 +383,9 @@ int v4l2core_start_stream(V4L2Context *context) {
             //do nothing
             break;
         case IO_MMAP:
+        case IO_USERPTR:
         default:
-            ret = xioctl(context->fd, VIDIOC_STREAMON, &type);
+            ret = xioctl(context, VIDIOC_STREAMON, &type);
             if (ret < 0) {
                 base::LogError() << "(VIDIOC_STREAMON) Unable to start stream: " << strerror(errno);
                 return E_STREAMON_ERR;
@@ -195,6 +393,7 @@ int v4l2core_start_stream(V4L2Context *context) {
             break;
     }
 
+    reset_frame_stats(context);
     context->streaming = STRM_OK;
 
     base::LogDebug() << "(VIDIOC_STREAMON) stream_status = STRM_OK";
@@ -210,13 +409,20 @@ int v4l2core_start_stream(V4L2Context *context) {
  * returns: VIDIOC_STREAMON ioctl result (E_OK)
 */
 int v4l2core_stop_stream(V4L2Context *context) {
+    /*the capture thread and the decode pool must not dequeue while the stream goes down*/
+    v4l2core_stop_capture_thread(context);
+    v4l2core_stop_decode_pool(context);
+
     int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     int ret = E_OK;
     switch (context->cap_meth) {
         case IO_READ:
+            //do nothing
+            break;
         case IO_MMAP:
+        case IO_USERPTR:
         default:
-            ret = xioctl(context->fd, VIDIOC_STREAMOFF, &type);
+            ret = xioctl(context, VIDIOC_STREAMOFF, &type);
             if (ret < 0) {
                 if (errno == 9) { /* stream allready stoped*/
                     context->streaming = STRM_STOP;
@@ -234,32 +440,251 @@ int v4l2core_stop_stream(V4L2Context *context) {
     return ret;
 }
 
+/*
+ * get the v4l2 memory type for the capture method
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: V4L2_MEMORY_USERPTR for IO_USERPTR, V4L2_MEMORY_MMAP otherwise
+ */
+static uint32_t buffer_memory(V4L2Context *context) {
+    return context->cap_meth == IO_USERPTR ? V4L2_MEMORY_USERPTR : V4L2_MEMORY_MMAP;
+}
+
+/*
+ * allocate a page aligned buffer for USERPTR i/o
+ * args:
+ *   length - pointer to requested length (updated with the allocated length)
+ *   hugepages - try to back the buffer with huge pages (MAP_HUGETLB)
+ *
+ * returns: pointer to buffer (MAP_FAILED on error)
+ */
+static void *alloc_userptr_mem(size_t *length, uint8_t hugepages) {
+    void *mem = MAP_FAILED;
+    if (hugepages) {
+        size_t huge_length = (*length + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+        mem = mmap(NULL, huge_length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED) {
+            *length = huge_length;
+            return mem;
+        }
+        base::LogDebug() << "V4L2_CORE: no huge pages available (" << strerror(errno)
+                         << "), using regular pages";
+    }
+
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    *length = (*length + page_size - 1) & ~(page_size - 1);
+    mem = mmap(NULL, *length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem != MAP_FAILED && hugepages) {
+        /*still let the kernel use transparent huge pages if it can*/
+        madvise(mem, *length, MADV_HUGEPAGE);
+    }
+    return mem;
+}
+
+/*
+ * free the library allocated USERPTR buffers
+ * args:
+ *   context - pointer to V4L2Context
+ *   first_index - index of the first buffer to free
+ *
+ * returns: error code  (0- E_OK)
+ */
+static int free_userptr_buff(V4L2Context *context, uint32_t first_index) {
+    int ret = E_OK;
+    for (size_t i = first_index; i < context->mem.size(); i++) {
+        // caller supplied buffers are not ours to free
+        if (context->userptr_pool.empty() && context->mem[i] && context->buff_length[i])
+            if ((ret = munmap(context->mem[i], context->buff_length[i])) < 0) {
+                base::LogError() << "V4L2_CORE: couldn't free userptr buff: " << strerror(errno);
+            }
+        context->mem[i] = NULL;
+        context->buff_length[i] = 0;
+    }
+    return ret;
+}
+
+/*
+ * set up the USERPTR buffers (caller pool or library allocated)
+ * args:
+ *   context - pointer to V4L2Context
+ *   first_index - index of the first buffer to set up
+ *
+ * returns: error code  (0- E_OK)
+ */
+static int alloc_userptr_buff(V4L2Context *context, uint32_t first_index) {
+    size_t frame_size = context->format.fmt.pix.sizeimage;
+
+    for (uint32_t i = first_index; i < context->nb_buffers; i++) {
+        if (!context->userptr_pool.empty()) {
+            /*caller supplied pool*/
+            if (i >= context->userptr_pool.size() || context->userptr_pool_length < frame_size) {
+                base::LogError() << "V4L2_CORE: userptr pool too small for buffer " << i
+                                 << " (frame size " << frame_size << ")";
+                return E_ALLOC_ERR;
+            }
+            context->mem[i] = context->userptr_pool[i];
+            context->buff_length[i] = context->userptr_pool_length;
+        } else if (context->mem[i] != NULL && context->buff_length[i] >= frame_size) {
+            /*buffer kept from the previous format is big enough, reuse it*/
+            continue;
+        } else {
+            if (context->mem[i] != NULL) {
+                munmap(context->mem[i], context->buff_length[i]);
+                context->mem[i] = NULL;
+            }
+            size_t length = frame_size;
+            context->mem[i] = alloc_userptr_mem(&length, context->userptr_hugepages);
+            if (context->mem[i] == MAP_FAILED) {
+                base::LogError() << "V4L2_CORE: couldn't allocate userptr buffer: "
+                                 << strerror(errno);
+                context->mem[i] = NULL;
+                return E_ALLOC_ERR;
+            }
+            context->buff_length[i] = length;
+        }
+        base::LogDebug() << "V4L2_CORE: userptr buffer[" << i << "] with length "
+                         << context->buff_length[i] << " at pos " << context->mem[i];
+    }
+    return E_OK;
+}
+
+/*
+ * free the frame queue
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: void
+ */
+static void free_v4l2_frames(V4L2Context *context) {
+    for (V4L2FrameBuff &frame : context->frame_queue) {
+        free(frame.yuv_frame);
+        free(frame.tmp_buffer);
+    }
+    context->frame_queue.clear();
+}
+
+/*
+ * add frame views for driver buffers [first_index, nb_buffers)
+ * args:
+ *   context - pointer to V4L2Context
+ *   first_index - index of the first buffer without a frame view
+ *
+ * returns: void
+ */
+static void add_v4l2_frames(V4L2Context *context, uint32_t first_index) {
+    for (uint32_t i = first_index; i < context->nb_buffers; ++i) {
+        context->frame_queue.emplace_back();
+        V4L2FrameBuff &frame = context->frame_queue.back();
+        frame.index = i;
+        frame.status = FRAME_DONE;
+        frame.width = context->format.fmt.pix.width;
+        frame.height = context->format.fmt.pix.height;
+        frame.raw_frame_max_size = context->buff_length[i];
+        frame.dmabuf_fd = context->dmabuf_fd[i];
+    }
+}
+
+/*
+ * alloc the frame queue, one frame view for each driver buffer
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: error code  (0- E_OK)
+ */
+static int alloc_v4l2_frames(V4L2Context *context) {
+    free_v4l2_frames(context);
+
+    if (context->nb_buffers == 0) {
+        base::LogError() << "V4L2_CORE: no driver buffers to alloc frames for";
+        return E_ALLOC_ERR;
+    }
+
+    add_v4l2_frames(context, 0);
+    return E_OK;
+}
+
 /*
  * maps v4l2 buffers
  * args:
  *   context - pointer to V4L2Context
+ *   first_index - index of the first buffer to map
  *
  * returns: error code  (0- E_OK)
  */
-static int map_buff(V4L2Context *context) {
+static int map_buff(V4L2Context *context, uint32_t first_index) {
     base::LogDebug() << "V4L2_CORE: mapping v4l2 buffers";
 
     // map new buffer
-    for (int i = 0; i < NB_BUFFER; i++) {
-        context->mem[i] = v4l2_mmap(NULL,  // start anywhere
-                                    context->buff_length[i], PROT_READ | PROT_WRITE, MAP_SHARED,
-                                    context->fd, context->buff_offset[i]);
+    for (uint32_t i = first_index; i < context->nb_buffers; i++) {
+        context->mem[i] = xmmap(context, context->buff_length[i], context->buff_offset[i]);
         if (context->mem[i] == MAP_FAILED) {
             base::LogError() << "V4L2_CORE: Unable to map buffer: " << strerror(errno);
             return E_MMAP_ERR;
         }
-        base::LogError() << "V4L2_CORE: mapped buffer[" << i << "] with length "
+        base::LogDebug() << "V4L2_CORE: mapped buffer[" << i << "] with length "
                          << context->buff_length[i] << " to pos " << context->mem[i];
     }
 
     return (E_OK);
 }
 
+/*
+ * close the dmabuf fds exported for the v4l2 buffers
+ * args:
+ *   context - pointer to V4L2Context
+ *   first_index - index of the first buffer to close
+ *
+ * notes:
+ *   the frame views of the buffers drop the fd too, a closed fd number
+ *   may be handed out again by the next open
+ *
+ * returns: void
+ */
+static void close_exported_buff(V4L2Context *context, uint32_t first_index) {
+    for (size_t i = first_index; i < context->dmabuf_fd.size(); i++) {
+        if (context->dmabuf_fd[i] >= 0) {
+            close(context->dmabuf_fd[i]);
+            context->dmabuf_fd[i] = -1;
+        }
+        if (i < context->frame_queue.size()) {
+            context->frame_queue[i].dmabuf_fd = -1;
+        }
+    }
+}
+
+/*
+ * export v4l2 buffers as dmabuf fds
+ * args:
+ *   context - pointer to V4L2Context
+ *   first_index - index of the first buffer to export
+ *
+ * returns: error code  (0- E_OK)
+ */
+static int export_buff(V4L2Context *context, uint32_t first_index) {
+    base::LogDebug() << "V4L2_CORE: exporting v4l2 buffers";
+
+    for (uint32_t i = first_index; i < context->nb_buffers; i++) {
+        struct v4l2_exportbuffer export_buffer;
+        memset(&export_buffer, 0, sizeof(struct v4l2_exportbuffer));
+        export_buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        export_buffer.index = i;
+        export_buffer.flags = O_RDONLY | O_CLOEXEC;
+
+        if (xioctl(context, VIDIOC_EXPBUF, &export_buffer) < 0) {
+            base::LogError() << "V4L2_CORE: (VIDIOC_EXPBUF) Unable to export buffer " << i << ": "
+                             << strerror(errno);
+            return E_MMAP_ERR;
+        }
+        context->dmabuf_fd[i] = export_buffer.fd;
+        base::LogDebug() << "V4L2_CORE: exported buffer[" << i << "] as dmabuf fd "
+                         << export_buffer.fd;
+    }
+
+    return E_OK;
+}
+
 /*
  * unmaps v4l2 buffers
  * args:
@@ -271,30 +696,90 @@ static int unmap_buff(V4L2Context *context) {
     base::LogDebug() << "V4L2_CORE: unmapping v4l2 buffers";
     int ret = E_OK;
 
+    close_exported_buff(context, 0);
+
     switch (context->cap_meth) {
         case IO_READ:
+            for (size_t i = 0; i < context->mem.size(); i++) {
+                free(context->mem[i]);
+                context->mem[i] = NULL;
+                context->buff_length[i] = 0;
+            }
             break;
 
         case IO_MMAP:
-            for (int i = 0; i < NB_BUFFER; i++) {
+            for (size_t i = 0; i < context->mem.size(); i++) {
                 // unmap old buffer
-                if ((context->mem[i] != MAP_FAILED) && context->buff_length[i])
-                    if ((ret = v4l2_munmap(context->mem[i], context->buff_length[i])) < 0) {
+                if ((context->mem[i] != MAP_FAILED) && context->mem[i] && context->buff_length[i])
+                    if ((ret = xmunmap(context, context->mem[i], context->buff_length[i])) < 0) {
                         base::LogError() << "V4L2_CORE: couldn't unmap buff: " << strerror(errno);
                     }
+                context->mem[i] = NULL;
+                context->buff_length[i] = 0;
             }
+            break;
+
+        case IO_USERPTR:
+            ret = free_userptr_buff(context, 0);
+            break;
     }
     return ret;
 }
 
+/*
+ * unmap (or free) the buffers [first_index, nb_buffers) set up by a grow
+ * args:
+ *   context - pointer to V4L2Context
+ *   first_index - index of the first grown buffer
+ *
+ * returns: void
+ */
+static void unmap_grown_buff(V4L2Context *context, uint32_t first_index) {
+    if (context->cap_meth == IO_USERPTR) {
+        free_userptr_buff(context, first_index);
+        return;
+    }
+
+    for (uint32_t i = first_index; i < context->nb_buffers; i++) {
+        if (context->mem[i] != MAP_FAILED && context->mem[i] && context->buff_length[i] &&
+            xmunmap(context, context->mem[i], context->buff_length[i]) < 0) {
+            base::LogError() << "V4L2_CORE: couldn't unmap buff: " << strerror(errno);
+        }
+        context->mem[i] = NULL;
+        context->buff_length[i] = 0;
+    }
+}
+
+/*
+ * size the buffer tables for the driver buffers and the room to grow
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * notes:
+ *   the tables are sized up to max_buffers at once, so growing the pool
+ *   from the capture thread only fills entries [nb_buffers, max_buffers)
+ *   and never resizes a table a consumer thread is indexing; the entries
+ *   of buffers not created yet stay NULL, 0 and -1
+ *
+ * returns: void
+ */
+static void resize_buff_tables(V4L2Context *context) {
+    uint32_t size = std::max(context->nb_buffers, context->max_buffers);
+    context->mem.resize(size, NULL);
+    context->buff_length.resize(size, 0);
+    context->buff_offset.resize(size, 0);
+    context->dmabuf_fd.resize(size, -1);
+}
+
 /*
  * Query and map buffers
  * args:
  *   context - pointer to V4L2Context
+ *   first_index - index of the first buffer to query
  *
  * returns: error code  (0- E_OK)
  */
-static int query_buff(V4L2Context *context) {
+static int query_buff(V4L2Context *context, uint32_t first_index) {
     base::LogDebug() << "query v4l2 buffers";
 
     int ret = E_OK;
@@ -303,7 +788,7 @@ static int query_buff(V4L2Context *context) {
             break;
 
         case IO_MMAP:
-            for (int i = 0; i < NB_BUFFER; i++) {
+            for (uint32_t i = first_index; i < context->nb_buffers; i++) {
                 memset(&context->buf, 0, sizeof(struct v4l2_buffer));
                 context->buf.index = i;
                 context->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -312,7 +797,7 @@ static int query_buff(V4L2Context *context) {
                 // vd->buf.timestamp.tv_sec = 0;
                 // vd->buf.timestamp.tv_usec = 0;
                 context->buf.memory = V4L2_MEMORY_MMAP;
-                ret = xioctl(context->fd, VIDIOC_QUERYBUF, &context->buf);
+                ret = xioctl(context, VIDIOC_QUERYBUF, &context->buf);
 
                 if (ret < 0) {
                     base::LogError() << "V4L2_CORE: (VIDIOC_QUERYBUF) Unable to query buffer "
@@ -329,14 +814,23 @@ static int query_buff(V4L2Context *context) {
                 context->buff_offset[i] = context->buf.m.offset;
             }
             // map the new buffers
-            if (map_buff(context) != 0) {
+            if (map_buff(context, first_index) != 0) {
                 ret = E_MMAP_ERR;
+                break;
             }
+            // export the new buffers (not fatal, frames just carry no dmabuf fd)
+            if (context->export_dmabuf && export_buff(context, first_index) != E_OK) {
+                /*the buffers exported before keep their fds, later grows don't export*/
+                base::LogWarn() << "V4L2_CORE: dmabuf export failed, disabling it";
+                close_exported_buff(context, first_index);
+                context->export_dmabuf = 0;
+            }
+            break;
+
+        case IO_USERPTR:
+            ret = alloc_userptr_buff(context, first_index);
             break;
     }
-    // for (int i = 0; i < context->frame_queue_size; ++i) {
-    //     context->frame_queue[i].raw_frame_max_size = context->buf.length;
-    // }
 
     return ret;
 }
@@ -345,10 +839,11 @@ static int query_buff(V4L2Context *context) {
  * Queue Buffers
  * args:
  *   context - pointer to V4L2Context
+ *   first_index - index of the first buffer to queue
  *
  * returns: error code  (0- E_OK)
  */
-static int queue_buff(V4L2Context *context) {
+static int queue_buff(V4L2Context *context, uint32_t first_index) {
     base::LogDebug() << "query v4l2 buffers";
 
     int ret = E_OK;
@@ -357,8 +852,9 @@ static int queue_buff(V4L2Context *context) {
             break;
 
         case IO_MMAP:
+        case IO_USERPTR:
         default:
-            for (int i = 0; i < NB_BUFFER; ++i) {
+            for (uint32_t i = first_index; i < context->nb_buffers; ++i) {
                 memset(&context->buf, 0, sizeof(struct v4l2_buffer));
                 context->buf.index = i;
                 context->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -366,12 +862,17 @@ static int queue_buff(V4L2Context *context) {
                 // context->buf.timecode = context->timecode;
                 // context->buf.timestamp.tv_sec = 0;
                 // context->buf.timestamp.tv_usec = 0;
-                context->buf.memory = V4L2_MEMORY_MMAP;
-                ret = xioctl(context->fd, VIDIOC_QBUF, &context->buf);
+                context->buf.memory = buffer_memory(context);
+                if (context->cap_meth == IO_USERPTR) {
+                    context->buf.m.userptr = (unsigned long)context->mem[i];
+                    context->buf.length = context->buff_length[i];
+                }
+                ret = xioctl(context, VIDIOC_QBUF, &context->buf);
                 if (ret < 0) {
                     base::LogError() << "(VIDIOC_QBUF) Unable to queue buffer: " << strerror(errno);
                     return E_QBUF_ERR;
                 }
+                context->queued_buffers++;
             }
             context->buf.index = 0; /*reset index*/
     }
@@ -379,47 +880,474 @@ static int queue_buff(V4L2Context *context) {
 }
 
 /*
- * Set device video stream format
+ * delete requested driver buffers (VIDIOC_REQBUFS with count 0)
  * args:
- *   context - pointer to v4l2 context
- *   width - requested video frame width
- *   height - requested video frame height
- *   pixelformat - requested v4l2 pixelformat
+ *   context - pointer to V4L2Context
  *
- * returns: error code ( E_OK)
+ * returns: void
  */
-int set_video_stream_format(V4L2Context *context, int32_t width, int32_t height, int pixelformat) {
-    int ret = E_OK;
-
-    int old_format = context->requested_fmt;
-
-    context->requested_fmt = pixelformat;
-
-    uint8_t stream_status = context->streaming;
-
-    if (stream_status == STRM_OK) {
-        v4l2core_stop_stream(context);
+static void release_buff(V4L2Context *context) {
+    base::LogDebug() << "V4L2_CORE: cleaning requestbuffers";
+    memset(&context->rb, 0, sizeof(struct v4l2_requestbuffers));
+    context->rb.count = 0;
+    context->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    context->rb.memory = buffer_memory(context);
+    if (xioctl(context, VIDIOC_REQBUFS, &context->rb) < 0) {
+        base::LogError() << "V4L2_CORE: (VIDIOC_REQBUFS) Unable to delete buffers: "
+                         << strerror(errno);
     }
+    context->nb_buffers = 0;
+    context->queued_buffers = 0;
+}
 
-    if (context->requested_fmt == V4L2_PIX_FMT_H264) {
-        base::LogDebug() << "Requested H264 stream is supported through muxed MJPG";
-        pixelformat = V4L2_PIX_FMT_MJPEG;
+/*
+ * Set the number of driver buffers
+ * args:
+ *   context - pointer to V4L2Context
+ *   count - number of buffers requested at the next set_video_stream_format
+ *   max_count - limit for growing the pool while streaming (0 - never grow)
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_set_buffer_count(V4L2Context *context, uint32_t count, uint32_t max_count) {
+    if (count < MIN_BUFFER) {
+        base::LogError() << "V4L2_CORE: at least " << MIN_BUFFER << " buffers are needed";
+        return E_REQBUFS_ERR;
+    }
+    if (max_count != 0 && max_count < count) {
+        base::LogWarn() << "V4L2_CORE: max buffer count " << max_count << " lower than " << count
+                        << ", buffer pool will not grow";
+        max_count = 0;
     }
 
-    context->format.fmt.pix.pixelformat = pixelformat;
-    context->format.fmt.pix.width = width;
-    context->format.fmt.pix.height = height;
-
-    /*override field and type entries*/
-    context->format.fmt.pix.field = V4L2_FIELD_ANY;
-    context->format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-
-    ret = xioctl(context->fd, VIDIOC_S_FMT, &context->format);
+    context->requested_buffers = count;
+    context->max_buffers = max_count;
+    return E_OK;
+}
+
+/*
+ * Enable or disable dmabuf export of the driver buffers
+ * args:
+ *   context - pointer to V4L2Context
+ *   enable - export buffers (VIDIOC_EXPBUF) at the next set_video_stream_format
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_set_dmabuf_export(V4L2Context *context, uint8_t enable) {
+    if (enable && context->cap_meth != IO_MMAP) {
+        base::LogError() << "V4L2_CORE: dmabuf export needs the mmap capture method";
+        return E_MMAP_ERR;
+    }
+    context->export_dmabuf = enable;
+    return E_OK;
+}
+
+/*
+ * Set the capture method
+ * args:
+ *   context - pointer to V4L2Context
+ *   method - IO_MMAP, IO_USERPTR or IO_READ
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_set_capture_method(V4L2Context *context, int method) {
+    if (context->streaming == STRM_OK || context->nb_buffers > 0) {
+        base::LogError() << "V4L2_CORE: can't change capture method with allocated buffers";
+        return E_DEVICE_ERR;
+    }
+
+    switch (method) {
+        case IO_READ:
+            if (!(context->cap.capabilities & V4L2_CAP_READWRITE)) {
+                base::LogError() << context->videodevice << " does not support read i/o";
+                return E_READ_ERR;
+            }
+            break;
+        case IO_MMAP:
+        case IO_USERPTR:
+            if (!(context->cap.capabilities & V4L2_CAP_STREAMING)) {
+                base::LogError() << context->videodevice << " does not support streaming i/o";
+                return E_DEVICE_ERR;
+            }
+            break;
+        default:
+            base::LogError() << "V4L2_CORE: unknown capture method " << method;
+            return E_DEVICE_ERR;
+    }
+
+    if (method != IO_MMAP) {
+        context->export_dmabuf = 0;
+    }
+    context->cap_meth = method;
+    return E_OK;
+}
+
+/*
+ * Set the buffer pool used for USERPTR i/o
+ * args:
+ *   context - pointer to V4L2Context
+ *   buffers - caller supplied page aligned buffers (NULL - allocated by the library)
+ *   count - number of buffers
+ *   length - length of each caller supplied buffer (ignored for library buffers)
+ *   hugepages - back library allocated buffers with huge pages (if available)
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_set_userptr_pool(V4L2Context *context, void **buffers, uint32_t count,
+                              size_t length, uint8_t hugepages) {
+    if (context->nb_buffers > 0) {
+        base::LogError() << "V4L2_CORE: can't change the userptr pool with allocated buffers";
+        return E_DEVICE_ERR;
+    }
+    if (count < MIN_BUFFER) {
+        base::LogError() << "V4L2_CORE: at least " << MIN_BUFFER << " buffers are needed";
+        return E_REQBUFS_ERR;
+    }
+
+    context->userptr_pool.clear();
+    context->userptr_pool_length = 0;
+    context->userptr_hugepages = hugepages;
+
+    if (buffers != NULL) {
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        for (uint32_t i = 0; i < count; i++) {
+            if (buffers[i] == NULL || ((uintptr_t)buffers[i] & (page_size - 1)) != 0) {
+                base::LogError() << "V4L2_CORE: userptr buffer " << i << " is not page aligned";
+                context->userptr_pool.clear();
+                return E_ALLOC_ERR;
+            }
+            context->userptr_pool.push_back(buffers[i]);
+        }
+        context->userptr_pool_length = length;
+        /*a fixed pool can't grow*/
+        context->max_buffers = 0;
+    }
+
+    context->requested_buffers = count;
+    return E_OK;
+}
+
+/*
+ * Add driver buffers to a running pool (VIDIOC_CREATE_BUFS)
+ * args:
+ *   context - pointer to V4L2Context
+ *   count - number of buffers to add
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_grow_buffers(V4L2Context *context, uint32_t count) {
+    if (context->cap_meth == IO_READ || context->nb_buffers == 0) {
+        base::LogError() << "V4L2_CORE: (grow buffers) no streaming buffer pool to grow";
+        return E_REQBUFS_ERR;
+    }
+    if (context->cap_meth == IO_USERPTR && !context->userptr_pool.empty()) {
+        base::LogError() << "V4L2_CORE: (grow buffers) can't grow a caller supplied userptr pool";
+        context->max_buffers = 0;
+        return E_REQBUFS_ERR;
+    }
+    if (context->nb_buffers + count > context->mem.size() &&
+        (context->capture_thread.joinable() || context->decode_pool != NULL)) {
+        /*the tables would be resized under the threads indexing them*/
+        base::LogError() << "V4L2_CORE: (grow buffers) can't grow past " << context->mem.size()
+                         << " buffers while the stream is dequeued by another thread";
+        return E_BUSY_ERR;
+    }
+
+    struct v4l2_create_buffers create_buffers;
+    memset(&create_buffers, 0, sizeof(struct v4l2_create_buffers));
+    create_buffers.count = count;
+    create_buffers.memory = buffer_memory(context);
+    create_buffers.format = context->format;
+
+    if (xioctl(context, VIDIOC_CREATE_BUFS, &create_buffers) < 0) {
+        base::LogError() << "(VIDIOC_CREATE_BUFS) Unable to add buffers: " << strerror(errno);
+        /*don't try again*/
+        context->max_buffers = 0;
+        return E_REQBUFS_ERR;
+    }
+    if (create_buffers.count == 0) {
+        base::LogWarn() << "(VIDIOC_CREATE_BUFS) driver refused to add buffers";
+        context->max_buffers = 0;
+        return E_REQBUFS_ERR;
+    }
+    if (create_buffers.index != context->nb_buffers) {
+        base::LogError() << "(VIDIOC_CREATE_BUFS) unexpected first index " << create_buffers.index;
+        context->max_buffers = 0;
+        return E_REQBUFS_ERR;
+    }
+
+    uint32_t first_index = context->nb_buffers;
+    context->nb_buffers += create_buffers.count;
+    resize_buff_tables(context);
+
+    if (query_buff(context, first_index) != E_OK) {
+        /*keep the buffers we already had, driver owns the new ones*/
+        unmap_grown_buff(context, first_index);
+        context->nb_buffers = first_index;
+        resize_buff_tables(context);
+        context->max_buffers = 0;
+        return E_QUERYBUF_ERR;
+    }
+
+    add_v4l2_frames(context, first_index);
+
+    int ret = queue_buff(context, first_index);
+    base::LogDebug() << "V4L2_CORE: buffer pool grown to " << context->nb_buffers << " buffers";
+    return ret;
+}
+
+/*
+ * allocate (or reuse) the buffer for read i/o
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: error code  (0- E_OK)
+ */
+static int alloc_read_buff(V4L2Context *context) {
+    size_t frame_size = context->format.fmt.pix.sizeimage;
+    if (frame_size == 0) {
+        /*driver didn't set sizeimage, use the line stride*/
+        frame_size = (size_t)context->format.fmt.pix.bytesperline * context->format.fmt.pix.height;
+    }
+    if (frame_size == 0) {
+        base::LogError() << "V4L2_CORE: (read) unknown frame size";
+        return E_FORMAT_ERR;
+    }
+
+    context->nb_buffers = 1;
+    resize_buff_tables(context);
+
+    /*reuse the current buffer if the new frame fits in it*/
+    if (context->mem[0] != NULL && context->buff_length[0] >= frame_size) {
+        return E_OK;
+    }
+
+    free(context->mem[0]);
+    context->mem[0] = malloc(frame_size);
+    if (context->mem[0] == NULL) {
+        base::LogError() << "V4L2_CORE: couldn't allocate read buffer: " << strerror(errno);
+        context->buff_length[0] = 0;
+        return E_ALLOC_ERR;
+    }
+    context->buff_length[0] = frame_size;
+    return E_OK;
+}
+
+/*
+ * read a frame (read i/o)
+ * args:
+ *   context - pointer to V4L2Context
+ *   frame - pointer to the returned frame view (NULL on error)
+ *
+ * returns: error code (E_OK, E_NO_DATA or E_READ_ERR)
+ */
+static int read_frame(V4L2Context *context, V4L2FrameBuff **frame) {
+    V4L2FrameBuff *frame_buff = &context->frame_queue[0];
+    if (frame_buff->refcount.load(std::memory_order_acquire) != 0) {
+        base::LogError() << "V4L2_CORE: (read) previous frame was not released";
+        return E_READ_ERR;
+    }
+
+    ssize_t bytes = xread(context, context->mem[0], context->buff_length[0]);
+    if (bytes < 0) {
+        if (errno == EAGAIN || errno == EINTR) {
+            return E_NO_DATA;
+        }
+        base::LogError() << "V4L2_CORE: (read) read error: " << strerror(errno);
+        return E_READ_ERR;
+    }
+    if (bytes == 0) {
+        return E_NO_DATA;
+    }
+
+    /*compressed frames have variable size, everything else should fill sizeimage*/
+    uint32_t pixelformat = context->format.fmt.pix.pixelformat;
+    if (pixelformat != V4L2_PIX_FMT_MJPEG && pixelformat != V4L2_PIX_FMT_JPEG &&
+        pixelformat != V4L2_PIX_FMT_H264 && (uint32_t)bytes < context->format.fmt.pix.sizeimage) {
+        context->short_reads++;
+        base::LogDebug() << "V4L2_CORE: (read) short read: " << bytes << " of "
+                         << context->format.fmt.pix.sizeimage << " bytes";
+    }
+
+    frame_buff->index = 0;
+    frame_buff->status = FRAME_READY;
+    frame_buff->refcount.store(1, std::memory_order_relaxed);
+    frame_buff->raw_frame = (uint8_t *)context->mem[0];
+    frame_buff->raw_frame_size = bytes;
+    frame_buff->timestamp = monotonic_time_ns();
+    frame_buff->sequence = context->frame_count;
+    frame_buff->dequeue_timestamp = frame_buff->timestamp;
+    frame_buff->monotonic_timestamp = 1;
+
+    update_frame_stats(context, frame_buff->sequence, frame_buff->timestamp);
+
+    *frame = frame_buff;
+    return E_OK;
+}
+
+/*
+ * count the frames still leased to consumers
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: number of frames with a non zero refcount
+ */
+static uint32_t leased_frames(V4L2Context *context) {
+    uint32_t leased = 0;
+    for (size_t i = 0; i < context->frame_queue.size(); i++) {
+        if (context->frame_queue[i].refcount.load(std::memory_order_acquire) > 0) {
+            leased++;
+        }
+    }
+    return leased;
+}
+
+/*
+ * drop the driver buffers of the current format
+ * args:
+ *   context - pointer to V4L2Context (stream must be off)
+ *
+ * notes:
+ *   mmap buffers are unmapped and deleted, library allocated USERPTR buffers
+ *   and the read buffer are kept so the next format can reuse them
+ *
+ * returns: void
+ */
+static void teardown_buff(V4L2Context *context) {
+    free_v4l2_frames(context);
+
+    switch (context->cap_meth) {
+        case IO_READ:
+            break;
+
+        case IO_MMAP:
+            unmap_buff(context);
+            if (context->nb_buffers > 0) {
+                release_buff(context);
+            }
+            break;
+
+        case IO_USERPTR:
+        default:
+            if (context->nb_buffers > 0) {
+                release_buff(context);
+            }
+            break;
+    }
+}
+
+/*
+ * restart the stream (and capture thread) stopped by set_video_stream_format
+ * args:
+ *   context - pointer to V4L2Context
+ *   stream_status - stream status before the switch
+ *   ring_size - capture thread ring size before the switch (0 - no capture thread)
+ *
+ * returns: error code ( E_OK)
+ */
+static int restart_stream(V4L2Context *context, uint8_t stream_status, uint32_t ring_size) {
+    int ret = E_OK;
+    if (stream_status == STRM_OK && context->streaming != STRM_OK) {
+        ret = v4l2core_start_stream(context);
+    }
+    if (ret == E_OK && ring_size > 0) {
+        ret = v4l2core_start_capture_thread(context, ring_size);
+    }
+    return ret;
+}
+
+/*
+ * check if the buffers are set up for a format
+ * args:
+ *   context - pointer to V4L2Context
+ *   width - video frame width
+ *   height - video frame height
+ *   pixelformat - requested v4l2 pixelformat
+ *
+ * returns: true if set_video_stream_format has nothing to do for the format
+ */
+static bool is_format_set(V4L2Context *context, int32_t width, int32_t height, int pixelformat) {
+    int v4l2_format = pixelformat == V4L2_PIX_FMT_H264 ? V4L2_PIX_FMT_MJPEG : pixelformat;
+    return context->nb_buffers > 0 && !context->frame_queue.empty() &&
+           context->requested_fmt == pixelformat &&
+           context->format.fmt.pix.pixelformat == (uint32_t)v4l2_format &&
+           context->format.fmt.pix.width == (uint32_t)width &&
+           context->format.fmt.pix.height == (uint32_t)height;
+}
+
+/*
+ * apply the context frame interval (fps_num/fps_denom) to the device
+ * args:
+ *   context - pointer to V4L2Context (the stream must be off for most drivers)
+ *
+ * returns: error code ( E_OK)
+ */
+static int apply_framerate(V4L2Context *context) {
+    memset(&context->streamparm, 0, sizeof(struct v4l2_streamparm));
+    context->streamparm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    if (xioctl(context, VIDIOC_G_PARM, &context->streamparm) < 0) {
+        base::LogError() << "(VIDIOC_G_PARM) Unable to get stream parameters: " << strerror(errno);
+        return E_DEVICE_ERR;
+    }
+    if (!(context->streamparm.parm.capture.capability & V4L2_CAP_TIMEPERFRAME)) {
+        base::LogDebug() << "V4L2_CORE: " << context->videodevice
+                         << " doesn't support setting the frame rate";
+        return E_OK;
+    }
+
+    context->streamparm.parm.capture.timeperframe.numerator = context->fps_num;
+    context->streamparm.parm.capture.timeperframe.denominator = context->fps_denom;
+
+    if (xioctl(context, VIDIOC_S_PARM, &context->streamparm) < 0) {
+        base::LogError() << "(VIDIOC_S_PARM) Unable to set frame rate: " << strerror(errno);
+        return E_DEVICE_ERR;
+    }
+
+    /*the driver rounds to the closest interval it supports*/
+    if (context->streamparm.parm.capture.timeperframe.numerator != 0 &&
+        context->streamparm.parm.capture.timeperframe.denominator != 0) {
+        context->fps_num = context->streamparm.parm.capture.timeperframe.numerator;
+        context->fps_denom = context->streamparm.parm.capture.timeperframe.denominator;
+    }
+    base::LogDebug() << "V4L2_CORE: frame interval set to " << context->fps_num << "/"
+                     << context->fps_denom;
+    return E_OK;
+}
+
+/*
+ * set a format and the driver buffers (and frame views) for it
+ * args:
+ *   context - pointer to V4L2Context (stream off, old buffers dropped)
+ *   width - requested video frame width
+ *   height - requested video frame height
+ *   pixelformat - requested v4l2 pixelformat
+ *
+ * returns: error code ( E_OK)
+ */
+static int setup_stream_format(V4L2Context *context, int32_t width, int32_t height,
+                               int pixelformat) {
+    int ret = E_OK;
+    int v4l2_format = pixelformat == V4L2_PIX_FMT_H264 ? V4L2_PIX_FMT_MJPEG : pixelformat;
+
+    context->requested_fmt = pixelformat;
+
+    if (context->requested_fmt == V4L2_PIX_FMT_H264) {
+        base::LogDebug() << "Requested H264 stream is supported through muxed MJPG";
+    }
+
+    context->format.fmt.pix.pixelformat = v4l2_format;
+    context->format.fmt.pix.width = width;
+    context->format.fmt.pix.height = height;
+
+    /*override field and type entries*/
+    context->format.fmt.pix.field = V4L2_FIELD_ANY;
+    context->format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    ret = xioctl(context, VIDIOC_S_FMT, &context->format);
 
     if (ret != 0) {
         base::LogError() << "(VIDIOC_S_FORMAT) Unable to set format: " << strerror(errno);
-        // reset to old format
-        context->requested_fmt = old_format;
         return E_FORMAT_ERR;
     }
 
@@ -429,90 +1357,925 @@ int set_video_stream_format(V4L2Context *context, int32_t width, int32_t height,
                          << context->format.fmt.pix.height;
     }
 
-    // /*
-    //  * try to alloc frame buffers based on requested format
-    // */
-    // ret = alloc_v4l2_frames(vd);
-    // if (ret != E_OK) {
-    //     fprintf(stderr, "V4L2_CORE: Frame allocation returned error (%i)\n", ret);
-    //     return E_ALLOC_ERR;
-    // }
+    /*S_FMT resets the frame interval to the default of the new format*/
+    if (!context->fps_fixed) {
+        v4l2core_get_framerate(context);
+    } else if (apply_framerate(context) != E_OK) {
+        base::LogWarn() << "V4L2_CORE: keeping the default frame rate";
+    }
 
     switch (context->cap_meth) {
         case IO_READ: /*allocate buffer for read*/
-            memset(&context->buf, 0, sizeof(struct v4l2_buffer));
-            context->buf.length = (context->format.fmt.pix.width) *
-                                  (context->format.fmt.pix.height) * 3;  // worst case (rgb)
-            context->mem[context->buf.index] = calloc(context->buf.length, sizeof(uint8_t));
-            if (context->mem[context->buf.index] == NULL) {
-                base::LogError() << "FATAL memory allocation failure (try_video_stream_format): "
-                                 << strerror(errno);
-                exit(-1);
+            ret = alloc_read_buff(context);
+            if (ret != E_OK) {
+                return ret;
             }
             break;
 
         case IO_MMAP:
+        case IO_USERPTR:
         default:
             /* request buffers */
             memset(&context->rb, 0, sizeof(struct v4l2_requestbuffers));
-            context->rb.count = NB_BUFFER;
+            context->rb.count = context->requested_buffers;
             context->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-            context->rb.memory = V4L2_MEMORY_MMAP;
+            context->rb.memory = buffer_memory(context);
 
-            ret = xioctl(context->fd, VIDIOC_REQBUFS, &context->rb);
+            ret = xioctl(context, VIDIOC_REQBUFS, &context->rb);
 
             if (ret < 0) {
                 base::LogError() << "(VIDIOC_REQBUFS) Unable to allocate buffers: "
                                  << strerror(errno);
+                unmap_buff(context);
+                return E_REQBUFS_ERR;
+            }
+            if (context->rb.count == 0) {
+                base::LogError() << "(VIDIOC_REQBUFS) driver granted no buffers";
+                unmap_buff(context);
                 return E_REQBUFS_ERR;
             }
+            /* the driver may adjust the buffer count, use what we actually got */
+            if (context->rb.count != context->requested_buffers) {
+                base::LogDebug() << "(VIDIOC_REQBUFS) requested " << context->requested_buffers
+                                 << " buffers, got " << context->rb.count;
+            }
+            /* USERPTR buffers kept from the previous format beyond the new count */
+            if (context->cap_meth == IO_USERPTR) {
+                free_userptr_buff(context, context->rb.count);
+            }
+            context->nb_buffers = context->rb.count;
+            context->queued_buffers = 0;
+            resize_buff_tables(context);
+
             /* map the buffers */
-            if (query_buff(context)) {
+            if (query_buff(context, 0)) {
                 base::LogError() << "(VIDIOC_QBUFS) Unable to query buffers: " << strerror(errno);
                 /*
                 * delete requested buffers
-                 * no need to unmap as mmap failed for sure
+                 * unmap the ones that got mapped before the failure
                 */
-                base::LogDebug() << "V4L2_CORE: cleaning requestbuffers";
-                memset(&context->rb, 0, sizeof(struct v4l2_requestbuffers));
-                context->rb.count = 0;
-                context->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-                context->rb.memory = V4L2_MEMORY_MMAP;
-                if (xioctl(context->fd, VIDIOC_REQBUFS, &context->rb) < 0) {
-                    base::LogError() << "V4L2_CORE: (VIDIOC_REQBUFS) Unable to delete buffers: "
-                                     << strerror(errno);
-                }
-
+                unmap_buff(context);
+                release_buff(context);
                 return E_QUERYBUF_ERR;
             }
 
+            /*
+             * try to alloc frame buffers based on requested format
+            */
+            ret = alloc_v4l2_frames(context);
+            if (ret != E_OK) {
+                base::LogError() << "V4L2_CORE: Frame allocation returned error " << ret;
+                unmap_buff(context);
+                release_buff(context);
+                return E_ALLOC_ERR;
+            }
+
             /* Queue the buffers */
-            if (queue_buff(context)) {
+            if (queue_buff(context, 0)) {
                 base::LogError() << "V4L2_CORE: (VIDIOC_QBUFS) Unable to queue buffers: "
                                  << strerror(errno);
                 /*delete requested buffers */
-                base::LogDebug() << "V4L2_CORE: cleaning requestbuffers";
+                free_v4l2_frames(context);
                 unmap_buff(context);
-                memset(&context->rb, 0, sizeof(struct v4l2_requestbuffers));
-                context->rb.count = 0;
-                context->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-                context->rb.memory = V4L2_MEMORY_MMAP;
-                if (xioctl(context->fd, VIDIOC_REQBUFS, &context->rb) < 0)
-                    base::LogError() << "V4L2_CORE: (VIDIOC_REQBUFS) Unable to delete buffers: "
-                                     << strerror(errno);
+                release_buff(context);
                 return E_QBUF_ERR;
             }
     }
 
-    // /*this locks the mutex (can't be called while the mutex is being locked)*/
-    // v4l2core_request_framerate_update(vd);
+    if (context->cap_meth == IO_READ) {
+        ret = alloc_v4l2_frames(context);
+        if (ret != E_OK) {
+            base::LogError() << "V4L2_CORE: Frame allocation returned error " << ret;
+            return E_ALLOC_ERR;
+        }
+    }
+
+    return E_OK;
+}
+
+/*
+ * Set device video stream format
+ * args:
+ *   context - pointer to v4l2 context
+ *   width - requested video frame width
+ *   height - requested video frame height
+ *   pixelformat - requested v4l2 pixelformat
+ *
+ * returns: error code ( E_OK)
+ */
+int set_video_stream_format(V4L2Context *context, int32_t width, int32_t height, int pixelformat) {
+    int ret = E_OK;
+    uint64_t switch_start = monotonic_time_ns();
+
+    int v4l2_format = pixelformat == V4L2_PIX_FMT_H264 ? V4L2_PIX_FMT_MJPEG : pixelformat;
+
+    /*nothing to do if the buffers are already set up for this format*/
+    if (is_format_set(context, width, height, pixelformat)) {
+        context->switch_time = monotonic_time_ns() - switch_start;
+        return E_OK;
+    }
+
+    /*the pool workers are sized for the current format, don't restart them behind the caller*/
+    if (context->decode_pool != NULL) {
+        base::LogError() << "V4L2_CORE: stop the decode pool before changing format";
+        return E_BUSY_ERR;
+    }
+
+    uint8_t stream_status = context->streaming;
+    uint32_t ring_size = context->frame_ring ? context->frame_ring->get_capacity() : 0;
+
+    /*frames waiting in the ring go back to the driver, leased frames block the switch*/
+    v4l2core_stop_capture_thread(context);
+    uint32_t leased = leased_frames(context);
+    if (leased > 0) {
+        base::LogError() << "V4L2_CORE: " << leased
+                         << " frames still leased, release them before changing format";
+        restart_stream(context, stream_status, ring_size);
+        return E_BUSY_ERR;
+    }
+
+    /*check the format before dropping the current buffers*/
+    struct v4l2_format try_format;
+    memset(&try_format, 0, sizeof(struct v4l2_format));
+    try_format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    try_format.fmt.pix.pixelformat = v4l2_format;
+    try_format.fmt.pix.width = width;
+    try_format.fmt.pix.height = height;
+    try_format.fmt.pix.field = V4L2_FIELD_ANY;
+    if (xioctl(context, VIDIOC_TRY_FMT, &try_format) < 0 && errno != ENOTTY) {
+        base::LogError() << "(VIDIOC_TRY_FMT) Unable to set format: " << strerror(errno);
+        restart_stream(context, stream_status, ring_size);
+        return E_FORMAT_ERR;
+    }
 
-    // if (stream_status == STRM_OK) v4l2core_start_stream(vd);
+    if (stream_status == STRM_OK) {
+        v4l2core_stop_stream(context);
+    }
 
-    // /*update the current framerate for the device*/
-    // v4l2core_get_framerate(vd);
+    /*the previous format is set up again if the new one fails*/
+    struct v4l2_format old_format = context->format;
+    int old_requested_fmt = context->requested_fmt;
+    bool had_format = context->nb_buffers > 0;
 
-    return E_OK;
+    /*the driver refuses S_FMT (EBUSY) while it still has buffers allocated*/
+    teardown_buff(context);
+
+    ret = setup_stream_format(context, width, height, pixelformat);
+    if (ret != E_OK) {
+        teardown_buff(context);
+        if (had_format && setup_stream_format(context, old_format.fmt.pix.width,
+                                              old_format.fmt.pix.height,
+                                              old_requested_fmt) == E_OK) {
+            base::LogWarn() << "V4L2_CORE: format switch failed, previous format restored";
+            restart_stream(context, stream_status, ring_size);
+        } else {
+            if (had_format) {
+                base::LogError() << "V4L2_CORE: previous format lost, set a format again";
+            }
+            context->format = old_format;
+            context->requested_fmt = old_requested_fmt;
+        }
+        return ret;
+    }
+
+    ret = restart_stream(context, stream_status, ring_size);
+
+    context->switch_time = monotonic_time_ns() - switch_start;
+    base::LogDebug() << "V4L2_CORE: format set to " << context->format.fmt.pix.width << "x"
+                     << context->format.fmt.pix.height << " in " << context->switch_time / 1000
+                     << " us";
+
+    return ret;
+}
+
+/*
+ * Get the device frame interval
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_get_framerate(V4L2Context *context) {
+    memset(&context->streamparm, 0, sizeof(struct v4l2_streamparm));
+    context->streamparm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    if (xioctl(context, VIDIOC_G_PARM, &context->streamparm) < 0) {
+        base::LogError() << "(VIDIOC_G_PARM) Unable to get stream parameters: " << strerror(errno);
+        return E_DEVICE_ERR;
+    }
+
+    if (context->streamparm.parm.capture.timeperframe.numerator != 0 &&
+        context->streamparm.parm.capture.timeperframe.denominator != 0) {
+        context->fps_num = context->streamparm.parm.capture.timeperframe.numerator;
+        context->fps_denom = context->streamparm.parm.capture.timeperframe.denominator;
+    }
+    return E_OK;
+}
+
+/*
+ * Set the device frame interval
+ * args:
+ *   context - pointer to V4L2Context
+ *   fps_num - frame interval numerator (e.g. 1)
+ *   fps_denom - frame interval denominator (e.g. 30 for 30 fps)
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_set_framerate(V4L2Context *context, int fps_num, int fps_denom) {
+    if (fps_num <= 0 || fps_denom <= 0) {
+        base::LogError() << "V4L2_CORE: invalid frame interval " << fps_num << "/" << fps_denom;
+        return E_FORMAT_ERR;
+    }
+
+    context->fps_num = fps_num;
+    context->fps_denom = fps_denom;
+    context->fps_fixed = 1;
+
+    /*no format set yet: applied by set_video_stream_format*/
+    if (context->nb_buffers == 0) {
+        return E_OK;
+    }
+    if (context->streaming != STRM_OK) {
+        return apply_framerate(context);
+    }
+
+    if (context->decode_pool != NULL) {
+        base::LogError() << "V4L2_CORE: stop the decode pool before changing frame rate";
+        return E_BUSY_ERR;
+    }
+
+    /*drivers (uvcvideo) refuse S_PARM while streaming, restart the stream around it*/
+    uint32_t ring_size = context->frame_ring ? context->frame_ring->get_capacity() : 0;
+    v4l2core_stop_capture_thread(context);
+    uint32_t leased = leased_frames(context);
+    if (leased > 0) {
+        base::LogError() << "V4L2_CORE: " << leased
+                         << " frames still leased, release them before changing frame rate";
+        restart_stream(context, STRM_OK, ring_size);
+        return E_BUSY_ERR;
+    }
+
+    v4l2core_stop_stream(context);
+    int ret = apply_framerate(context);
+
+    /*STREAMOFF gave every buffer back to us*/
+    context->queued_buffers = 0;
+    if (queue_buff(context, 0) != E_OK) {
+        return E_QBUF_ERR;
+    }
+
+    int restart_ret = restart_stream(context, STRM_OK, ring_size);
+    return ret != E_OK ? ret : restart_ret;
+}
+
+/*
+ * Get the stream formats of the device
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * notes:
+ *   with V4L2InitOptions::lazy_formats the formats still missing are
+ *   enumerated (and cached) on the first call
+ *
+ * returns: list of stream formats
+ */
+const std::vector<V4L2StreamFormat> &v4l2core_get_stream_formats(V4L2Context *context) {
+    if (context->formats_enumerated != FORMATS_COMPLETE) {
+        enum_frame_format_caps(context, 0);
+        if (!context->cache_file.empty()) {
+            save_format_cache(context);
+        }
+    }
+    return context->stream_formats;
+}
+
+/*
+ * Get one stream format of the device
+ * args:
+ *   context - pointer to V4L2Context
+ *   pixelformat - v4l2 pixel format
+ *
+ * notes:
+ *   with V4L2InitOptions::lazy_formats only this format is enumerated
+ *
+ * returns: pointer to the stream format (NULL if the device lacks it)
+ */
+const V4L2StreamFormat *v4l2core_get_stream_format(V4L2Context *context, int pixelformat) {
+    if (enum_frame_format_caps(context, pixelformat) != E_OK) {
+        return NULL;
+    }
+    for (size_t i = 0; i < context->stream_formats.size(); i++) {
+        if (context->stream_formats[i].pixel_format == pixelformat) {
+            return &context->stream_formats[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Set the fastest mode of the smallest frame at or above a resolution
+ * args:
+ *   context - pointer to V4L2Context
+ *   width - minimum frame width
+ *   height - minimum frame height
+ *   pixelformat - v4l2 pixel format (0 - any format supported by the decoder)
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_set_fastest_mode(V4L2Context *context, int32_t width, int32_t height,
+                              int pixelformat) {
+    V4L2StreamMode mode;
+    int ret = find_stream_mode(context, pixelformat, width, height, 0, &mode);
+    if (ret != E_OK) {
+        return ret;
+    }
+
+    if (is_format_set(context, mode.width, mode.height, mode.pixel_format)) {
+        return v4l2core_set_framerate(context, mode.frame_interval.numerator,
+                                      mode.frame_interval.denominator);
+    }
+
+    /*the new frame interval is applied with the format*/
+    context->fps_num = mode.frame_interval.numerator;
+    context->fps_denom = mode.frame_interval.denominator;
+    context->fps_fixed = 1;
+    return set_video_stream_format(context, mode.width, mode.height, mode.pixel_format);
+}
+
+/*
+ * Get a frame from the device (zero copy)
+ * args:
+ *   context - pointer to V4L2Context
+ *   timeout_ms - poll timeout in ms (-1 blocks until a frame is available)
+ *   frame - pointer to the returned frame view (NULL on error)
+ *
+ * notes:
+ *   frame->raw_frame points straight into the mmap driver buffer, it stays
+ *   valid until the frame is handed back with v4l2core_release_frame
+ *
+ * returns: error code (E_OK, E_SELECT_TIMEOUT_ERR, E_NO_DATA, ...)
+ */
+int v4l2core_get_frame(V4L2Context *context, int timeout_ms, V4L2FrameBuff **frame) {
+    *frame = NULL;
+
+    if (context->streaming != STRM_OK) {
+        base::LogError() << "V4L2_CORE: (get_frame) video stream is not on";
+        return E_NO_STREAM_ERR;
+    }
+
+    short revents = 0;
+    int ret = xpoll(context, POLLIN, timeout_ms, &revents);
+    if (ret < 0) {
+        if (errno == EINTR) {
+            return E_SELECT_TIMEOUT_ERR;
+        }
+        base::LogError() << "V4L2_CORE: (get_frame) poll error: " << strerror(errno);
+        return E_SELECT_ERR;
+    }
+    if (ret == 0) {
+        return E_SELECT_TIMEOUT_ERR;
+    }
+    if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        base::LogError() << "V4L2_CORE: (get_frame) device error (poll revents " << revents
+                         << ")";
+        return E_DEVICE_ERR;
+    }
+
+    return v4l2core_dequeue_frame(context, frame);
+}
+
+/*
+ * Dequeue a ready frame without waiting (zero copy)
+ * args:
+ *   context - pointer to V4L2Context
+ *   frame - pointer to the returned frame view (NULL on error)
+ *
+ * returns: error code (E_OK, E_NO_DATA, E_DQBUF_ERR, ...)
+ */
+int v4l2core_dequeue_frame(V4L2Context *context, V4L2FrameBuff **frame) {
+    *frame = NULL;
+    int ret = E_OK;
+
+    switch (context->cap_meth) {
+        case IO_READ:
+            return read_frame(context, frame);
+
+        case IO_MMAP:
+        case IO_USERPTR:
+        default:
+            struct v4l2_buffer buf;
+            memset(&buf, 0, sizeof(struct v4l2_buffer));
+            buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buf.memory = buffer_memory(context);
+
+            ret = xioctl(context, VIDIOC_DQBUF, &buf);
+            if (ret < 0) {
+                if (errno == EAGAIN) {
+                    return E_NO_DATA;
+                }
+                base::LogError() << "(VIDIOC_DQBUF) Unable to dequeue buffer: " << strerror(errno);
+                return E_DQBUF_ERR;
+            }
+
+            uint64_t dequeue_timestamp = monotonic_time_ns();
+            context->queued_buffers--;
+
+            if (buf.index >= context->frame_queue.size()) {
+                base::LogError() << "(VIDIOC_DQBUF) invalid buffer index " << buf.index;
+                return E_DQBUF_ERR;
+            }
+
+            V4L2FrameBuff *frame_buff = &context->frame_queue[buf.index];
+            frame_buff->index = buf.index;
+            frame_buff->status = FRAME_READY;
+            frame_buff->refcount.store(1, std::memory_order_relaxed);
+            frame_buff->raw_frame = (uint8_t *)context->mem[buf.index];
+            frame_buff->raw_frame_size = buf.bytesused;
+            frame_buff->timestamp = (uint64_t)buf.timestamp.tv_sec * 1000000000ULL +
+                                    (uint64_t)buf.timestamp.tv_usec * 1000ULL;  //in nanosec
+            frame_buff->sequence = buf.sequence;
+            frame_buff->dequeue_timestamp = dequeue_timestamp;
+            frame_buff->monotonic_timestamp = (buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) ==
+                                              V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+
+            update_frame_stats(context, buf.sequence, frame_buff->timestamp);
+
+            if (buf.flags & V4L2_BUF_FLAG_ERROR) {
+                base::LogDebug() << "V4L2_CORE: (VIDIOC_DQBUF) buffer " << buf.index
+                                 << " flagged as corrupted - dropping frame";
+                v4l2core_release_frame(context, frame_buff);
+                return E_NO_DATA;
+            }
+
+            *frame = frame_buff;
+
+            /*
+             * every buffer is out of the driver: the consumer is falling behind
+             * and the next frame would be dropped, so grow the pool if allowed
+             */
+            if (context->queued_buffers == 0 && context->nb_buffers < context->max_buffers) {
+                base::LogDebug() << "V4L2_CORE: no buffers left queued, growing buffer pool";
+                v4l2core_grow_buffers(context, 1);
+            }
+            break;
+    }
+
+    return E_OK;
+}
+
+/*
+ * Take an additional lease on a frame
+ * args:
+ *   frame - pointer to frame view returned by v4l2core_get_frame
+ *
+ * returns: pointer to the frame view
+ */
+V4L2FrameBuff *v4l2core_frame_ref(V4L2FrameBuff *frame) {
+    frame->refcount.fetch_add(1, std::memory_order_relaxed);
+    return frame;
+}
+
+/*
+ * Release a frame lease, the last lease requeues the driver buffer
+ * args:
+ *   context - pointer to V4L2Context
+ *   frame - pointer to frame view returned by v4l2core_get_frame
+ *
+ * returns: error code (E_OK or E_QBUF_ERR)
+ */
+int v4l2core_release_frame(V4L2Context *context, V4L2FrameBuff *frame) {
+    /*never go below zero: a double release must not eat a lease taken meanwhile*/
+    int refcount = frame->refcount.load(std::memory_order_relaxed);
+    do {
+        if (refcount < 1) {
+            base::LogError() << "V4L2_CORE: frame " << frame->index << " released more than once";
+            return E_QBUF_ERR;
+        }
+    } while (!frame->refcount.compare_exchange_weak(refcount, refcount - 1,
+                                                    std::memory_order_acq_rel,
+                                                    std::memory_order_relaxed));
+    if (refcount > 1) {
+        /*other consumers still hold the frame*/
+        return E_OK;
+    }
+
+    if (context->latency_stats) {
+        record_frame_latency(context, frame);
+    }
+
+    /*reset the view before the driver (and the capture thread) can reuse the buffer*/
+    frame->status = FRAME_DONE;
+    frame->raw_frame_size = 0;
+    frame->raw_frame = NULL;
+
+    switch (context->cap_meth) {
+        case IO_READ:
+            break;
+
+        case IO_MMAP:
+        case IO_USERPTR:
+        default:
+            struct v4l2_buffer buf;
+            memset(&buf, 0, sizeof(struct v4l2_buffer));
+            buf.index = frame->index;
+            buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buf.memory = buffer_memory(context);
+            if (context->cap_meth == IO_USERPTR) {
+                buf.m.userptr = (unsigned long)context->mem[frame->index];
+                buf.length = context->buff_length[frame->index];
+            }
+
+            if (xioctl(context, VIDIOC_QBUF, &buf) < 0) {
+                base::LogError() << "(VIDIOC_QBUF) Unable to queue buffer " << frame->index << ": "
+                                 << strerror(errno);
+                return E_QBUF_ERR;
+            }
+            context->queued_buffers++;
+            break;
+    }
+
+    return E_OK;
+}
+
+/*
+ * Set the format of the decoded frames
+ * args:
+ *   context - pointer to V4L2Context
+ *   format - V4L2_PIX_FMT_YUV420 (I420, default) or V4L2_PIX_FMT_NV12
+ *
+ * returns: error code (E_OK or E_FORMAT_ERR)
+ */
+int v4l2core_set_yuv_format(V4L2Context *context, uint32_t format) {
+    if (format != V4L2_PIX_FMT_YUV420 && format != V4L2_PIX_FMT_NV12) {
+        base::LogError() << "V4L2_CORE: (set_yuv_format) unsupported format " << format;
+        return E_FORMAT_ERR;
+    }
+    context->yuv_format = format;
+    return E_OK;
+}
+
+/*
+ * Set the threads decoding one MJPEG frame
+ * args:
+ *   context - pointer to V4L2Context
+ *   threads - decode threads, the caller included (1 - serial, default)
+ *
+ * returns: error code (E_OK or E_ALLOC_ERR)
+ */
+int v4l2core_set_decode_threads(V4L2Context *context, uint32_t threads) {
+    if (threads == 0) {
+        base::LogError() << "V4L2_CORE: (set_decode_threads) invalid thread count";
+        return E_ALLOC_ERR;
+    }
+    context->decode_threads = threads;
+    if (context->jpeg_decoder != NULL) {
+        context->jpeg_decoder->set_threads(threads);
+    }
+    return E_OK;
+}
+
+/*
+ * convert a packed 4:2:2 frame into frame->yuv_frame
+ * args:
+ *   context - pointer to V4L2Context
+ *   frame - pointer to frame view
+ *
+ * returns: error code (E_OK)
+ */
+static int convert_packed_frame(V4L2Context *context, V4L2FrameBuff *frame) {
+    /*the last line only needs its pixels, not the padding*/
+    uint32_t bytesperline = context->format.fmt.pix.bytesperline;
+    if (bytesperline == 0) {
+        bytesperline = frame->width * 2;
+    }
+    size_t min_size = (size_t)bytesperline * (frame->height - 1) + frame->width * 2;
+    if (frame->raw_frame_size < min_size) {
+        base::LogWarn() << "V4L2_CORE: (decode_frame) short frame " << frame->raw_frame_size
+                        << " < " << min_size;
+        return E_DECODE_ERR;
+    }
+
+    return convert_packed422(frame->raw_frame, bytesperline, context->format.fmt.pix.pixelformat,
+                             frame->width, frame->height, frame->yuv_frame, context->yuv_format);
+}
+
+/*
+ * make sure a frame view holds a decoder scratch of size bytes in tmp_buffer
+ * args:
+ *   buff - pointer to frame view
+ *   size - scratch size (bytes)
+ *
+ * returns: error code (E_OK or E_ALLOC_ERR)
+ */
+static int alloc_decoder_scratch(V4L2FrameBuff *buff, size_t size) {
+    if (buff->tmp_buffer != NULL && buff->tmp_buffer_max_size >= size) {
+        return E_OK;
+    }
+    free(buff->tmp_buffer);
+    buff->tmp_buffer = (uint8_t *)malloc(size);
+    buff->tmp_buffer_max_size = buff->tmp_buffer ? size : 0;
+    if (buff->tmp_buffer == NULL) {
+        base::LogError() << "V4L2_CORE: couldn't alloc the decoder scratch";
+        return E_ALLOC_ERR;
+    }
+    return E_OK;
+}
+
+/*
+ * get the context MJPEG decoder, created on first use
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: pointer to the decoder
+ */
+static V4L2JpegDecoder *get_jpeg_decoder(V4L2Context *context) {
+    if (context->jpeg_decoder == NULL) {
+        context->jpeg_decoder = new V4L2JpegDecoder();
+        context->jpeg_decoder->set_threads(context->decode_threads);
+    }
+    return context->jpeg_decoder;
+}
+
+/*
+ * decode a MJPEG frame into frame->yuv_frame
+ * args:
+ *   context - pointer to V4L2Context
+ *   frame - pointer to frame view
+ *
+ * notes:
+ *   frame->tmp_buffer is the decoder scratch, sized once for the largest
+ *   payload of the buffer
+ *
+ * returns: error code (E_OK)
+ */
+static int decode_mjpeg_frame(V4L2Context *context, V4L2FrameBuff *frame) {
+    size_t scratch_size = V4L2JpegDecoder::get_scratch_size(
+        std::max(frame->raw_frame_size, frame->raw_frame_max_size));
+    if (alloc_decoder_scratch(frame, scratch_size) != E_OK) {
+        return E_ALLOC_ERR;
+    }
+
+    int ret = get_jpeg_decoder(context)->decode(
+        frame->raw_frame, frame->raw_frame_size, frame->width, frame->height, frame->yuv_frame,
+        context->yuv_format, frame->tmp_buffer, frame->tmp_buffer_max_size);
+    if (ret != E_OK) {
+        base::LogWarn() << "V4L2_CORE: (decode_frame) mjpeg frame " << frame->sequence
+                        << " decode error " << ret;
+    }
+    return ret;
+}
+
+/*
+ * Decode a frame into frame->yuv_frame
+ * args:
+ *   context - pointer to V4L2Context
+ *   frame - pointer to frame view returned by v4l2core_get_frame
+ *
+ * returns: error code (E_OK, E_NO_CODEC, E_DECODE_ERR, ...)
+ */
+int v4l2core_decode_frame(V4L2Context *context, V4L2FrameBuff *frame) {
+    if (frame->raw_frame == NULL) {
+        base::LogError() << "V4L2_CORE: (decode_frame) frame " << frame->index << " has no data";
+        return E_NO_DATA;
+    }
+
+    uint32_t pixelformat = context->format.fmt.pix.pixelformat;
+    int mjpeg = pixelformat == V4L2_PIX_FMT_MJPEG || pixelformat == V4L2_PIX_FMT_JPEG;
+    if (!mjpeg && !is_packed422_format(pixelformat)) {
+        return E_NO_CODEC;
+    }
+
+    if (frame->yuv_frame == NULL) {
+        size_t yuv_size = yuv420_frame_size(frame->width, frame->height);
+        frame->yuv_frame = (uint8_t *)malloc(yuv_size);
+        if (frame->yuv_frame == NULL) {
+            base::LogError() << "V4L2_CORE: (decode_frame) couldn't alloc the yuv frame";
+            return E_ALLOC_ERR;
+        }
+        frame->yuv_frame_max_size = yuv_size;
+    }
+
+    if (mjpeg) {
+        return decode_mjpeg_frame(context, frame);
+    }
+    return convert_packed_frame(context, frame);
+}
+
+/*
+ * Decode a MJPEG frame at reduced size into the context preview frame
+ * args:
+ *   context - pointer to V4L2Context
+ *   frame - pointer to frame view returned by v4l2core_get_frame
+ *   scale - size divider (2, 4 or 8, 1 - full size)
+ *   preview - pointer to the returned preview frame (NULL on error)
+ *
+ * returns: error code (E_OK, E_NO_CODEC if not MJPEG, E_FORMAT_ERR for other scales, ...)
+ */
+int v4l2core_decode_preview(V4L2Context *context, V4L2FrameBuff *frame, int scale,
+                            V4L2FrameBuff **preview) {
+    *preview = NULL;
+    if (frame->raw_frame == NULL) {
+        base::LogError() << "V4L2_CORE: (decode_preview) frame " << frame->index << " has no data";
+        return E_NO_DATA;
+    }
+    uint32_t pixelformat = context->format.fmt.pix.pixelformat;
+    if (pixelformat != V4L2_PIX_FMT_MJPEG && pixelformat != V4L2_PIX_FMT_JPEG) {
+        return E_NO_CODEC;
+    }
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8) {
+        base::LogError() << "V4L2_CORE: (decode_preview) unsupported scale 1/" << scale;
+        return E_FORMAT_ERR;
+    }
+
+    if (context->preview_frame == NULL) {
+        context->preview_frame = new V4L2FrameBuff();
+        context->preview_frame->index = -1;
+        context->preview_frame->dmabuf_fd = -1;
+    }
+    V4L2FrameBuff *buff = context->preview_frame;
+
+    /*the preview only grows its buffers, switching scales doesn't allocate*/
+    int width = V4L2JpegDecoder::get_scaled_size(frame->width, scale);
+    int height = V4L2JpegDecoder::get_scaled_size(frame->height, scale);
+    size_t yuv_size = yuv420_frame_size(width, height);
+    if (buff->yuv_frame == NULL || buff->yuv_frame_max_size < yuv_size) {
+        free(buff->yuv_frame);
+        buff->yuv_frame = (uint8_t *)malloc(yuv_size);
+        buff->yuv_frame_max_size = buff->yuv_frame ? yuv_size : 0;
+        if (buff->yuv_frame == NULL) {
+            base::LogError() << "V4L2_CORE: (decode_preview) couldn't alloc the yuv frame";
+            buff->width = 0;
+            buff->height = 0;
+            return E_ALLOC_ERR;
+        }
+    }
+    buff->width = width;
+    buff->height = height;
+    buff->status = FRAME_DONE;
+    buff->timestamp = frame->timestamp;
+    buff->sequence = frame->sequence;
+    buff->dequeue_timestamp = frame->dequeue_timestamp;
+    buff->monotonic_timestamp = frame->monotonic_timestamp;
+
+    /*sized for the largest payload of the driver buffers, as decode_mjpeg_frame*/
+    size_t scratch_size = V4L2JpegDecoder::get_scratch_size(
+        std::max(frame->raw_frame_size, frame->raw_frame_max_size));
+    if (alloc_decoder_scratch(buff, scratch_size) != E_OK) {
+        return E_ALLOC_ERR;
+    }
+
+    int ret = get_jpeg_decoder(context)->decode_scaled(
+        frame->raw_frame, frame->raw_frame_size, frame->width, frame->height, scale,
+        buff->yuv_frame, context->yuv_format, buff->tmp_buffer, buff->tmp_buffer_max_size);
+    if (ret != E_OK) {
+        base::LogWarn() << "V4L2_CORE: (decode_preview) mjpeg frame " << frame->sequence
+                        << " decode error " << ret;
+    }
+    *preview = buff;
+    return ret;
+}
+
+/*
+ * Get the measured frame rate
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: frames per second over the last FPS_WINDOW frames (driver timestamps)
+ */
+double v4l2core_get_realfps(V4L2Context *context) {
+    return context->real_fps.load(std::memory_order_relaxed);
+}
+
+/*
+ * Get the number of frames dropped by the driver
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: frames missing from the v4l2_buffer.sequence numbers since stream start
+ */
+uint64_t v4l2core_get_dropped_frames(V4L2Context *context) {
+    return context->dropped_frames.load(std::memory_order_relaxed);
+}
+
+/*
+ * Get the duration of the last format switch
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: time spent in the last set_video_stream_format (ns)
+ */
+uint64_t v4l2core_get_switch_time(V4L2Context *context) {
+    return context->switch_time;
+}
+
+/*
+ * Get the number of frames dequeued
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: frames dequeued since stream start
+ */
+uint64_t v4l2core_get_frame_count(V4L2Context *context) {
+    return context->frame_count.load(std::memory_order_relaxed);
+}
+
+/*
+ * Enable or disable the per frame latency histograms
+ * args:
+ *   context - pointer to V4L2Context
+ *   enable - 1 to record the frame latencies; 0 to stop recording
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2core_set_latency_stats(V4L2Context *context, uint8_t enable) {
+    if (enable && context->latency_stats == NULL) {
+        context->latency_stats = new V4L2LatencyHistogram[LATENCY_STAGES];
+    } else if (!enable && context->latency_stats != NULL) {
+        delete[] context->latency_stats;
+        context->latency_stats = NULL;
+    }
+    return E_OK;
+}
+
+/*
+ * Get the latency histogram of a frame stage
+ * args:
+ *   context - pointer to V4L2Context
+ *   stage - latency stage (LATENCY_DRIVER_TO_DEQUEUE, ...)
+ *
+ * returns: pointer to the histogram (NULL if disabled or invalid stage)
+ */
+const V4L2LatencyHistogram *v4l2core_get_latency_histogram(V4L2Context *context, int stage) {
+    if (context->latency_stats == NULL || stage < 0 || stage >= LATENCY_STAGES) {
+        return NULL;
+    }
+    return &context->latency_stats[stage];
+}
+
+/*
+ * Get a latency percentile of a frame stage
+ * args:
+ *   context - pointer to V4L2Context
+ *   stage - latency stage (LATENCY_DRIVER_TO_DEQUEUE, ...)
+ *   percentile - percentile (0-100, e.g. 50, 99, 99.9)
+ *
+ * returns: latency in ns (0 if disabled or no frames recorded)
+ */
+uint64_t v4l2core_get_latency(V4L2Context *context, int stage, double percentile) {
+    const V4L2LatencyHistogram *histogram = v4l2core_get_latency_histogram(context, stage);
+    if (histogram == NULL) {
+        return 0;
+    }
+    return histogram->value_at_percentile(percentile);
+}
+
+/*
+ * Get the ioctl statistics (calls, retries, errors and latency per request)
+ * args:
+ *   stats - returned statistics, one entry per ioctl request called so far
+ *
+ * notes:
+ *   the statistics are process wide (every device), the latency
+ *   histograms stay valid until the process exits
+ *
+ * returns: void
+ */
+void v4l2core_get_ioctl_stats(std::vector<V4L2IoctlStats> &stats) {
+    get_ioctl_stats(stats);
+}
+
+/*
+ * Clear the ioctl statistics
+ *
+ * returns: void
+ */
+void v4l2core_reset_ioctl_stats() {
+    reset_ioctl_stats();
+}
+
+/*
+ * Close video device and free all allocated resources
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: void
+ */
+void v4l2core_close_dev(V4L2Context *context) {
+    if (context == NULL) {
+        return;
+    }
+
+    v4l2core_stop_capture_thread(context);
+    v4l2core_stop_decode_pool(context);
+
+    if (context->streaming == STRM_OK) {
+        v4l2core_stop_stream(context);
+    }
+
+    unmap_buff(context);
+    free_v4l2_frames(context);
+
+    clean_v4l2_dev(context);
 }
 
 }  // namespace uvc
\ No newline at end of file
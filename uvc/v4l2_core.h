@@ -1,6 +1,11 @@
 #pragma once
 
 #include "v4l2_context.h"
+#include "v4l2_convert.h"
+#include "v4l2_device.h"
+#include "v4l2_format.h"
+#include "v4l2_ioctl_stats.h"
+#include "v4l2_latency.h"
 
 namespace uvc {
 
@@ -13,6 +18,36 @@ namespace uvc {
  */
 V4L2Context *v4l2core_init_dev(const char *device);
 
+/*
+ * Initiate video device handler with options
+ * args:
+ *   device - device sys data (from V4l2Device)
+ *   options - init options (format cache, controls)
+ *
+ * notes:
+ *   with options.cache_dir set the stream formats (and controls) are loaded
+ *   from a cache file keyed by VID/PID/bcdDevice/serial instead of being
+ *   enumerated, the file is (re)written after every enumeration;
+ *   with options.lazy_formats (and no cache hit) nothing is enumerated at
+ *   init, so opening and setting a known mode only costs a few ioctls;
+ *   with options.direct_io the device is driven with raw open/ioctl/mmap/read,
+ *   libv4l2 (and its emulated formats and conversions) is never involved;
+ *   options.backend replaces both (e.g. V4L2FakeBackend)
+ *
+ * returns: pointer to V4L2Context handler (or NULL on error)
+ */
+V4L2Context *v4l2core_init_dev(const V4L2DeviceSysData &device, const V4L2InitOptions &options);
+
+/*
+ * Initiate video device handler with options (no device sys data)
+ * args:
+ *   device - device name (e.g: "/dev/video0", any name for a fake backend)
+ *   options - init options (the format cache needs the device sys data)
+ *
+ * returns: pointer to V4L2Context handler (or NULL on error)
+ */
+V4L2Context *v4l2core_init_dev(const char *device, const V4L2InitOptions &options);
+
 /*
  * Start video stream
  * args:
@@ -39,7 +74,457 @@ int v4l2core_stop_stream(V4L2Context *context);
  *   height - requested video frame height
  *   pixelformat - requested v4l2 pixelformat
  *
+ * notes:
+ *   a running stream (and capture thread) is stopped and restarted with the
+ *   new format; all frames must be released and the decode pool stopped
+ *   first (E_BUSY_ERR otherwise);
+ *   read and library allocated USERPTR buffers are reused when the new
+ *   sizeimage fits, mmap buffers are unmapped and requested again;
+ *   a frame interval set with v4l2core_set_framerate is applied again,
+ *   otherwise fps_num/fps_denom are read back from the driver default;
+ *   on errors after the old buffers were dropped the previous format is set
+ *   up again and the stream restarted; if that fails too the stream stays
+ *   stopped without buffers and a format must be set again
+ *
  * returns: error code ( E_OK)
  */
 int set_video_stream_format(V4L2Context *context, int32_t width, int32_t height, int pixelformat);
+
+/*
+ * Get the device frame interval
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * notes:
+ *   updates fps_num and fps_denom with the interval reported by the driver
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_get_framerate(V4L2Context *context);
+
+/*
+ * Set the device frame interval
+ * args:
+ *   context - pointer to V4L2Context
+ *   fps_num - frame interval numerator (e.g. 1)
+ *   fps_denom - frame interval denominator (e.g. 30 for 30 fps)
+ *
+ * notes:
+ *   the interval is applied again by every set_video_stream_format (which
+ *   otherwise keeps the driver default of the format); a running stream
+ *   is restarted around VIDIOC_S_PARM (all frames must be released and the
+ *   decode pool stopped, E_BUSY_ERR otherwise);
+ *   fps_num and fps_denom hold the interval the driver actually picked
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_set_framerate(V4L2Context *context, int fps_num, int fps_denom);
+
+/*
+ * Get the stream formats of the device
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * notes:
+ *   with V4L2InitOptions::lazy_formats the formats still missing are
+ *   enumerated (and cached) on the first call
+ *
+ * returns: list of stream formats
+ */
+const std::vector<V4L2StreamFormat> &v4l2core_get_stream_formats(V4L2Context *context);
+
+/*
+ * Get one stream format of the device
+ * args:
+ *   context - pointer to V4L2Context
+ *   pixelformat - v4l2 pixel format
+ *
+ * notes:
+ *   with V4L2InitOptions::lazy_formats only this format is enumerated
+ *
+ * returns: pointer to the stream format (NULL if the device lacks it)
+ */
+const V4L2StreamFormat *v4l2core_get_stream_format(V4L2Context *context, int pixelformat);
+
+/*
+ * Set the fastest mode of the smallest frame at or above a resolution
+ * args:
+ *   context - pointer to V4L2Context
+ *   width - minimum frame width
+ *   height - minimum frame height
+ *   pixelformat - v4l2 pixel format (0 - any format supported by the decoder)
+ *
+ * notes:
+ *   picks the mode with find_stream_mode (mode index, the intervals of a
+ *   size range are queried for the picked size), then sets its format and
+ *   shortest frame interval
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_set_fastest_mode(V4L2Context *context, int32_t width, int32_t height,
+                              int pixelformat);
+
+/*
+ * Set the number of driver buffers
+ * args:
+ *   context - pointer to V4L2Context
+ *   count - number of buffers requested at the next set_video_stream_format
+ *   max_count - limit for growing the pool while streaming (0 - never grow)
+ *
+ * notes:
+ *   the driver may grant a different number of buffers (see nb_buffers);
+ *   the pool grows one buffer at a time whenever a dequeue leaves no buffer
+ *   queued in the driver, until max_count is reached
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_set_buffer_count(V4L2Context *context, uint32_t count, uint32_t max_count);
+
+/*
+ * Enable or disable dmabuf export of the driver buffers
+ * args:
+ *   context - pointer to V4L2Context
+ *   enable - export buffers (VIDIOC_EXPBUF) at the next set_video_stream_format
+ *
+ * notes:
+ *   exported fds are set in V4L2FrameBuff::dmabuf_fd and are owned by the
+ *   context (they are closed when the buffers are unmapped); consumers that
+ *   need them past that point must dup() them
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_set_dmabuf_export(V4L2Context *context, uint8_t enable);
+
+/*
+ * Set the capture method
+ * args:
+ *   context - pointer to V4L2Context
+ *   method - IO_MMAP, IO_USERPTR or IO_READ
+ *
+ * notes:
+ *   must be called before set_video_stream_format allocates the buffers
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_set_capture_method(V4L2Context *context, int method);
+
+/*
+ * Set the buffer pool used for USERPTR i/o
+ * args:
+ *   context - pointer to V4L2Context
+ *   buffers - caller supplied page aligned buffers (NULL - allocated by the library)
+ *   count - number of buffers
+ *   length - length of each caller supplied buffer (ignored for library buffers)
+ *   hugepages - back library allocated buffers with huge pages (if available)
+ *
+ * notes:
+ *   caller supplied buffers must stay valid until the context is closed and
+ *   must be large enough for format.fmt.pix.sizeimage; a caller supplied pool
+ *   has a fixed size and is never grown
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_set_userptr_pool(V4L2Context *context, void **buffers, uint32_t count,
+                              size_t length, uint8_t hugepages);
+
+/*
+ * Add driver buffers to a running pool (VIDIOC_CREATE_BUFS)
+ * args:
+ *   context - pointer to V4L2Context
+ *   count - number of buffers to add
+ *
+ * returns: error code ( E_OK)
+ */
+int v4l2core_grow_buffers(V4L2Context *context, uint32_t count);
+
+/*
+ * Get a frame from the device (zero copy)
+ * args:
+ *   context - pointer to V4L2Context
+ *   timeout_ms - poll timeout in ms (-1 blocks until a frame is available)
+ *   frame - pointer to the returned frame view (NULL on error)
+ *
+ * notes:
+ *   frame->raw_frame points straight into the mmap driver buffer, it stays
+ *   valid until the frame is handed back with v4l2core_release_frame
+ *
+ * returns: error code (E_OK, E_SELECT_TIMEOUT_ERR, E_NO_DATA, ...)
+ */
+int v4l2core_get_frame(V4L2Context *context, int timeout_ms, V4L2FrameBuff **frame);
+
+/*
+ * Dequeue a ready frame without waiting (zero copy)
+ * args:
+ *   context - pointer to V4L2Context
+ *   frame - pointer to the returned frame view (NULL on error)
+ *
+ * notes:
+ *   for callers that already know the device fd is readable (e.g. from their
+ *   own poll/epoll loop); v4l2core_get_frame is poll + v4l2core_dequeue_frame
+ *
+ * returns: error code (E_OK, E_NO_DATA, E_DQBUF_ERR, ...)
+ */
+int v4l2core_dequeue_frame(V4L2Context *context, V4L2FrameBuff **frame);
+
+/*
+ * Take an additional lease on a frame
+ * args:
+ *   frame - pointer to frame view returned by v4l2core_get_frame
+ *
+ * notes:
+ *   a dequeued frame starts with one lease (the caller of v4l2core_get_frame);
+ *   every consumer that shares it takes its own lease and releases it with
+ *   v4l2core_release_frame, the driver buffer is requeued on the last release
+ *
+ * returns: pointer to the frame view
+ */
+V4L2FrameBuff *v4l2core_frame_ref(V4L2FrameBuff *frame);
+
+/*
+ * Release a frame lease, the last lease requeues the driver buffer
+ * args:
+ *   context - pointer to V4L2Context
+ *   frame - pointer to frame view returned by v4l2core_get_frame
+ *
+ * returns: error code (E_OK or E_QBUF_ERR)
+ */
+int v4l2core_release_frame(V4L2Context *context, V4L2FrameBuff *frame);
+
+/*
+ * Set the format of the decoded frames
+ * args:
+ *   context - pointer to V4L2Context
+ *   format - V4L2_PIX_FMT_YUV420 (I420, default) or V4L2_PIX_FMT_NV12
+ *
+ * returns: error code (E_OK or E_FORMAT_ERR)
+ */
+int v4l2core_set_yuv_format(V4L2Context *context, uint32_t format);
+
+/*
+ * Set the threads decoding one MJPEG frame
+ * args:
+ *   context - pointer to V4L2Context
+ *   threads - decode threads, the caller included (1 - serial, default)
+ *
+ * notes:
+ *   the restart intervals (DRI/RSTn) of a frame are spread over the
+ *   threads, which cuts the latency of v4l2core_decode_frame on large
+ *   frames; frames without restart markers are still decoded serially
+ *
+ * returns: error code (E_OK or E_ALLOC_ERR)
+ */
+int v4l2core_set_decode_threads(V4L2Context *context, uint32_t threads);
+
+/*
+ * Decode a frame into frame->yuv_frame
+ * args:
+ *   context - pointer to V4L2Context
+ *   frame - pointer to frame view returned by v4l2core_get_frame
+ *
+ * notes:
+ *   yuv_frame is allocated on first use and kept with the frame view, it
+ *   holds yuv420_frame_size(width, height) bytes in context->yuv_format and
+ *   stays valid after the frame is released (until the next decode of it);
+ *   packed 4:2:2 frames (YUYV, UYVY, YVYU, VYUY) are converted with the
+ *   fastest kernel the cpu supports (convert_simd_level), honouring bytesperline;
+ *   MJPEG/JPEG frames are decoded with the context V4L2JpegDecoder (frames
+ *   without DHT get the standard huffman tables), frame->tmp_buffer is its
+ *   scratch so the steady state makes no allocations; the decoder is shared,
+ *   decode the frames of a context from one thread at a time
+ *
+ * returns: error code (E_OK, E_NO_CODEC for formats without a decoder, E_DECODE_ERR, ...)
+ */
+int v4l2core_decode_frame(V4L2Context *context, V4L2FrameBuff *frame);
+
+/*
+ * Decode a MJPEG frame at reduced size into the context preview frame
+ * args:
+ *   context - pointer to V4L2Context
+ *   frame - pointer to frame view returned by v4l2core_get_frame
+ *   scale - size divider (2, 4 or 8, 1 - full size)
+ *   preview - pointer to the returned preview frame (NULL on error)
+ *
+ * notes:
+ *   the scaling happens in the dct domain: each block only transforms its
+ *   low frequency coefficients (4x4, 2x2 or the dc alone) and the others
+ *   are skipped while entropy decoding, far cheaper than a full decode and
+ *   a resize; the preview is a frame view owned by the context (no driver
+ *   buffer, index -1) with width, height, timestamps and yuv_frame in
+ *   context->yuv_format, overwritten by the next call; frame->yuv_frame is
+ *   untouched, so the same frame can also go through v4l2core_decode_frame
+ *   for the full size stream; the decoder is shared, as v4l2core_decode_frame
+ *
+ * returns: error code (E_OK, E_NO_CODEC if not MJPEG, E_FORMAT_ERR for other scales, ...)
+ */
+int v4l2core_decode_preview(V4L2Context *context, V4L2FrameBuff *frame, int scale,
+                            V4L2FrameBuff **preview);
+
+/*
+ * Start the MJPEG decode pool of a context
+ * args:
+ *   context - pointer to V4L2Context (MJPEG or JPEG stream must be on)
+ *   workers - number of decode threads
+ *   slots - number of decoded frame slots (more than workers)
+ *
+ * notes:
+ *   the pool dequeues every frame: take the decoded frames with
+ *   v4l2core_get_decoded_frame and hand them back with
+ *   v4l2core_release_decoded_frame (never call v4l2core_get_frame or start
+ *   the capture thread while the pool runs); the frames come out in the
+ *   format set with v4l2core_set_yuv_format; E_BUSY_ERR while the capture
+ *   thread runs or a V4l2Reactor watches the context
+ *
+ * returns: error code (E_OK, E_NO_STREAM_ERR, E_NO_CODEC, E_BUSY_ERR or E_ALLOC_ERR)
+ */
+int v4l2core_start_decode_pool(V4L2Context *context, uint32_t workers, uint32_t slots);
+
+/*
+ * Stop the MJPEG decode pool of a context
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * notes:
+ *   decoded frames still held by the consumer are invalid once it returns
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2core_stop_decode_pool(V4L2Context *context);
+
+/*
+ * Get the next decoded frame, in capture order (consumer side)
+ * args:
+ *   context - pointer to V4L2Context
+ *   timeout_ms - time to wait for the next frame (0 - don't wait, -1 - forever)
+ *   frame - pointer to the returned frame (NULL on error)
+ *
+ * notes:
+ *   a frame that failed to decode is still delivered, with its decoder
+ *   error in status
+ *
+ * returns: error code (E_OK, E_NO_DATA or E_NO_STREAM_ERR)
+ */
+int v4l2core_get_decoded_frame(V4L2Context *context, int timeout_ms, V4L2DecodedFrame **frame);
+
+/*
+ * Hand a decoded frame back to the pool
+ * args:
+ *   context - pointer to V4L2Context
+ *   frame - frame from v4l2core_get_decoded_frame
+ *
+ * returns: error code (E_OK, E_NO_STREAM_ERR or E_UNKNOWN_ERR)
+ */
+int v4l2core_release_decoded_frame(V4L2Context *context, V4L2DecodedFrame *frame);
+
+/*
+ * Get the number of frames dropped because every decode slot was busy
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: dropped frames (0 if the pool is not running)
+ */
+uint64_t v4l2core_get_decode_dropped_frames(V4L2Context *context);
+
+/*
+ * Get the measured frame rate
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * notes:
+ *   the frame statistics are atomic counters, they can be read from any thread
+ *
+ * returns: frames per second over the last FPS_WINDOW frames (driver timestamps)
+ */
+double v4l2core_get_realfps(V4L2Context *context);
+
+/*
+ * Get the number of frames dropped by the driver
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: frames missing from the v4l2_buffer.sequence numbers since stream start
+ */
+uint64_t v4l2core_get_dropped_frames(V4L2Context *context);
+
+/*
+ * Get the duration of the last format switch
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: time spent in the last set_video_stream_format (ns)
+ */
+uint64_t v4l2core_get_switch_time(V4L2Context *context);
+
+/*
+ * Get the number of frames dequeued
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: frames dequeued since stream start
+ */
+uint64_t v4l2core_get_frame_count(V4L2Context *context);
+
+/*
+ * Enable or disable the per frame latency histograms
+ * args:
+ *   context - pointer to V4L2Context
+ *   enable - 1 to record the frame latencies; 0 to stop recording
+ *
+ * notes:
+ *   call it while the stream is stopped, the histograms are reset on
+ *   v4l2core_start_stream; latencies are recorded on the last frame release
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2core_set_latency_stats(V4L2Context *context, uint8_t enable);
+
+/*
+ * Get the latency histogram of a frame stage
+ * args:
+ *   context - pointer to V4L2Context
+ *   stage - latency stage (LATENCY_DRIVER_TO_DEQUEUE, ...)
+ *
+ * returns: pointer to the histogram (NULL if disabled or invalid stage)
+ */
+const V4L2LatencyHistogram *v4l2core_get_latency_histogram(V4L2Context *context, int stage);
+
+/*
+ * Get a latency percentile of a frame stage
+ * args:
+ *   context - pointer to V4L2Context
+ *   stage - latency stage (LATENCY_DRIVER_TO_DEQUEUE, ...)
+ *   percentile - percentile (0-100, e.g. 50, 99, 99.9)
+ *
+ * returns: latency in ns (0 if disabled or no frames recorded)
+ */
+uint64_t v4l2core_get_latency(V4L2Context *context, int stage, double percentile);
+
+/*
+ * Get the ioctl statistics (calls, retries, errors and latency per request)
+ * args:
+ *   stats - returned statistics, one entry per ioctl request called so far
+ *
+ * notes:
+ *   the statistics are process wide (every device), the latency
+ *   histograms stay valid until the process exits
+ *
+ * returns: void
+ */
+void v4l2core_get_ioctl_stats(std::vector<V4L2IoctlStats> &stats);
+
+/*
+ * Clear the ioctl statistics
+ *
+ * returns: void
+ */
+void v4l2core_reset_ioctl_stats();
+
+/*
+ * Close video device and free all allocated resources
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: void
+ */
+void v4l2core_close_dev(V4L2Context *context);
+
 }  // namespace uvc
\ No newline at end of file
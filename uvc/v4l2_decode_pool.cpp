@@ -0,0 +1,309 @@
+#include "v4l2_decode_pool.h"
+
+#include <base/log.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "v4l2_convert.h"
+#include "v4l2_core.h"
+#include "v4l2_define.h"
+
+namespace uvc {
+
+/*
+ * worker dequeue timeout (ms), bounds the time to notice a stop request
+ */
+#define DECODE_POOL_TIMEOUT 100
+
+V4L2DecodePool::V4L2DecodePool(V4L2Context *context, uint32_t workers, uint32_t slots)
+    : _context(context),
+      _format(context->yuv_format),
+      _slots(slots),
+      _next_order(0),
+      _next_delivery(0),
+      _running(false),
+      _dropped_frames(0) {
+    int width = context->format.fmt.pix.width;
+    int height = context->format.fmt.pix.height;
+    for (Slot &slot : _slots) {
+        slot.yuv_frame.resize(yuv420_frame_size(width, height));
+        slot.frame = V4L2DecodedFrame();
+        slot.frame.width = width;
+        slot.frame.height = height;
+        slot.frame.format = _format;
+        slot.frame.yuv_frame = slot.yuv_frame.data();
+        slot.order = 0;
+        slot.state = SLOT_FREE;
+    }
+    for (uint32_t i = 0; i < workers; i++) {
+        _workers.emplace_back(new Worker());
+    }
+}
+
+V4L2DecodePool::~V4L2DecodePool() { stop(); }
+
+void V4L2DecodePool::start() {
+    _running = true;
+    for (auto &worker : _workers) {
+        worker->thread = std::thread(&V4L2DecodePool::worker_loop, this, worker.get());
+    }
+}
+
+void V4L2DecodePool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+    }
+    _ready_cond.notify_all();
+
+    for (auto &worker : _workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+V4L2DecodePool::Slot *V4L2DecodePool::find_slot(SlotState state) {
+    for (Slot &slot : _slots) {
+        if (slot.state == state) {
+            return &slot;
+        }
+    }
+    return NULL;
+}
+
+V4L2DecodePool::Slot *V4L2DecodePool::next_ready_slot() {
+    for (Slot &slot : _slots) {
+        if (slot.state == SLOT_READY && slot.order == _next_delivery) {
+            return &slot;
+        }
+    }
+    return NULL;
+}
+
+V4L2DecodePool::Slot *V4L2DecodePool::take_frame() {
+    /*only the dequeue and the order assignment are serialized*/
+    std::unique_lock<std::mutex> dequeue_lock(_dequeue_mutex);
+    if (!_running) {
+        return NULL;
+    }
+
+    V4L2FrameBuff *frame = NULL;
+    int ret = v4l2core_get_frame(_context, DECODE_POOL_TIMEOUT, &frame);
+    if (ret == E_SELECT_TIMEOUT_ERR || ret == E_NO_DATA) {
+        return NULL;
+    } else if (ret == E_NO_STREAM_ERR) {
+        /*stream went down under us: nothing left to dequeue*/
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _running = false;
+        }
+        _ready_cond.notify_all();
+        return NULL;
+    } else if (ret != E_OK) {
+        base::LogError() << "V4L2_CORE: (decode pool) get frame failed: " << ret;
+        /*don't spin on a broken device*/
+        usleep(DECODE_POOL_TIMEOUT * 1000);
+        return NULL;
+    }
+
+    Slot *slot = NULL;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        slot = find_slot(SLOT_FREE);
+        if (slot != NULL) {
+            /*orders follow the dequeue order, the dequeue lock is held*/
+            slot->state = SLOT_DECODING;
+            slot->order = _next_order++;
+        }
+    }
+    dequeue_lock.unlock();
+
+    if (slot == NULL) {
+        /*consumer is not keeping up, give the buffer back to the driver*/
+        _dropped_frames++;
+        v4l2core_release_frame(_context, frame);
+        return NULL;
+    }
+
+    /*the slot is ours until SLOT_READY, fill it without the locks*/
+    slot->payload.assign(frame->raw_frame, frame->raw_frame + frame->raw_frame_size);
+    slot->frame.sequence = frame->sequence;
+    slot->frame.timestamp = frame->timestamp;
+    slot->frame.raw_frame_size = frame->raw_frame_size;
+    v4l2core_release_frame(_context, frame);
+    return slot;
+}
+
+void V4L2DecodePool::worker_loop(Worker *worker) {
+    while (_running.load(std::memory_order_acquire)) {
+        Slot *slot = take_frame();
+        if (slot == NULL) {
+            continue;
+        }
+
+        size_t scratch_size = V4L2JpegDecoder::get_scratch_size(slot->payload.size());
+        if (worker->scratch.size() < scratch_size) {
+            worker->scratch.resize(scratch_size);
+        }
+        int ret = worker->decoder.decode(slot->payload.data(), slot->payload.size(),
+                                         slot->frame.width, slot->frame.height,
+                                         slot->frame.yuv_frame, _format, worker->scratch.data(),
+                                         worker->scratch.size());
+        if (ret != E_OK) {
+            base::LogWarn() << "V4L2_CORE: (decode pool) mjpeg frame " << slot->frame.sequence
+                            << " decode error " << ret;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            slot->frame.status = ret;
+            slot->state = SLOT_READY;
+        }
+        _ready_cond.notify_all();
+    }
+}
+
+int V4L2DecodePool::get_frame(int timeout_ms, V4L2DecodedFrame **frame) {
+    *frame = NULL;
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    /*frames decoded before a stop are still handed out*/
+    auto ready = [this] { return next_ready_slot() != NULL || !_running; };
+    if (timeout_ms < 0) {
+        _ready_cond.wait(lock, ready);
+    } else if (timeout_ms > 0) {
+        _ready_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready);
+    }
+
+    Slot *slot = next_ready_slot();
+    if (slot == NULL) {
+        return _running ? E_NO_DATA : E_NO_STREAM_ERR;
+    }
+    slot->state = SLOT_TAKEN;
+    _next_delivery++;
+    *frame = &slot->frame;
+    return E_OK;
+}
+
+int V4L2DecodePool::release_frame(V4L2DecodedFrame *frame) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (Slot &slot : _slots) {
+        if (&slot.frame == frame && slot.state == SLOT_TAKEN) {
+            slot.state = SLOT_FREE;
+            return E_OK;
+        }
+    }
+    base::LogError() << "V4L2_CORE: (decode pool) releasing a frame that was not taken";
+    return E_UNKNOWN_ERR;
+}
+
+/*
+ * Start the MJPEG decode pool of a context
+ * args:
+ *   context - pointer to V4L2Context (MJPEG or JPEG stream must be on)
+ *   workers - number of decode threads
+ *   slots - number of decoded frame slots (more than workers)
+ *
+ * returns: error code (E_OK, E_NO_STREAM_ERR, E_NO_CODEC, E_BUSY_ERR or E_ALLOC_ERR)
+ */
+int v4l2core_start_decode_pool(V4L2Context *context, uint32_t workers, uint32_t slots) {
+    if (context->decode_pool != NULL) {
+        base::LogWarn() << "V4L2_CORE: decode pool already running";
+        return E_OK;
+    }
+    if (context->streaming != STRM_OK) {
+        base::LogError() << "V4L2_CORE: (decode pool) video stream is not on";
+        return E_NO_STREAM_ERR;
+    }
+    if (context->capture_thread.joinable()) {
+        base::LogError() << "V4L2_CORE: (decode pool) the capture thread owns the stream";
+        return E_BUSY_ERR;
+    }
+    if (context->reactor_watched) {
+        base::LogError() << "V4L2_CORE: (decode pool) a reactor owns the stream";
+        return E_BUSY_ERR;
+    }
+    uint32_t pixelformat = context->format.fmt.pix.pixelformat;
+    if (pixelformat != V4L2_PIX_FMT_MJPEG && pixelformat != V4L2_PIX_FMT_JPEG) {
+        base::LogError() << "V4L2_CORE: (decode pool) stream is not MJPEG";
+        return E_NO_CODEC;
+    }
+    /*a worker always needs a free slot while the consumer holds one*/
+    if (workers == 0 || slots <= workers) {
+        base::LogError() << "V4L2_CORE: (decode pool) invalid size: " << workers << " workers, "
+                         << slots << " slots";
+        return E_ALLOC_ERR;
+    }
+
+    context->decode_pool = new V4L2DecodePool(context, workers, slots);
+    context->decode_pool->start();
+    return E_OK;
+}
+
+/*
+ * Stop the MJPEG decode pool of a context
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2core_stop_decode_pool(V4L2Context *context) {
+    if (context->decode_pool == NULL) {
+        return E_OK;
+    }
+
+    /*the workers requeue every buffer they dequeue, nothing to give back*/
+    context->decode_pool->stop();
+    delete context->decode_pool;
+    context->decode_pool = NULL;
+    return E_OK;
+}
+
+/*
+ * Get the next decoded frame, in capture order (consumer side)
+ * args:
+ *   context - pointer to V4L2Context
+ *   timeout_ms - time to wait for the next frame (0 - don't wait, -1 - forever)
+ *   frame - pointer to the returned frame (NULL on error)
+ *
+ * returns: error code (E_OK, E_NO_DATA or E_NO_STREAM_ERR)
+ */
+int v4l2core_get_decoded_frame(V4L2Context *context, int timeout_ms, V4L2DecodedFrame **frame) {
+    *frame = NULL;
+    if (context->decode_pool == NULL) {
+        base::LogError() << "V4L2_CORE: (get decoded frame) decode pool is not running";
+        return E_NO_STREAM_ERR;
+    }
+    return context->decode_pool->get_frame(timeout_ms, frame);
+}
+
+/*
+ * Hand a decoded frame back to the pool
+ * args:
+ *   context - pointer to V4L2Context
+ *   frame - frame from v4l2core_get_decoded_frame
+ *
+ * returns: error code (E_OK, E_NO_STREAM_ERR or E_UNKNOWN_ERR)
+ */
+int v4l2core_release_decoded_frame(V4L2Context *context, V4L2DecodedFrame *frame) {
+    if (context->decode_pool == NULL) {
+        base::LogError() << "V4L2_CORE: (release decoded frame) decode pool is not running";
+        return E_NO_STREAM_ERR;
+    }
+    return context->decode_pool->release_frame(frame);
+}
+
+/*
+ * Get the number of frames dropped because every decode slot was busy
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: dropped frames (0 if the pool is not running)
+ */
+uint64_t v4l2core_get_decode_dropped_frames(V4L2Context *context) {
+    return context->decode_pool ? context->decode_pool->get_dropped_frames() : 0;
+}
+
+}  // namespace uvc
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "v4l2_context.h"
+#include "v4l2_jpeg.h"
+
+namespace uvc {
+
+/*
+ * pool of MJPEG decode workers fed by a streaming context
+ *
+ * an idle worker dequeues the next frame, copies the compressed payload and
+ * requeues the driver buffer at once, then decodes the copy with its own
+ * V4L2JpegDecoder; the consumer gets the frames in dequeue order, a frame
+ * decoded ahead of time waits in its slot for the ones before it
+ *
+ * a slot holds a frame from its dequeue until the consumer releases it, so
+ * the slot count bounds the reorder buffering; a frame dequeued while every
+ * slot is busy is requeued and counted in get_dropped_frames
+ */
+class V4L2DecodePool final {
+public:
+    V4L2DecodePool(V4L2Context *context, uint32_t workers, uint32_t slots);
+    ~V4L2DecodePool();
+
+    V4L2DecodePool(const V4L2DecodePool &) = delete;
+    void operator=(const V4L2DecodePool &) = delete;
+    /*
+    * start the workers
+    */
+    void start();
+    /*
+    * stop and join the workers (frames in flight are decoded first)
+    */
+    void stop();
+    /*
+    * next frame in dequeue order (timeout_ms: 0 - don't wait, -1 - forever)
+    * returns: error code (E_OK, E_NO_DATA or E_NO_STREAM_ERR once stopped)
+    */
+    int get_frame(int timeout_ms, V4L2DecodedFrame **frame);
+    /*
+    * hand a frame from get_frame back to the pool
+    * returns: error code (E_OK or E_UNKNOWN_ERR if not taken)
+    */
+    int release_frame(V4L2DecodedFrame *frame);
+
+    uint64_t get_dropped_frames() const { return _dropped_frames.load(); }
+private:
+    enum SlotState { SLOT_FREE, SLOT_DECODING, SLOT_READY, SLOT_TAKEN };
+
+    struct Slot {
+        V4L2DecodedFrame frame;
+        std::vector<uint8_t> yuv_frame;  //decoded frame storage
+        std::vector<uint8_t> payload;    //copy of the compressed frame
+        uint64_t order;                  //dequeue order
+        SlotState state;
+    };
+
+    struct Worker {
+        std::thread thread;
+        V4L2JpegDecoder decoder;
+        std::vector<uint8_t> scratch;  //decoder scratch (grows with the payload)
+    };
+
+    void worker_loop(Worker *worker);
+    /*
+    * dequeue a frame and copy it into a free slot (one worker at a time)
+    * returns: slot in SLOT_DECODING or NULL (no frame, or dropped)
+    */
+    Slot *take_frame();
+    Slot *find_slot(SlotState state);
+    Slot *next_ready_slot();
+private:
+    V4L2Context *_context;
+    uint32_t _format;  //output format (context yuv_format at creation)
+    std::vector<Slot> _slots;
+    std::vector<std::unique_ptr<Worker>> _workers;
+
+    std::mutex _dequeue_mutex;  //serializes the workers on the device
+    std::mutex _mutex;          //protects the slot states and orders
+    std::condition_variable _ready_cond;
+    uint64_t _next_order;     //order of the next dequeued frame
+    uint64_t _next_delivery;  //order of the next frame for the consumer
+    std::atomic<bool> _running;
+    std::atomic<uint64_t> _dropped_frames;
+};
+
+}  // namespace uvc
\ No newline at end of file
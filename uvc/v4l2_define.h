@@ -37,6 +37,7 @@ namespace uvc {
 #define E_WRONG_MARKER_ERR (-29)
 #define E_NO_EOI_ERR (-30)
 #define E_FILE_IO_ERR (-31)
+#define E_BUSY_ERR (-32)
 #define E_UNKNOWN_ERR (-40)
 
 #ifndef TRUE
@@ -6,6 +6,10 @@
 #include <linux/videodev2.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 #include "v4l2_util.h"
 
 namespace uvc {
@@ -41,13 +45,362 @@ V4L2DeviceSysData V4l2Device::get_device_sys_data(int index) {
 void V4l2Device::free_device_list() {
     _dev_sys_datas.clear();
 
+    if (_udev_monitor != NULL) {
+        udev_monitor_unref(_udev_monitor);
+        _udev_monitor = NULL;
+        _udev_fd = -1;
+    }
+
     if (_udev != NULL) {
         udev_unref(_udev);
+        _udev = NULL;
+    }
+}
+
+int V4l2Device::get_device_index(uint64_t id) const {
+    for (size_t i = 0; i < _dev_sys_datas.size(); i++) {
+        if (_dev_sys_datas[i].id == id) {
+            return i;
+        }
     }
+    return -1;
+}
+
+int V4l2Device::find_device(const std::string &syspath) const {
+    for (size_t i = 0; i < _dev_sys_datas.size(); i++) {
+        if (_dev_sys_datas[i].syspath == syspath) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int V4l2Device::check_device_list_events() {
+    if (_udev_monitor == NULL) {
+        return 0;
+    }
+
+    /*
+     * drain every pending event (the monitor socket is non blocking) and
+     * apply each one to the list, devices not involved are left untouched
+     */
+    int changed = 0;
+    struct udev_device *dev = NULL;
+    while ((dev = udev_monitor_receive_device(_udev_monitor)) != NULL) {
+        if (apply_device_event(dev)) {
+            changed = 1;
+        }
+        udev_device_unref(dev);
+    }
+
+    return changed;
+}
+
+/*
+ * device capture support
+ */
+#define DEVICE_NO_CAPTURE 0  //not a video capture node
+#define DEVICE_CAPTURE 1     //video capture node
+#define DEVICE_UNKNOWN 2     //udev has no v4l data, the node must be opened
+
+/*
+ * maximum number of devices opened in parallel (DEVICE_UNKNOWN devices)
+ */
+#define ENUM_MAX_WORKERS 8
+
+/*
+ * get a udev property or sysfs attribute as a string
+ */
+static std::string udev_value(const char *value) {
+    return value != NULL ? value : "";
+}
+
+/*
+ * fill the device data from the udev database (v4l_id properties)
+ * args:
+ *   dev - udev video4linux device
+ *   sys_data - pointer to the device sys data to fill
+ *
+ * notes:
+ *   v4l_id already ran VIDIOC_QUERYCAP when the device was added, so the
+ *   device doesn't have to be opened (and woken up from autosuspend) again
+ *
+ * returns: DEVICE_CAPTURE, DEVICE_NO_CAPTURE or DEVICE_UNKNOWN
+ */
+static int read_udev_caps(struct udev_device *dev, V4L2DeviceSysData *sys_data) {
+    const char *capabilities = udev_device_get_property_value(dev, "ID_V4L_CAPABILITIES");
+    if (capabilities == NULL) {
+        return DEVICE_UNKNOWN;
+    }
+    if (strstr(capabilities, ":capture:") == NULL) {
+        return DEVICE_NO_CAPTURE;
+    }
+
+    sys_data->name = udev_value(udev_device_get_property_value(dev, "ID_V4L_PRODUCT"));
+    if (sys_data->name.empty()) {
+        sys_data->name = udev_value(udev_device_get_sysattr_value(dev, "name"));
+    }
+    /*the driver bound to the parent (interface) device, e.g. uvcvideo*/
+    struct udev_device *parent = udev_device_get_parent(dev);
+    sys_data->driver = parent ? udev_value(udev_device_get_driver(parent)) : "";
+
+    if (sys_data->name.empty() || sys_data->driver.empty()) {
+        return DEVICE_UNKNOWN;
+    }
+    return DEVICE_CAPTURE;
+}
+
+/*
+ * fill the device data from VIDIOC_QUERYCAP
+ * args:
+ *   sys_data - pointer to the device sys data to fill (device must be set)
+ *
+ * returns: DEVICE_CAPTURE, DEVICE_NO_CAPTURE or DEVICE_UNKNOWN on error
+ */
+static int query_device_caps(V4L2DeviceSysData *sys_data) {
+    const char *v4l2_device = sys_data->device.c_str();
+
+    int fd = 0;
+    /* open the device and query the capabilities */
+    if ((fd = v4l2_open(v4l2_device, O_RDWR | O_NONBLOCK, 0)) < 0) {
+        base::LogError() << "Error opening V4L2 interface for " << v4l2_device;
+        return DEVICE_UNKNOWN;
+    }
+
+    struct v4l2_capability v4l2_cap;
+    if (xioctl(fd, VIDIOC_QUERYCAP, &v4l2_cap) < 0) {
+        base::LogError() << "VIDIOC_QUERYCAP error: " << strerror(errno);
+        base::LogError() << "Couldn't query device " << v4l2_device;
+        v4l2_close(fd);
+        return DEVICE_UNKNOWN;
+    }
+    v4l2_close(fd);
+
+    uint32_t caps;
+    if (v4l2_cap.capabilities & V4L2_CAP_DEVICE_CAPS) {
+        caps = v4l2_cap.device_caps;
+    } else {
+        caps = v4l2_cap.capabilities;
+    }
+
+    if (!(caps & V4L2_CAP_VIDEO_CAPTURE)) {
+        return DEVICE_NO_CAPTURE;
+    }
+
+    sys_data->name = reinterpret_cast<char *>(v4l2_cap.card);
+    sys_data->driver = reinterpret_cast<char *>(v4l2_cap.driver);
+    sys_data->location = reinterpret_cast<char *>(v4l2_cap.bus_info);
+    return DEVICE_CAPTURE;
+}
+
+/*
+ * build the bus info of a usb device as uvcvideo reports it in VIDIOC_QUERYCAP
+ * args:
+ *   usb_dev - udev usb device
+ *
+ * returns: "usb-<host controller>-<devpath>" (e.g. usb-0000:00:14.0-1), empty if unknown
+ */
+static std::string usb_bus_info(struct udev_device *usb_dev) {
+    std::string devpath = udev_value(udev_device_get_sysattr_value(usb_dev, "devpath"));
+    /*the host controller is the first parent above the usb tree (root hub)*/
+    struct udev_device *controller = usb_dev;
+    while (controller != NULL && udev_value(udev_device_get_subsystem(controller)) == "usb") {
+        controller = udev_device_get_parent(controller);
+    }
+    if (devpath.empty() || controller == NULL) {
+        return "";
+    }
+    return "usb-" + udev_value(udev_device_get_sysname(controller)) + "-" + devpath;
+}
+
+/*
+ * fill the usb data (ids, serial, bus) of a device
+ * args:
+ *   dev - udev video4linux device
+ *   sys_data - pointer to the device sys data to fill
+ *
+ * returns: true if the device has a usb parent
+ */
+static bool read_usb_data(struct udev_device *dev, V4L2DeviceSysData *sys_data) {
+    /* The device pointed to by dev contains information about
+        the v4l2 device. In order to get information about the
+        USB device, get the parent device with the
+        subsystem/devtype pair of "usb"/"usb_device". This will
+        be several levels up the tree, but the function will find
+        it. The parent is owned by dev, it must not be unref'd.*/
+    struct udev_device *usb_dev =
+        udev_device_get_parent_with_subsystem_devtype(dev, "usb", "usb_device");
+    if (usb_dev == NULL) {
+        base::LogError() << "Unable to find parent usb device.";
+        return false;
+    }
+
+    /* From here, we can call get_sysattr_value() for each file
+        in the device's /sys entry. The strings passed into these
+        functions (idProduct, idVendor, serial, etc.) correspond
+        directly to the files in the directory which represents
+        the USB device. Note that USB strings are Unicode, UCS2
+        encoded, but the strings returned from
+        udev_device_get_sysattr_value() are UTF-8 encoded. */
+    std::string vendor = udev_value(udev_device_get_sysattr_value(usb_dev, "idVendor"));
+    std::string product = udev_value(udev_device_get_sysattr_value(usb_dev, "idProduct"));
+    std::string bcd_device = udev_value(udev_device_get_sysattr_value(usb_dev, "bcdDevice"));
+    std::string busnum = udev_value(udev_device_get_sysattr_value(usb_dev, "busnum"));
+    std::string devnum = udev_value(udev_device_get_sysattr_value(usb_dev, "devnum"));
+    sys_data->serial = udev_value(udev_device_get_sysattr_value(usb_dev, "serial"));
+    /*same text as QUERYCAP bus_info, so opened devices get the same location*/
+    sys_data->location = usb_bus_info(usb_dev);
+
+    base::LogDebug() << "\tVID: " << vendor;
+    base::LogDebug() << "\tPID: " << product;
+    base::LogDebug() << "\tmanufacturer: "
+                     << udev_value(udev_device_get_sysattr_value(usb_dev, "manufacturer"));
+    base::LogDebug() << "\tproduct:"
+                     << udev_value(udev_device_get_sysattr_value(usb_dev, "product"));
+    base::LogDebug() << "\tserial: " << sys_data->serial;
+    base::LogDebug() << "\tbusnum: " << busnum;
+    base::LogDebug() << "\tdevnum: " << devnum;
+
+    sys_data->vendor = strtoul(vendor.c_str(), NULL, 16);
+    sys_data->product = strtoul(product.c_str(), NULL, 16);
+    sys_data->bcd_device = strtoul(bcd_device.c_str(), NULL, 16);
+    sys_data->busnum = strtoull(busnum.c_str(), NULL, 10);
+    sys_data->devnum = strtoull(devnum.c_str(), NULL, 10);
+    return true;
+}
+
+/*
+ * build the device data of a udev video4linux device (without opening it)
+ * args:
+ *   dev - udev video4linux device
+ *   sys_data - pointer to the device sys data to fill
+ *
+ * returns: DEVICE_CAPTURE, DEVICE_NO_CAPTURE or DEVICE_UNKNOWN (query_device_caps needed)
+ */
+static int build_device(struct udev_device *dev, V4L2DeviceSysData *sys_data) {
+    /* usb_device_get_devnode() returns the path to the device node
+        itself in /dev. */
+    const char *v4l2_device = udev_device_get_devnode(dev);
+    if (v4l2_device == NULL) {
+        return DEVICE_NO_CAPTURE;
+    }
+    base::LogDebug() << " Found device node path: " << v4l2_device;
+
+    sys_data->device = v4l2_device;
+    sys_data->valid = 1;
+    sys_data->current = 0;
+
+    if (!read_usb_data(dev, sys_data)) {
+        return DEVICE_NO_CAPTURE;
+    }
+    return read_udev_caps(dev, sys_data);
+}
+
+/*
+ * query the capabilities of the devices udev knows nothing about
+ * args:
+ *   devices - devices to query (query_device_caps)
+ *   status - returned status of each device
+ *
+ * notes:
+ *   opens are slow (usb autosuspend wake up), they run in parallel on a
+ *   bounded number of threads
+ *
+ * returns: void
+ */
+static void query_devices_caps(std::vector<V4L2DeviceSysData> &devices,
+                               std::vector<int> &status) {
+    status.assign(devices.size(), DEVICE_UNKNOWN);
+    if (devices.empty()) {
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next.fetch_add(1)) < devices.size()) {
+            status[i] = query_device_caps(&devices[i]);
+        }
+    };
+
+    size_t worker_count = std::min(devices.size(), (size_t)ENUM_MAX_WORKERS);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < worker_count; i++) {
+        workers.emplace_back(worker);
+    }
+    /*this thread is a worker too*/
+    worker();
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+int V4l2Device::apply_device_event(struct udev_device *dev) {
+    const char *action = udev_device_get_action(dev);
+    const char *syspath = udev_device_get_syspath(dev);
+    if (syspath == NULL) {
+        return 0;
+    }
+    std::string event_action = (action != NULL) ? action : "change";
+    base::LogDebug() << "udev event: " << event_action << " " << syspath;
+
+    int index = find_device(syspath);
+    if (event_action == "remove") {
+        if (index < 0) {
+            return 0;
+        }
+        V4L2DeviceSysData removed = _dev_sys_datas[index];
+        _dev_sys_datas.erase(_dev_sys_datas.begin() + index);
+        if (_event_callback) {
+            _event_callback(DEVICE_REMOVED, removed);
+        }
+        return 1;
+    }
+
+    /* add, change, bind...: (re)build the device from the event data */
+    V4L2DeviceSysData new_device;
+    int status = build_device(dev, &new_device);
+    if (status == DEVICE_UNKNOWN) {
+        status = query_device_caps(&new_device);
+    }
+
+    if (status != DEVICE_CAPTURE) {
+        if (index < 0) {
+            return 0;
+        }
+        /*the node no longer captures (e.g. driver unbound)*/
+        V4L2DeviceSysData removed = _dev_sys_datas[index];
+        _dev_sys_datas.erase(_dev_sys_datas.begin() + index);
+        if (_event_callback) {
+            _event_callback(DEVICE_REMOVED, removed);
+        }
+        return 1;
+    }
+
+    new_device.syspath = syspath;
+    if (index >= 0) {
+        /*known device: keep its id and selection*/
+        new_device.id = _dev_sys_datas[index].id;
+        new_device.current = _dev_sys_datas[index].current;
+        _dev_sys_datas[index] = new_device;
+        if (_event_callback) {
+            _event_callback(DEVICE_CHANGED, new_device);
+        }
+        return 1;
+    }
+
+    new_device.id = _next_device_id++;
+    _dev_sys_datas.emplace_back(new_device);
+    if (_event_callback) {
+        _event_callback(DEVICE_ADDED, new_device);
+    }
+    return 1;
 }
 
 int V4l2Device::enum_devices() {
-    _dev_sys_datas.clear();
+    /*devices already listed keep their id*/
+    std::vector<V4L2DeviceSysData> old_devices;
+    old_devices.swap(_dev_sys_datas);
     /* Create a list of the devices in the 'v4l2' subsystem. */
     struct udev_enumerate *enumerate = udev_enumerate_new(_udev);
     udev_enumerate_add_match_subsystem(enumerate, "video4linux");
@@ -55,12 +408,15 @@ int V4l2Device::enum_devices() {
     struct udev_list_entry *devices = udev_enumerate_get_list_entry(enumerate);
 
     /*
-     * For each item enumerated, print out its information.
-     * udev_list_entry_foreach is a macro which expands to
-     * a loop. The loop will be executed for each member in
-     * devices, setting dev_list_entry to a list entry
-     * which contains the device's path in /sys.
+     * devices are built from the udev database when possible, the ones
+     * without v4l data are opened afterwards; each gets its slot so the
+     * list keeps the udev order
      */
+    std::vector<V4L2DeviceSysData> found_devices;
+    std::vector<int> found_status;
+    std::vector<V4L2DeviceSysData> open_devices;
+    std::vector<size_t> open_slots;
+
     struct udev_list_entry *dev_list_entry;
     udev_list_entry_foreach(dev_list_entry, devices) {
         /*
@@ -69,91 +425,59 @@ int V4l2Device::enum_devices() {
          */
         const char *path = udev_list_entry_get_name(dev_list_entry);
         struct udev_device *dev = udev_device_new_from_syspath(_udev, path);
-
-        /* usb_device_get_devnode() returns the path to the device node
-            itself in /dev. */
-        const char *v4l2_device = udev_device_get_devnode(dev);
-        base::LogDebug() << " Found device node path: " << v4l2_device;
-
-        int fd = 0;
-        /* open the device and query the capabilities */
-        if ((fd = v4l2_open(v4l2_device, O_RDWR | O_NONBLOCK, 0)) < 0) {
-            base::LogError() << "Error opening V4L2 interface for " << v4l2_device;
-            v4l2_close(fd);
-            continue; /*next dir entry*/
-        }
-
-        struct v4l2_capability v4l2_cap;
-        if (xioctl(fd, VIDIOC_QUERYCAP, &v4l2_cap) < 0) {
-            base::LogError() << "VIDIOC_QUERYCAP error: " << strerror(errno);
-            base::LogError() << "Couldn't query device " << v4l2_device;
-            v4l2_close(fd);
-            continue; /*next dir entry*/
-        }
-        v4l2_close(fd);
-
-        uint32_t caps;
-        if (v4l2_cap.capabilities & V4L2_CAP_DEVICE_CAPS) {
-            caps = v4l2_cap.device_caps;
-        } else {
-            caps = v4l2_cap.capabilities;
-        }
-
-        if (!(caps & V4L2_CAP_VIDEO_CAPTURE)) {
-            base::LogWarn() << "Device " << v4l2_device << " not support video capture";
+        if (dev == NULL) {
             continue;
         }
 
         V4L2DeviceSysData new_device;
+        int status = build_device(dev, &new_device);
+        new_device.syspath = path;
+        udev_device_unref(dev);
 
-        new_device.device = v4l2_device;
-        new_device.name = reinterpret_cast<char *>(v4l2_cap.card);
-        new_device.driver = reinterpret_cast<char *>(v4l2_cap.driver);
-        new_device.location = reinterpret_cast<char *>(v4l2_cap.bus_info);
-        new_device.valid = 1;
-        new_device.current = 0;
-
-        /* The device pointed to by dev contains information about
-            the v4l2 device. In order to get information about the
-            USB device, get the parent device with the
-            subsystem/devtype pair of "usb"/"usb_device". This will
-            be several levels up the tree, but the function will find
-            it.*/
-        dev = udev_device_get_parent_with_subsystem_devtype(dev, "usb", "usb_device");
-        if (dev == NULL) {
-            base::LogError() << "Unable to find parent usb device.";
+        if (status == DEVICE_NO_CAPTURE) {
             continue;
         }
-
-        /* From here, we can call get_sysattr_value() for each file
-            in the device's /sys entry. The strings passed into these
-            functions (idProduct, idVendor, serial, etc.) correspond
-            directly to the files in the directory which represents
-            the USB device. Note that USB strings are Unicode, UCS2
-            encoded, but the strings returned from
-            udev_device_get_sysattr_value() are UTF-8 encoded. */
-        base::LogDebug() << "\tVID: " << udev_device_get_sysattr_value(dev, "idVendor");
-        base::LogDebug() << "\tPID: " << udev_device_get_sysattr_value(dev, "idProduct");
-        base::LogDebug() << "\tmanufacturer: "
-                         << udev_device_get_sysattr_value(dev, "manufacturer");
-        base::LogDebug() << "\tproduct:" << udev_device_get_sysattr_value(dev, "product");
-        base::LogDebug() << "\tserial: " << udev_device_get_sysattr_value(dev, "serial");
-        base::LogDebug() << "\tbusnum: " << udev_device_get_sysattr_value(dev, "busnum");
-        base::LogDebug() << "\tdevnum: ", udev_device_get_sysattr_value(dev, "devnum");
-
-        new_device.vendor = strtoull(udev_device_get_sysattr_value(dev, "idVendor"), NULL, 16);
-        new_device.product = strtoull(udev_device_get_sysattr_value(dev, "idProduct"), NULL, 16);
-        new_device.busnum = strtoull(udev_device_get_sysattr_value(dev, "busnum"), NULL, 10);
-        new_device.devnum = strtoull(udev_device_get_sysattr_value(dev, "devnum"), NULL, 10);
-
-        _dev_sys_datas.emplace_back(new_device);
-
-        udev_device_unref(dev);
+        if (status == DEVICE_UNKNOWN) {
+            open_slots.push_back(found_devices.size());
+            open_devices.push_back(new_device);
+        }
+        found_devices.push_back(new_device);
+        found_status.push_back(status);
     }
 
     /* Free the enumerator object */
     udev_enumerate_unref(enumerate);
 
+    std::vector<int> open_status;
+    query_devices_caps(open_devices, open_status);
+    for (size_t i = 0; i < open_slots.size(); i++) {
+        found_devices[open_slots[i]] = open_devices[i];
+        found_status[open_slots[i]] = open_status[i];
+    }
+
+    for (size_t i = 0; i < found_devices.size(); i++) {
+        if (found_status[i] != DEVICE_CAPTURE) {
+            if (found_status[i] == DEVICE_NO_CAPTURE) {
+                base::LogWarn() << "Device " << found_devices[i].device
+                                << " not support video capture";
+            }
+            continue;
+        }
+        found_devices[i].id = 0;
+        for (size_t j = 0; j < old_devices.size(); j++) {
+            if (old_devices[j].syspath == found_devices[i].syspath) {
+                found_devices[i].id = old_devices[j].id;
+                break;
+            }
+        }
+        if (found_devices[i].id == 0) {
+            found_devices[i].id = _next_device_id++;
+        }
+        _dev_sys_datas.emplace_back(found_devices[i]);
+    }
+
+    base::LogDebug() << "found " << _dev_sys_datas.size() << " capture devices ("
+                     << open_devices.size() << " opened)";
     return _dev_sys_datas.size();
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <string>
 #include <vector>
 extern "C" {
@@ -12,18 +13,35 @@ namespace uvc {
  * v4l2 device system data
  */
 struct V4L2DeviceSysData {
+    uint64_t id = 0;      //stable device id (kept while the device stays plugged)
+    std::string syspath;  //udev sys path
     std::string device;
     std::string name;
     std::string driver;
-    std::string location;
+    std::string location;  //bus info as in VIDIOC_QUERYCAP (e.g. usb-0000:00:14.0-1)
     uint32_t vendor;
     uint32_t product;
+    uint32_t bcd_device;  //usb device release number (bcdDevice, firmware revision)
+    std::string serial;   //usb serial number (empty if the device has none)
     int32_t valid;
     int32_t current;
     uint64_t busnum;
     uint64_t devnum;
 };
 
+/*
+ * device list events
+ */
+#define DEVICE_ADDED 0    //device plugged
+#define DEVICE_REMOVED 1  //device unplugged
+#define DEVICE_CHANGED 2  //device data changed (udev change/bind event)
+
+/*
+ * device event callback: called for every change applied to the device list
+ */
+using V4L2DeviceEventCallback =
+    std::function<void(int event, const V4L2DeviceSysData &device_sys_data)>;
+
 class V4l2Device final {
 public:
     /*
@@ -36,20 +54,52 @@ public:
     */
     V4L2DeviceSysData get_device_sys_data(int index);
     /*
+    * get the index of a device from its stable id
+    * return: device index or -1 if the device is gone
+    */
+    int get_device_index(uint64_t id) const;
+    /*
     * free v4l2 devices list
     */
     void free_device_list();
+    /*
+    * udev monitor file descriptor (readable when devices are added or removed)
+    */
+    int get_udev_fd() const { return _udev_fd; };
+    /*
+    * set the callback called for every device added, removed or changed
+    */
+    void set_device_event_callback(const V4L2DeviceEventCallback &callback) {
+        _event_callback = callback;
+    };
+    /*
+    * drain the udev events and apply them to the device list (no rescan)
+    * return: 1 if the device list changed, 0 otherwise
+    */
+    int check_device_list_events();
 private:
     /*
     * enumerate available v4l2 devices and creates list 
     * return: number of valid devices
     */
     int enum_devices();
+    /*
+    * apply one udev event to the device list
+    * return: 1 if the device list changed, 0 otherwise
+    */
+    int apply_device_event(struct udev_device *dev);
+    /*
+    * find a device by udev sys path
+    * return: device index or -1
+    */
+    int find_device(const std::string &syspath) const;
 private:
-    struct udev *_udev;                  // pointer to a udev struct (libudev)
-    struct udev_monitor *_udev_monitor;  // udev monitor
-    int _udev_fd;                        // udev monitor file descriptor
+    struct udev *_udev = NULL;                  // pointer to a udev struct (libudev)
+    struct udev_monitor *_udev_monitor = NULL;  // udev monitor
+    int _udev_fd = -1;                          // udev monitor file descriptor
     std::vector<V4L2DeviceSysData> _dev_sys_datas;
+    uint64_t _next_device_id = 1;              // id of the next device added to the list
+    V4L2DeviceEventCallback _event_callback;  // device event callback
 };
 
 }  // namespace uvc
\ No newline at end of file
@@ -0,0 +1,771 @@
+#include "v4l2_fake_backend.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace uvc {
+
+/*
+ * maximum number of fake driver buffers (VIDEO_MAX_FRAME)
+ */
+#define FAKE_MAX_BUFFERS 32
+
+/*
+ * frames the generator may run late before it restarts its schedule
+ */
+#define FAKE_MAX_LATE_FRAMES 8
+
+/*
+ * controls of the fake device
+ */
+#define FAKE_MENU_CONTROL V4L2_CID_POWER_LINE_FREQUENCY
+
+/*
+ * set errno and return the system call error value
+ */
+static int fake_error(int error) {
+    errno = error;
+    return -1;
+}
+
+static bool is_compressed(uint32_t pixelformat) {
+    return pixelformat == V4L2_PIX_FMT_MJPEG || pixelformat == V4L2_PIX_FMT_JPEG ||
+           pixelformat == V4L2_PIX_FMT_H264;
+}
+
+/*
+ * line and frame size of a fake format
+ * args:
+ *   format - pix format (pixelformat, width and height set)
+ *
+ * returns: void (bytesperline and sizeimage are filled)
+ */
+static void set_frame_size(struct v4l2_pix_format *format) {
+    uint32_t pixels = format->width * format->height;
+    switch (format->pixelformat) {
+        case V4L2_PIX_FMT_GREY:
+            format->bytesperline = format->width;
+            format->sizeimage = pixels;
+            break;
+        case V4L2_PIX_FMT_NV12:
+        case V4L2_PIX_FMT_NV21:
+        case V4L2_PIX_FMT_YUV420:
+        case V4L2_PIX_FMT_YVU420:
+            format->bytesperline = format->width;
+            format->sizeimage = pixels * 3 / 2;
+            break;
+        case V4L2_PIX_FMT_RGB24:
+        case V4L2_PIX_FMT_BGR24:
+            format->bytesperline = format->width * 3;
+            format->sizeimage = pixels * 3;
+            break;
+        default:
+            /*packed 4:2:2 and compressed formats (worst case payload)*/
+            format->bytesperline = is_compressed(format->pixelformat) ? 0 : format->width * 2;
+            format->sizeimage = pixels * 2;
+            break;
+    }
+}
+
+static int64_t interval_ns(const struct v4l2_fract &interval) {
+    if (interval.denominator == 0) {
+        return 0;
+    }
+    return (int64_t)interval.numerator * 1000000000LL / interval.denominator;
+}
+
+V4L2FakeBackend::V4L2FakeBackend(const V4L2FakeConfig &config) : _config(config) {
+    memset(&_format, 0, sizeof(struct v4l2_pix_format));
+    _format.pixelformat = _config.pixel_formats.empty() ? V4L2_PIX_FMT_YUYV
+                                                        : _config.pixel_formats[0];
+    if (!_config.sizes.empty()) {
+        _format.width = _config.sizes[0].width;
+        _format.height = _config.sizes[0].height;
+    }
+    _format.field = V4L2_FIELD_NONE;
+    _format.colorspace = V4L2_COLORSPACE_SRGB;
+    set_frame_size(&_format);
+
+    _interval.numerator = 1;
+    _interval.denominator = 30;
+    if (!_config.intervals.empty()) {
+        _interval.numerator = _config.intervals[0].numerator;
+        _interval.denominator = _config.intervals[0].denominator;
+    }
+
+    Control control;
+    memset(&control.query, 0, sizeof(struct v4l2_queryctrl));
+    control.query.id = V4L2_CID_BRIGHTNESS;
+    control.query.type = V4L2_CTRL_TYPE_INTEGER;
+    strncpy((char *)control.query.name, "Brightness", sizeof(control.query.name) - 1);
+    control.query.minimum = -64;
+    control.query.maximum = 64;
+    control.query.step = 1;
+    control.query.default_value = 0;
+    control.value = control.query.default_value;
+    _controls.push_back(control);
+
+    control.query.id = V4L2_CID_CONTRAST;
+    strncpy((char *)control.query.name, "Contrast", sizeof(control.query.name) - 1);
+    control.query.minimum = 0;
+    control.query.maximum = 100;
+    control.query.default_value = 50;
+    control.value = control.query.default_value;
+    _controls.push_back(control);
+
+    memset(control.query.name, 0, sizeof(control.query.name));
+    control.query.id = V4L2_CID_AUTO_WHITE_BALANCE;
+    control.query.type = V4L2_CTRL_TYPE_BOOLEAN;
+    strncpy((char *)control.query.name, "White Balance, Automatic",
+            sizeof(control.query.name) - 1);
+    control.query.minimum = 0;
+    control.query.maximum = 1;
+    control.query.default_value = 1;
+    control.value = control.query.default_value;
+    _controls.push_back(control);
+
+    memset(control.query.name, 0, sizeof(control.query.name));
+    control.query.id = FAKE_MENU_CONTROL;
+    control.query.type = V4L2_CTRL_TYPE_MENU;
+    strncpy((char *)control.query.name, "Power Line Frequency", sizeof(control.query.name) - 1);
+    control.query.minimum = 0;
+    control.query.maximum = 2;
+    control.query.default_value = 1;
+    control.value = control.query.default_value;
+    control.menu = {"Disabled", "50 Hz", "60 Hz"};
+    _controls.push_back(control);
+}
+
+V4L2FakeBackend::~V4L2FakeBackend() {
+    /*the generator thread signals frames on _fd, stop and join it first*/
+    stream_off();
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+int V4L2FakeBackend::open(const char * /*device*/, int /*flags*/) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_fd >= 0) {
+        return fake_error(EBUSY);
+    }
+
+    _fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_fd < 0) {
+        return -1;
+    }
+    return _fd;
+}
+
+int V4L2FakeBackend::close(int fd) {
+    if (fd < 0 || fd != _fd) {
+        return fake_error(EBADF);
+    }
+
+    stream_off();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    free_buffers();
+    ::close(_fd);
+    _fd = -1;
+    return 0;
+}
+
+int V4L2FakeBackend::ioctl(int fd, unsigned long request, void *arg) {
+    if (fd < 0 || fd != _fd) {
+        return fake_error(EBADF);
+    }
+
+    /*ioctl codes are 32 bits, callers passing them as int sign extend them*/
+    uint32_t request_code = request;
+
+    /*STREAMOFF joins the generator thread, it can't hold the lock*/
+    switch (request_code) {
+        case VIDIOC_STREAMON:
+            return stream_on();
+        case VIDIOC_STREAMOFF:
+            return stream_off();
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    switch (request_code) {
+        case VIDIOC_QUERYCAP:
+            return query_cap((struct v4l2_capability *)arg);
+        case VIDIOC_ENUM_FMT:
+            return enum_fmt((struct v4l2_fmtdesc *)arg);
+        case VIDIOC_ENUM_FRAMESIZES:
+            return enum_frame_sizes((struct v4l2_frmsizeenum *)arg);
+        case VIDIOC_ENUM_FRAMEINTERVALS:
+            return enum_frame_intervals((struct v4l2_frmivalenum *)arg);
+        case VIDIOC_G_FMT:
+            ((struct v4l2_format *)arg)->fmt.pix = _format;
+            return 0;
+        case VIDIOC_TRY_FMT:
+            return try_fmt((struct v4l2_format *)arg);
+        case VIDIOC_S_FMT:
+            return set_fmt((struct v4l2_format *)arg);
+        case VIDIOC_G_PARM:
+            return get_parm((struct v4l2_streamparm *)arg);
+        case VIDIOC_S_PARM:
+            return set_parm((struct v4l2_streamparm *)arg);
+        case VIDIOC_REQBUFS:
+            return request_buffers((struct v4l2_requestbuffers *)arg);
+        case VIDIOC_CREATE_BUFS:
+            return create_buffers((struct v4l2_create_buffers *)arg);
+        case VIDIOC_QUERYBUF:
+            return query_buffer((struct v4l2_buffer *)arg);
+        case VIDIOC_QBUF:
+            return queue_buffer((struct v4l2_buffer *)arg);
+        case VIDIOC_DQBUF:
+            return dequeue_buffer((struct v4l2_buffer *)arg);
+        case VIDIOC_QUERYCTRL:
+            return query_ctrl((struct v4l2_queryctrl *)arg);
+        case VIDIOC_QUERYMENU:
+            return query_menu((struct v4l2_querymenu *)arg);
+        case VIDIOC_G_CTRL:
+            return get_ctrl((struct v4l2_control *)arg);
+        case VIDIOC_S_CTRL:
+            return set_ctrl((struct v4l2_control *)arg);
+        default:
+            /*EXPBUF, events, extended controls...*/
+            return fake_error(ENOTTY);
+    }
+}
+
+void *V4L2FakeBackend::mmap(size_t length, int /*prot*/, int /*flags*/, int fd, int64_t offset) {
+    if (fd < 0 || fd != _fd) {
+        errno = EBADF;
+        return MAP_FAILED;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_memory != V4L2_MEMORY_MMAP) {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+    for (size_t i = 0; i < _buffers.size(); i++) {
+        if (_buffers[i].offset == offset && length <= _buffers[i].length) {
+            return _buffers[i].data.data();
+        }
+    }
+    errno = EINVAL;
+    return MAP_FAILED;
+}
+
+int V4L2FakeBackend::munmap(void * /*start*/, size_t /*length*/) {
+    /*the memory belongs to the buffers, it is freed with them (REQBUFS 0)*/
+    return 0;
+}
+
+ssize_t V4L2FakeBackend::read(int /*fd*/, void * /*buffer*/, size_t /*size*/) {
+    /*no read i/o (V4L2_CAP_READWRITE is not set)*/
+    return fake_error(EINVAL);
+}
+
+int V4L2FakeBackend::poll(struct pollfd *fds, nfds_t count, int timeout_ms) {
+    return ::poll(fds, count, timeout_ms);
+}
+
+uint64_t V4L2FakeBackend::get_dropped_frames() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _dropped_frames;
+}
+
+int V4L2FakeBackend::query_cap(struct v4l2_capability *cap) {
+    memset(cap, 0, sizeof(struct v4l2_capability));
+    strncpy((char *)cap->driver, "uvclib_fake", sizeof(cap->driver) - 1);
+    strncpy((char *)cap->card, _config.card.c_str(), sizeof(cap->card) - 1);
+    strncpy((char *)cap->bus_info, "fake:0", sizeof(cap->bus_info) - 1);
+    cap->version = 1;
+    cap->device_caps = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+    cap->capabilities = cap->device_caps | V4L2_CAP_DEVICE_CAPS;
+    return 0;
+}
+
+int V4L2FakeBackend::enum_fmt(struct v4l2_fmtdesc *fmtdesc) {
+    if (fmtdesc->type != V4L2_BUF_TYPE_VIDEO_CAPTURE ||
+        fmtdesc->index >= _config.pixel_formats.size()) {
+        return fake_error(EINVAL);
+    }
+
+    uint32_t pixelformat = _config.pixel_formats[fmtdesc->index];
+    fmtdesc->pixelformat = pixelformat;
+    fmtdesc->flags = is_compressed(pixelformat) ? V4L2_FMT_FLAG_COMPRESSED : 0;
+    snprintf((char *)fmtdesc->description, sizeof(fmtdesc->description), "Fake %c%c%c%c",
+             pixelformat & 0xFF, (pixelformat >> 8) & 0xFF, (pixelformat >> 16) & 0xFF,
+             (pixelformat >> 24) & 0xFF);
+    return 0;
+}
+
+int V4L2FakeBackend::enum_frame_sizes(struct v4l2_frmsizeenum *frmsize) {
+    if (std::find(_config.pixel_formats.begin(), _config.pixel_formats.end(),
+                  frmsize->pixel_format) == _config.pixel_formats.end() ||
+        frmsize->index >= _config.sizes.size()) {
+        return fake_error(EINVAL);
+    }
+
+    frmsize->type = V4L2_FRMSIZE_TYPE_DISCRETE;
+    frmsize->discrete.width = _config.sizes[frmsize->index].width;
+    frmsize->discrete.height = _config.sizes[frmsize->index].height;
+    return 0;
+}
+
+int V4L2FakeBackend::enum_frame_intervals(struct v4l2_frmivalenum *frmival) {
+    if (std::find(_config.pixel_formats.begin(), _config.pixel_formats.end(),
+                  frmival->pixel_format) == _config.pixel_formats.end() ||
+        frmival->index >= _config.intervals.size()) {
+        return fake_error(EINVAL);
+    }
+
+    bool size_found = false;
+    for (size_t i = 0; i < _config.sizes.size(); i++) {
+        if (_config.sizes[i].width == frmival->width &&
+            _config.sizes[i].height == frmival->height) {
+            size_found = true;
+        }
+    }
+    if (!size_found) {
+        return fake_error(EINVAL);
+    }
+
+    frmival->type = V4L2_FRMIVAL_TYPE_DISCRETE;
+    frmival->discrete.numerator = _config.intervals[frmival->index].numerator;
+    frmival->discrete.denominator = _config.intervals[frmival->index].denominator;
+    return 0;
+}
+
+int V4L2FakeBackend::try_fmt(struct v4l2_format *format) {
+    if (format->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || _config.sizes.empty() ||
+        _config.pixel_formats.empty()) {
+        return fake_error(EINVAL);
+    }
+
+    struct v4l2_pix_format &pix = format->fmt.pix;
+    /*like the drivers: unknown formats fall back to the first one, sizes to the closest*/
+    if (std::find(_config.pixel_formats.begin(), _config.pixel_formats.end(), pix.pixelformat) ==
+        _config.pixel_formats.end()) {
+        pix.pixelformat = _config.pixel_formats[0];
+    }
+
+    size_t best = 0;
+    int64_t best_distance = -1;
+    for (size_t i = 0; i < _config.sizes.size(); i++) {
+        int64_t dw = (int64_t)_config.sizes[i].width - pix.width;
+        int64_t dh = (int64_t)_config.sizes[i].height - pix.height;
+        int64_t distance = dw * dw + dh * dh;
+        if (best_distance < 0 || distance < best_distance) {
+            best = i;
+            best_distance = distance;
+        }
+    }
+    pix.width = _config.sizes[best].width;
+    pix.height = _config.sizes[best].height;
+    pix.field = V4L2_FIELD_NONE;
+    pix.colorspace = V4L2_COLORSPACE_SRGB;
+    set_frame_size(&pix);
+    return 0;
+}
+
+int V4L2FakeBackend::set_fmt(struct v4l2_format *format) {
+    /*vb2 refuses format changes while buffers are allocated*/
+    if (!_buffers.empty()) {
+        return fake_error(EBUSY);
+    }
+    if (try_fmt(format) < 0) {
+        return -1;
+    }
+    _format = format->fmt.pix;
+    return 0;
+}
+
+int V4L2FakeBackend::get_parm(struct v4l2_streamparm *streamparm) {
+    if (streamparm->type != V4L2_BUF_TYPE_VIDEO_CAPTURE) {
+        return fake_error(EINVAL);
+    }
+    memset(&streamparm->parm, 0, sizeof(streamparm->parm));
+    streamparm->parm.capture.capability = V4L2_CAP_TIMEPERFRAME;
+    streamparm->parm.capture.timeperframe = _interval;
+    streamparm->parm.capture.readbuffers = 0;
+    return 0;
+}
+
+int V4L2FakeBackend::set_parm(struct v4l2_streamparm *streamparm) {
+    if (streamparm->type != V4L2_BUF_TYPE_VIDEO_CAPTURE) {
+        return fake_error(EINVAL);
+    }
+    /*uvcvideo refuses frame interval changes while streaming*/
+    if (_streaming) {
+        return fake_error(EBUSY);
+    }
+
+    /*closest supported interval*/
+    int64_t wanted = interval_ns(streamparm->parm.capture.timeperframe);
+    int64_t best_distance = -1;
+    for (size_t i = 0; i < _config.intervals.size(); i++) {
+        struct v4l2_fract interval;
+        interval.numerator = _config.intervals[i].numerator;
+        interval.denominator = _config.intervals[i].denominator;
+        int64_t distance = std::abs(interval_ns(interval) - wanted);
+        if (best_distance < 0 || distance < best_distance) {
+            _interval = interval;
+            best_distance = distance;
+        }
+    }
+    return get_parm(streamparm);
+}
+
+void V4L2FakeBackend::alloc_buffers(uint32_t count, uint32_t memory) {
+    /*page aligned offsets, like the drivers*/
+    long page_size = sysconf(_SC_PAGESIZE);
+    uint32_t length = _format.sizeimage;
+    uint32_t offset_step = ((length + page_size - 1) / page_size) * page_size;
+
+    for (uint32_t i = 0; i < count; i++) {
+        Buffer buffer;
+        if (memory == V4L2_MEMORY_MMAP) {
+            buffer.data.resize(length);
+        }
+        buffer.userptr = NULL;
+        buffer.length = length;
+        buffer.offset = _buffers.size() * offset_step;
+        buffer.flags = 0;
+        buffer.bytesused = 0;
+        buffer.sequence = 0;
+        buffer.timestamp.tv_sec = 0;
+        buffer.timestamp.tv_usec = 0;
+        _buffers.push_back(std::move(buffer));
+    }
+    _memory = memory;
+}
+
+void V4L2FakeBackend::free_buffers() {
+    _buffers.clear();
+    _queued.clear();
+    _done.clear();
+    _memory = 0;
+    signal_frames(false);
+}
+
+int V4L2FakeBackend::request_buffers(struct v4l2_requestbuffers *requestbuffers) {
+    if (requestbuffers->type != V4L2_BUF_TYPE_VIDEO_CAPTURE ||
+        (requestbuffers->memory != V4L2_MEMORY_MMAP &&
+         requestbuffers->memory != V4L2_MEMORY_USERPTR)) {
+        return fake_error(EINVAL);
+    }
+    if (_streaming) {
+        return fake_error(EBUSY);
+    }
+
+    free_buffers();
+    uint32_t count = std::min(requestbuffers->count, (uint32_t)FAKE_MAX_BUFFERS);
+    alloc_buffers(count, requestbuffers->memory);
+    requestbuffers->count = count;
+    return 0;
+}
+
+int V4L2FakeBackend::create_buffers(struct v4l2_create_buffers *create_buffers) {
+    if (create_buffers->format.type != V4L2_BUF_TYPE_VIDEO_CAPTURE ||
+        (create_buffers->memory != V4L2_MEMORY_MMAP &&
+         create_buffers->memory != V4L2_MEMORY_USERPTR) ||
+        (_memory != 0 && create_buffers->memory != _memory)) {
+        return fake_error(EINVAL);
+    }
+
+    uint32_t count = std::min(create_buffers->count,
+                              (uint32_t)(FAKE_MAX_BUFFERS - _buffers.size()));
+    create_buffers->index = _buffers.size();
+    alloc_buffers(count, create_buffers->memory);
+    create_buffers->count = count;
+    return 0;
+}
+
+void V4L2FakeBackend::fill_buffer_info(uint32_t index, struct v4l2_buffer *buffer) {
+    const Buffer &fake_buffer = _buffers[index];
+    buffer->index = index;
+    buffer->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buffer->memory = _memory;
+    buffer->length = fake_buffer.length;
+    buffer->bytesused = fake_buffer.bytesused;
+    buffer->flags = fake_buffer.flags | V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+    buffer->field = V4L2_FIELD_NONE;
+    buffer->timestamp = fake_buffer.timestamp;
+    buffer->sequence = fake_buffer.sequence;
+    if (_memory == V4L2_MEMORY_MMAP) {
+        buffer->m.offset = fake_buffer.offset;
+    } else {
+        buffer->m.userptr = (unsigned long)fake_buffer.userptr;
+    }
+}
+
+int V4L2FakeBackend::query_buffer(struct v4l2_buffer *buffer) {
+    if (buffer->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || buffer->index >= _buffers.size()) {
+        return fake_error(EINVAL);
+    }
+    fill_buffer_info(buffer->index, buffer);
+    return 0;
+}
+
+int V4L2FakeBackend::queue_buffer(struct v4l2_buffer *buffer) {
+    if (buffer->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || buffer->index >= _buffers.size() ||
+        buffer->memory != _memory) {
+        return fake_error(EINVAL);
+    }
+
+    Buffer &fake_buffer = _buffers[buffer->index];
+    if (fake_buffer.flags & (V4L2_BUF_FLAG_QUEUED | V4L2_BUF_FLAG_DONE)) {
+        return fake_error(EINVAL);
+    }
+    if (_memory == V4L2_MEMORY_USERPTR) {
+        if (buffer->m.userptr == 0 || buffer->length < _format.sizeimage) {
+            return fake_error(EINVAL);
+        }
+        fake_buffer.userptr = (uint8_t *)buffer->m.userptr;
+        fake_buffer.length = buffer->length;
+    }
+
+    fake_buffer.flags = V4L2_BUF_FLAG_QUEUED;
+    _queued.push_back(buffer->index);
+    fill_buffer_info(buffer->index, buffer);
+    return 0;
+}
+
+int V4L2FakeBackend::dequeue_buffer(struct v4l2_buffer *buffer) {
+    if (buffer->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || buffer->memory != _memory) {
+        return fake_error(EINVAL);
+    }
+    if (_done.empty()) {
+        /*the descriptor is always non blocking*/
+        return fake_error(_streaming ? EAGAIN : EINVAL);
+    }
+
+    uint32_t index = _done.front();
+    _done.pop_front();
+    _buffers[index].flags = 0;
+    fill_buffer_info(index, buffer);
+    buffer->flags |= V4L2_BUF_FLAG_DONE;
+
+    if (_done.empty()) {
+        signal_frames(false);
+    }
+    return 0;
+}
+
+int V4L2FakeBackend::stream_on() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_buffers.empty()) {
+        return fake_error(EINVAL);
+    }
+    if (_streaming) {
+        return 0;
+    }
+
+    _streaming = true;
+    _stop = false;
+    _sequence = 0;
+    _generator = std::thread(&V4L2FakeBackend::generate_frames, this);
+    return 0;
+}
+
+int V4L2FakeBackend::stream_off() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (!_streaming) {
+        return 0;
+    }
+
+    _stop = true;
+    _stop_cond.notify_all();
+    lock.unlock();
+    _generator.join();
+    lock.lock();
+
+    /*every buffer goes back to the application (dequeued state)*/
+    _streaming = false;
+    for (size_t i = 0; i < _buffers.size(); i++) {
+        _buffers[i].flags = 0;
+    }
+    _queued.clear();
+    _done.clear();
+    signal_frames(false);
+    return 0;
+}
+
+V4L2FakeBackend::Control *V4L2FakeBackend::find_control(uint32_t id) {
+    for (size_t i = 0; i < _controls.size(); i++) {
+        if (_controls[i].query.id == id) {
+            return &_controls[i];
+        }
+    }
+    return NULL;
+}
+
+int V4L2FakeBackend::query_ctrl(struct v4l2_queryctrl *queryctrl) {
+    const Control *control = NULL;
+    if (queryctrl->id & V4L2_CTRL_FLAG_NEXT_CTRL) {
+        /*controls are sorted by id*/
+        uint32_t id = queryctrl->id & ~(V4L2_CTRL_FLAG_NEXT_CTRL | V4L2_CTRL_FLAG_NEXT_COMPOUND);
+        for (size_t i = 0; i < _controls.size() && control == NULL; i++) {
+            if (_controls[i].query.id > id) {
+                control = &_controls[i];
+            }
+        }
+    } else {
+        control = find_control(queryctrl->id);
+    }
+
+    if (control == NULL) {
+        return fake_error(EINVAL);
+    }
+    *queryctrl = control->query;
+    return 0;
+}
+
+int V4L2FakeBackend::query_menu(struct v4l2_querymenu *querymenu) {
+    const Control *control = find_control(querymenu->id);
+    if (control == NULL || querymenu->index >= control->menu.size()) {
+        return fake_error(EINVAL);
+    }
+
+    memset(querymenu->name, 0, sizeof(querymenu->name));
+    strncpy((char *)querymenu->name, control->menu[querymenu->index].c_str(),
+            sizeof(querymenu->name) - 1);
+    return 0;
+}
+
+int V4L2FakeBackend::get_ctrl(struct v4l2_control *control) {
+    const Control *fake_control = find_control(control->id);
+    if (fake_control == NULL) {
+        return fake_error(EINVAL);
+    }
+    control->value = fake_control->value;
+    return 0;
+}
+
+int V4L2FakeBackend::set_ctrl(struct v4l2_control *control) {
+    Control *fake_control = find_control(control->id);
+    if (fake_control == NULL) {
+        return fake_error(EINVAL);
+    }
+    if (control->value < fake_control->query.minimum ||
+        control->value > fake_control->query.maximum) {
+        return fake_error(ERANGE);
+    }
+    fake_control->value = control->value;
+    return 0;
+}
+
+/*
+ * make the descriptor readable while frames are ready (eventfd counter)
+ */
+void V4L2FakeBackend::signal_frames(bool ready) {
+    if (_fd < 0) {
+        return;
+    }
+
+    /*EAGAIN only means the counter is already in the wanted state*/
+    uint64_t value = 1;
+    ssize_t ret = ready ? ::write(_fd, &value, sizeof(value)) : ::read(_fd, &value, sizeof(value));
+    (void)ret;
+}
+
+void V4L2FakeBackend::fill_frame(Buffer &buffer, uint32_t sequence) {
+    uint8_t *data = _memory == V4L2_MEMORY_MMAP ? buffer.data.data() : buffer.userptr;
+
+    if (is_compressed(_format.pixelformat) && !_config.mjpeg_frame.empty()) {
+        /*replay the caller's jpeg, cut to the buffer like an overflowing device payload*/
+        buffer.bytesused = std::min((uint32_t)_config.mjpeg_frame.size(), _format.sizeimage);
+        memcpy(data, _config.mjpeg_frame.data(), buffer.bytesused);
+        return;
+    }
+    if (is_compressed(_format.pixelformat)) {
+        /*jpeg markers around a comment with the sequence number (not decodable)*/
+        char comment[32];
+        int comment_size = snprintf(comment, sizeof(comment), "fake frame %u", sequence);
+        uint32_t size = 0;
+        data[size++] = 0xFF;
+        data[size++] = 0xD8; /*SOI*/
+        data[size++] = 0xFF;
+        data[size++] = 0xFE; /*COM*/
+        data[size++] = (comment_size + 2) >> 8;
+        data[size++] = (comment_size + 2) & 0xFF;
+        memcpy(data + size, comment, comment_size);
+        size += comment_size;
+        data[size++] = 0xFF;
+        data[size++] = 0xD9; /*EOI*/
+        buffer.bytesused = size;
+        return;
+    }
+
+    buffer.bytesused = _format.sizeimage;
+    if (!_config.test_pattern) {
+        return;
+    }
+
+    /*horizontal bands scrolling one line per frame*/
+    for (uint32_t y = 0; y < _format.height; y++) {
+        uint8_t luma = (y + sequence) & 0xFF;
+        uint8_t *line = data + (size_t)y * _format.bytesperline;
+        if (_format.pixelformat == V4L2_PIX_FMT_YUYV) {
+            uint32_t word = luma | (0x80 << 8) | (luma << 16) | (0x80u << 24);
+            std::fill_n((uint32_t *)line, _format.width / 2, word);
+        } else {
+            memset(line, luma, _format.bytesperline);
+        }
+    }
+    /*neutral chroma planes*/
+    size_t luma_size = (size_t)_format.bytesperline * _format.height;
+    if (_format.sizeimage > luma_size && _format.bytesperline == _format.width) {
+        memset(data + luma_size, 0x80, _format.sizeimage - luma_size);
+    }
+}
+
+void V4L2FakeBackend::generate_frames() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto next_frame = std::chrono::steady_clock::now();
+
+    while (!_stop) {
+        int64_t period = _config.frame_rate > 0 ? 1000000000LL / _config.frame_rate
+                                                 : interval_ns(_interval);
+        next_frame += std::chrono::nanoseconds(std::max(period, (int64_t)1));
+        /*too late: don't burst every missed frame, the rate just slips*/
+        auto now = std::chrono::steady_clock::now();
+        if (next_frame + std::chrono::nanoseconds(period * FAKE_MAX_LATE_FRAMES) < now) {
+            next_frame = now;
+        }
+        if (_stop_cond.wait_until(lock, next_frame, [this] { return _stop; })) {
+            break;
+        }
+
+        uint32_t sequence = _sequence++;
+        if (_queued.empty()) {
+            /*no buffer to fill, the frame is lost (sequence gap)*/
+            _dropped_frames++;
+            continue;
+        }
+
+        uint32_t index = _queued.front();
+        _queued.pop_front();
+        Buffer &buffer = _buffers[index];
+        fill_frame(buffer, sequence);
+
+        struct timespec timestamp;
+        clock_gettime(CLOCK_MONOTONIC, &timestamp);
+        buffer.timestamp.tv_sec = timestamp.tv_sec;
+        buffer.timestamp.tv_usec = timestamp.tv_nsec / 1000;
+        buffer.sequence = sequence;
+        buffer.flags = V4L2_BUF_FLAG_DONE;
+
+        _done.push_back(index);
+        signal_frames(true);
+    }
+}
+
+}  // namespace uvc
\ No newline at end of file
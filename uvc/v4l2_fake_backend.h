@@ -0,0 +1,146 @@
+#pragma once
+
+#include <linux/videodev2.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "v4l2_backend.h"
+#include "v4l2_context.h"
+
+namespace uvc {
+
+/*
+ * fake device frame size
+ */
+struct V4L2FakeSize {
+    uint32_t width;
+    uint32_t height;
+};
+
+/*
+ * fake device description
+ */
+struct V4L2FakeConfig {
+    std::string card = "uvclib fake camera";  //device name (VIDIOC_QUERYCAP card)
+    std::vector<uint32_t> pixel_formats = {V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_MJPEG};
+    std::vector<V4L2FakeSize> sizes = {{640, 480}, {1280, 720}, {1920, 1080}};
+    std::vector<V4L2Rational> intervals = {{1, 30}, {1, 60}, {1, 1000}};
+    uint32_t frame_rate = 0;           //generated frames per second (0 - the S_PARM interval)
+    uint8_t test_pattern = 1;          //draw a moving pattern in raw frames (0 - payload as is)
+    std::vector<uint8_t> mjpeg_frame;  //payload of every MJPEG frame (empty - markers only)
+};
+
+/*
+ * in-process fake camera: emulates a streaming capture device (QUERYCAP,
+ * ENUM_FMT/FRAMESIZES/FRAMEINTERVALS, G/S/TRY_FMT, G/S_PARM, REQBUFS,
+ * CREATE_BUFS, QUERYBUF, QBUF/DQBUF, STREAMON/OFF, QUERYCTRL/QUERYMENU and
+ * G/S_CTRL) and generates synthetic frames at the configured rate
+ *
+ * the device descriptor is an eventfd readable while frames are ready, so
+ * poll and epoll work as with a real device; one open at a time
+ *
+ * MJPEG frames only carry the jpeg markers and a comment with the
+ * sequence number, they don't decode to an image unless mjpeg_frame
+ * supplies a real jpeg to replay
+ */
+class V4L2FakeBackend final : public V4L2Backend {
+public:
+    explicit V4L2FakeBackend(const V4L2FakeConfig &config = V4L2FakeConfig());
+    ~V4L2FakeBackend();
+
+    V4L2FakeBackend(const V4L2FakeBackend &) = delete;
+    void operator=(const V4L2FakeBackend &) = delete;
+
+    int open(const char *device, int flags) override;
+    int close(int fd) override;
+    int ioctl(int fd, unsigned long request, void *arg) override;
+    void *mmap(size_t length, int prot, int flags, int fd, int64_t offset) override;
+    int munmap(void *start, size_t length) override;
+    ssize_t read(int fd, void *buffer, size_t size) override;
+    int poll(struct pollfd *fds, nfds_t count, int timeout_ms) override;
+    /*
+    * number of frames generated while no buffer was queued (dropped)
+    */
+    uint64_t get_dropped_frames();
+private:
+    /*
+    * fake driver buffer
+    */
+    struct Buffer {
+        std::vector<uint8_t> data;  //mmap memory
+        uint8_t *userptr;           //user memory (USERPTR)
+        uint32_t length;            //buffer length
+        uint32_t offset;            //mmap offset
+        uint32_t flags;             //V4L2_BUF_FLAG_QUEUED / V4L2_BUF_FLAG_DONE
+        uint32_t bytesused;         //payload size of the last frame
+        uint32_t sequence;          //sequence number of the last frame
+        struct timeval timestamp;   //CLOCK_MONOTONIC time of the last frame
+    };
+    /*
+    * fake device control
+    */
+    struct Control {
+        struct v4l2_queryctrl query;
+        int32_t value;
+        std::vector<std::string> menu;
+    };
+
+    int query_cap(struct v4l2_capability *cap);
+    int enum_fmt(struct v4l2_fmtdesc *fmtdesc);
+    int enum_frame_sizes(struct v4l2_frmsizeenum *frmsize);
+    int enum_frame_intervals(struct v4l2_frmivalenum *frmival);
+    int try_fmt(struct v4l2_format *format);
+    int set_fmt(struct v4l2_format *format);
+    int get_parm(struct v4l2_streamparm *streamparm);
+    int set_parm(struct v4l2_streamparm *streamparm);
+    int request_buffers(struct v4l2_requestbuffers *requestbuffers);
+    int create_buffers(struct v4l2_create_buffers *create_buffers);
+    int query_buffer(struct v4l2_buffer *buffer);
+    int queue_buffer(struct v4l2_buffer *buffer);
+    int dequeue_buffer(struct v4l2_buffer *buffer);
+    int stream_on();
+    int stream_off();
+    int query_ctrl(struct v4l2_queryctrl *queryctrl);
+    int query_menu(struct v4l2_querymenu *querymenu);
+    int get_ctrl(struct v4l2_control *control);
+    int set_ctrl(struct v4l2_control *control);
+
+    void alloc_buffers(uint32_t count, uint32_t memory);
+    void fill_buffer_info(uint32_t index, struct v4l2_buffer *buffer);
+    void free_buffers();
+    Control *find_control(uint32_t id);
+    /*
+    * frame generation thread (started by STREAMON)
+    */
+    void generate_frames();
+    void fill_frame(Buffer &buffer, uint32_t sequence);
+    void signal_frames(bool ready);
+private:
+    V4L2FakeConfig _config;
+    int _fd = -1;  //eventfd returned by open
+
+    std::mutex _mutex;  //protects everything below
+    std::condition_variable _stop_cond;
+    struct v4l2_pix_format _format;
+    struct v4l2_fract _interval;
+    std::vector<Control> _controls;
+
+    uint32_t _memory = 0;  //V4L2_MEMORY_MMAP or V4L2_MEMORY_USERPTR (0 - no buffers)
+    std::vector<Buffer> _buffers;
+    std::deque<uint32_t> _queued;  //buffers waiting for a frame
+    std::deque<uint32_t> _done;    //filled buffers waiting for DQBUF
+
+    bool _streaming = false;
+    bool _stop = false;
+    uint32_t _sequence = 0;
+    uint64_t _dropped_frames = 0;
+    std::thread _generator;
+};
+
+}  // namespace uvc
\ No newline at end of file
@@ -3,7 +3,10 @@
 #include <base/log.h>
 #include <string.h>
 
+#include <algorithm>
+
 #include "v4l2_define.h"
+#include "v4l2_mode_index.h"
 #include "v4l2_util.h"
 
 namespace uvc {
@@ -67,29 +70,102 @@ uint8_t can_decode_format(uint32_t pixelformat) {
     return FALSE;
 }
 
+/*
+ * compare two frame intervals
+ * args:
+ *   a - frame interval
+ *   b - frame interval
+ *
+ * returns: <0 if a is shorter than b, 0 if equal, >0 if longer
+ */
+int compare_interval(const V4L2Rational &a, const V4L2Rational &b) {
+    int64_t left = (int64_t)a.numerator * b.denominator;
+    int64_t right = (int64_t)b.numerator * a.denominator;
+    return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+/*
+ * round a size up to the next step of a range
+ * args:
+ *   value - requested size
+ *   min - range minimum
+ *   step - range step
+ *
+ * returns: smallest size of the range at or above value
+ */
+static int32_t round_up_to_step(int32_t value, int32_t min, int32_t step) {
+    if (value <= min) {
+        return min;
+    }
+    if (step <= 1) {
+        return value;
+    }
+    return min + ((value - min + step - 1) / step) * step;
+}
+
+/*
+ * fit a frame size to a stream capability
+ * args:
+ *   stream_cap - stream capability (discrete size or size range)
+ *   width - minimum frame width
+ *   height - minimum frame height
+ *   fit_width - pointer to the returned frame width
+ *   fit_height - pointer to the returned frame height
+ *
+ * returns: true if the capability has a size at or above width x height
+ *          (the smallest one is returned)
+ */
+bool fit_frame_size(const V4l2StreamCapability &stream_cap, int32_t width, int32_t height,
+                    int32_t *fit_width, int32_t *fit_height) {
+    if (stream_cap.size_type == V4L2_FRMSIZE_TYPE_DISCRETE) {
+        if (stream_cap.width < width || stream_cap.height < height) {
+            return false;
+        }
+        *fit_width = stream_cap.width;
+        *fit_height = stream_cap.height;
+        return true;
+    }
+
+    int32_t range_width = round_up_to_step(width, stream_cap.width, stream_cap.step_width);
+    int32_t range_height = round_up_to_step(height, stream_cap.height, stream_cap.step_height);
+    if (range_width > stream_cap.max_width || range_height > stream_cap.max_height) {
+        return false;
+    }
+    *fit_width = range_width;
+    *fit_height = range_height;
+    return true;
+}
+
 /*
  * enumerate frame framerate
  * args:
  *   context - pointer to V4L2Context
  *   pixfmt - v4l2 pixel format that we want to list framerate for
  *   stream_capability - stream capability that we want to list framerate for
+ *   width - frame width to list the framerates for
+ *   height - frame height to list the framerates for
  *
  * returns 0 if enumeration succeded or errno otherwise
  */
 static int enum_frame_framerate(V4L2Context *context, uint32_t pixfmt,
-                                V4l2StreamCapability &stream_capability) {
+                                V4l2StreamCapability &stream_capability, int32_t width,
+                                int32_t height) {
     stream_capability.framerates.clear();
+    stream_capability.interval_type = V4L2_FRMIVAL_TYPE_DISCRETE;
+    stream_capability.min_interval = {0, 0};
+    stream_capability.max_interval = {0, 0};
+    stream_capability.step_interval = {0, 0};
 
     struct v4l2_frmivalenum frame_ivalue_enum;
     memset(&frame_ivalue_enum, 0, sizeof(frame_ivalue_enum));
     frame_ivalue_enum.index = 0;
     frame_ivalue_enum.pixel_format = pixfmt;
-    frame_ivalue_enum.width = stream_capability.width;
-    frame_ivalue_enum.height = stream_capability.height;
+    frame_ivalue_enum.width = width;
+    frame_ivalue_enum.height = height;
 
     base::LogDebug() << "\tTime interval between frame: ";
     int ret = 0;
-    while ((ret = xioctl(context->fd, VIDIOC_ENUM_FRAMEINTERVALS, &frame_ivalue_enum)) == 0) {
+    while ((ret = xioctl(context, VIDIOC_ENUM_FRAMEINTERVALS, &frame_ivalue_enum)) == 0) {
         frame_ivalue_enum.index++;
         if (frame_ivalue_enum.type == V4L2_FRMIVAL_TYPE_DISCRETE) {
             base::LogDebug() << "\t\t" << frame_ivalue_enum.discrete.numerator << "/"
@@ -98,19 +174,32 @@ static int enum_frame_framerate(V4L2Context *context, uint32_t pixfmt,
             framerate.numerator = frame_ivalue_enum.discrete.numerator;
             framerate.denominator = frame_ivalue_enum.discrete.denominator;
             stream_capability.framerates.push_back(framerate);
-        } else if (frame_ivalue_enum.type == V4L2_FRMIVAL_TYPE_CONTINUOUS) {
-            base::LogDebug() << "\t\t{min { " << frame_ivalue_enum.stepwise.min.numerator << "/"
-                             << frame_ivalue_enum.stepwise.min.numerator << " } .. max { "
-                             << frame_ivalue_enum.stepwise.max.denominator << "/"
-                             << frame_ivalue_enum.stepwise.max.denominator << " }";
-            break;
-        } else if (frame_ivalue_enum.type == V4L2_FRMIVAL_TYPE_STEPWISE) {
+
+            if (stream_capability.min_interval.denominator == 0 ||
+                compare_interval(framerate, stream_capability.min_interval) < 0) {
+                stream_capability.min_interval = framerate;
+            }
+            if (stream_capability.max_interval.denominator == 0 ||
+                compare_interval(framerate, stream_capability.max_interval) > 0) {
+                stream_capability.max_interval = framerate;
+            }
+        } else if (frame_ivalue_enum.type == V4L2_FRMIVAL_TYPE_CONTINUOUS ||
+                   frame_ivalue_enum.type == V4L2_FRMIVAL_TYPE_STEPWISE) {
             base::LogDebug() << "\t\t{min { " << frame_ivalue_enum.stepwise.min.numerator << "/"
                              << frame_ivalue_enum.stepwise.min.denominator << "} .. max { "
                              << frame_ivalue_enum.stepwise.max.numerator << "/"
-                             << frame_ivalue_enum.stepwise.max.denominator << " "
+                             << frame_ivalue_enum.stepwise.max.denominator << " } .. step { "
                              << frame_ivalue_enum.stepwise.step.numerator << "/"
-                             << frame_ivalue_enum.stepwise.step.denominator << "}";
+                             << frame_ivalue_enum.stepwise.step.denominator << " }";
+            /*a single entry describes the whole range*/
+            stream_capability.interval_type = frame_ivalue_enum.type;
+            stream_capability.min_interval.numerator = frame_ivalue_enum.stepwise.min.numerator;
+            stream_capability.min_interval.denominator = frame_ivalue_enum.stepwise.min.denominator;
+            stream_capability.max_interval.numerator = frame_ivalue_enum.stepwise.max.numerator;
+            stream_capability.max_interval.denominator = frame_ivalue_enum.stepwise.max.denominator;
+            stream_capability.step_interval.numerator = frame_ivalue_enum.stepwise.step.numerator;
+            stream_capability.step_interval.denominator =
+                frame_ivalue_enum.stepwise.step.denominator;
             break;
         }
     }
@@ -132,7 +221,6 @@ static int enum_frame_framerate(V4L2Context *context, uint32_t pixfmt,
  * returns 0 if enumeration succeded or errno otherwise
  */
 static int enum_frame_sizes(V4L2Context *context, uint32_t pixfmt, int format_index) {
-    int frame_size_index = 0; /*index for supported sizes*/
     context->stream_formats[format_index].list_stream_cap.clear();
 
     struct v4l2_frmsizeenum frame_size_enum;
@@ -140,7 +228,7 @@ static int enum_frame_sizes(V4L2Context *context, uint32_t pixfmt, int format_in
     frame_size_enum.pixel_format = pixfmt;
 
     int ret = 0;
-    while ((ret = xioctl(context->fd, VIDIOC_ENUM_FRAMESIZES, &frame_size_enum)) == 0) {
+    while ((ret = xioctl(context, VIDIOC_ENUM_FRAMESIZES, &frame_size_enum)) == 0) {
         frame_size_enum.index++;
         if (frame_size_enum.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
             base::LogDebug() << "{ discrete: width = " << frame_size_enum.discrete.width
@@ -150,8 +238,11 @@ static int enum_frame_sizes(V4L2Context *context, uint32_t pixfmt, int format_in
 
             stream_capability.width = frame_size_enum.discrete.width;
             stream_capability.height = frame_size_enum.discrete.height;
+            stream_capability.max_width = stream_capability.width;
+            stream_capability.max_height = stream_capability.height;
 
-            ret = enum_frame_framerate(context, pixfmt, stream_capability);
+            ret = enum_frame_framerate(context, pixfmt, stream_capability,
+                                       stream_capability.width, stream_capability.height);
             context->stream_formats[format_index].list_stream_cap.emplace_back(stream_capability);
             if (ret != 0) {
                 base::LogError() << "Unable to enumerate framerate " << strerror(ret);
@@ -176,23 +267,24 @@ static int enum_frame_sizes(V4L2Context *context, uint32_t pixfmt, int format_in
 
             V4l2StreamCapability stream_capability;
 
+            stream_capability.size_type = frame_size_enum.type;
             stream_capability.width = frame_size_enum.stepwise.min_width;
             stream_capability.height = frame_size_enum.stepwise.min_height;
-
-            ret = enum_frame_framerate(context, pixfmt, stream_capability);
+            stream_capability.max_width = frame_size_enum.stepwise.max_width;
+            stream_capability.max_height = frame_size_enum.stepwise.max_height;
+            /*continuous ranges have a step of 1*/
+            stream_capability.step_width = std::max(frame_size_enum.stepwise.step_width, 1U);
+            stream_capability.step_height = std::max(frame_size_enum.stepwise.step_height, 1U);
+
+            /*intervals of the largest (slowest) frame are safe for the whole range*/
+            ret = enum_frame_framerate(context, pixfmt, stream_capability,
+                                       stream_capability.max_width, stream_capability.max_height);
             context->stream_formats[format_index].list_stream_cap.emplace_back(stream_capability);
             if (ret != 0) {
                 base::LogError() << "Unable to enumerate framerate " << strerror(ret);
             }
-
-            stream_capability.width = frame_size_enum.stepwise.max_width;
-            stream_capability.height = frame_size_enum.stepwise.max_height;
-
-            ret = enum_frame_framerate(context, pixfmt, stream_capability);
-
-            if (ret != 0) {
-                base::LogError() << "Unable to enumerate frame sizes " << strerror(ret);
-            }
+            /*the range is reported once (ret holds the framerate result, not ours)*/
+            return 0;
         } else {
             base::LogError() << "V4L2_CORE: fsize.type not supported: " << frame_size_enum.type;
         }
@@ -206,23 +298,35 @@ static int enum_frame_sizes(V4L2Context *context, uint32_t pixfmt, int format_in
 }
 
 /*
- * enumerate frame formats (pixelformats, resolutions and fps)
- * and creates list in vd->list_stream_formats
+ * (re)build the mode index over the stream formats
  * args:
  *   context - pointer to V4L2Context
  *
- * returns: 0 (E_OK) if enumeration succeded or error otherwise
+ * returns: void
  */
-int enum_frame_formats(V4L2Context *context) {
-    int valid_formats = 0; /*number of valid formats found (with valid frame sizes)*/
+void index_frame_formats(V4L2Context *context) {
+    if (context->mode_index == NULL) {
+        context->mode_index = new V4L2ModeIndex();
+    }
+    context->mode_index->build(context->stream_formats);
+}
+
+/*
+ * list the pixel formats (without their sizes and intervals)
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: void
+ */
+static void list_frame_formats(V4L2Context *context) {
+    context->stream_formats.clear();
 
     struct v4l2_fmtdesc format_description;
     memset(&format_description, 0, sizeof(format_description));
     format_description.index = 0;
     format_description.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
-    int ret = 0;
-    while ((ret = xioctl(context->fd, VIDIOC_ENUM_FMT, &format_description)) == 0) {
+    while (xioctl(context, VIDIOC_ENUM_FMT, &format_description) == 0) {
         V4L2StreamFormat new_stream_format;
         uint8_t dec_support = can_decode_format(format_description.pixelformat);
         uint32_t pix_format = format_description.pixelformat;
@@ -248,21 +352,43 @@ int enum_frame_formats(V4L2Context *context) {
                  (pix_format >> 8) & 0xFF, (pix_format >> 16) & 0xFF, (pix_format >> 24) & 0xFF);
         strncpy(new_stream_format.description, (char *)format_description.description, 31);
         context->stream_formats.push_back(new_stream_format);
+    }
+
+    if (errno != EINVAL) {
+        base::LogError() << "(VIDIOC_ENUM_FMT) - Error enumerating frame formats: "
+                         << strerror(errno);
+    }
+
+    context->formats_enumerated = FORMATS_LISTED;
+}
+
+/*
+ * enumerate frame formats (pixelformats, resolutions and fps)
+ * and creates list in vd->list_stream_formats
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: 0 (E_OK) if enumeration succeded or error otherwise
+ */
+int enum_frame_formats(V4L2Context *context) {
+    int valid_formats = 0; /*number of valid formats found (with valid frame sizes)*/
+
+    list_frame_formats(context);
+    for (size_t i = 0; i < context->stream_formats.size(); i++) {
+        V4L2StreamFormat &stream_format = context->stream_formats[i];
         //enumerate frame sizes
-        ret = enum_frame_sizes(context, format_description.pixelformat,
-                               context->stream_formats.size() - 1);
+        int ret = enum_frame_sizes(context, stream_format.pixel_format, i);
+        stream_format.caps_enumerated = 1;
         if (ret != E_OK) {
             base::LogError() << "Unable to enumerate frame sizes : " << ret;
         }
-        if (dec_support && !ret) {
+        if (stream_format.dec_support && !ret) {
             valid_formats++; /*the format can be decoded and it has valid frame sizes*/
         }
     }
+    context->formats_enumerated = FORMATS_COMPLETE;
 
-    if (errno != EINVAL) {
-        base::LogError() << "(VIDIOC_ENUM_FMT) - Error enumerating frame formats: "
-                         << strerror(errno);
-    }
+    index_frame_formats(context);
 
     if (valid_formats > 0) {
         return E_OK;
@@ -271,4 +397,97 @@ int enum_frame_formats(V4L2Context *context) {
     }
 }
 
+/*
+ * enumerate on demand the sizes and intervals of a format (lazy open)
+ * args:
+ *   context - pointer to V4L2Context
+ *   pixelformat - v4l2 pixel format (0 - every format)
+ *
+ * notes:
+ *   only what is missing is enumerated, the pixel formats are listed on
+ *   the first call; no-op once the formats are complete
+ *
+ * returns: error code (E_OK or E_FORMAT_ERR if the device lacks the format)
+ */
+int enum_frame_format_caps(V4L2Context *context, int pixelformat) {
+    if (context->formats_enumerated == FORMATS_COMPLETE) {
+        return E_OK;
+    }
+    if (context->formats_enumerated == FORMATS_NONE) {
+        list_frame_formats(context);
+    }
+
+    bool found = false;
+    bool changed = false;
+    bool complete = true;
+    for (size_t i = 0; i < context->stream_formats.size(); i++) {
+        V4L2StreamFormat &stream_format = context->stream_formats[i];
+        if (pixelformat == 0 || stream_format.pixel_format == pixelformat) {
+            found = true;
+            if (!stream_format.caps_enumerated) {
+                int ret = enum_frame_sizes(context, stream_format.pixel_format, i);
+                if (ret != E_OK) {
+                    base::LogError() << "Unable to enumerate frame sizes : " << ret;
+                }
+                stream_format.caps_enumerated = 1;
+                changed = true;
+            }
+        }
+        if (!stream_format.caps_enumerated) {
+            complete = false;
+        }
+    }
+
+    if (complete) {
+        context->formats_enumerated = FORMATS_COMPLETE;
+    }
+    if (changed || context->mode_index == NULL) {
+        index_frame_formats(context);
+    }
+
+    if (!found) {
+        base::LogError() << "V4L2_CORE: format " << pixelformat << " not supported by device";
+        return E_FORMAT_ERR;
+    }
+    return E_OK;
+}
+
+/*
+ * find the best mode for a format near a target (indexed lookup)
+ * args:
+ *   context - pointer to V4L2Context
+ *   pixelformat - v4l2 pixel format (0 - any format supported by the decoder)
+ *   width - minimum frame width
+ *   height - minimum frame height
+ *   fps - wanted frame rate (0 - fastest)
+ *   mode - pointer to the returned mode
+ *
+ * returns: error code (E_OK or E_FORMAT_ERR if no mode matches)
+ */
+int find_stream_mode(V4L2Context *context, int pixelformat, int32_t width, int32_t height,
+                     double fps, V4L2StreamMode *mode) {
+    if (enum_frame_format_caps(context, pixelformat) != E_OK) {
+        return E_FORMAT_ERR;
+    }
+    if (context->mode_index == NULL) {
+        base::LogError() << "V4L2_CORE: stream formats were not enumerated";
+        return E_FORMAT_ERR;
+    }
+
+    const V4l2StreamCapability *stream_cap = NULL;
+    int ret = context->mode_index->find_mode(pixelformat, width, height, fps, mode, &stream_cap);
+    if (ret != E_OK || stream_cap->size_type == V4L2_FRMSIZE_TYPE_DISCRETE) {
+        return ret;
+    }
+
+    /*a size range holds the intervals of its largest size, ask for the picked one*/
+    V4l2StreamCapability fit_cap = *stream_cap;
+    ret = enum_frame_framerate(context, mode->pixel_format, fit_cap, mode->width, mode->height);
+    if (ret == 0 && fit_cap.min_interval.denominator != 0) {
+        V4L2ModeIndex::sort_intervals(fit_cap);
+        mode->frame_interval = V4L2ModeIndex::pick_interval(fit_cap, fps);
+    }
+    return E_OK;
+}
+
 }  // namespace uvc
\ No newline at end of file
@@ -14,4 +14,75 @@ namespace uvc {
  */
 int enum_frame_formats(V4L2Context *context);
 
+/*
+ * enumerate on demand the sizes and intervals of a format (lazy open)
+ * args:
+ *   context - pointer to V4L2Context
+ *   pixelformat - v4l2 pixel format (0 - every format)
+ *
+ * notes:
+ *   only what is missing is enumerated, the pixel formats are listed on
+ *   the first call; no-op once the formats are complete
+ *
+ * returns: error code (E_OK or E_FORMAT_ERR if the device lacks the format)
+ */
+int enum_frame_format_caps(V4L2Context *context, int pixelformat);
+
+/*
+ * (re)build the mode index over the stream formats
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * notes:
+ *   enum_frame_formats builds it, call it when stream_formats is filled
+ *   some other way (e.g. the format cache)
+ *
+ * returns: void
+ */
+void index_frame_formats(V4L2Context *context);
+
+/*
+ * compare two frame intervals
+ * args:
+ *   a - frame interval
+ *   b - frame interval
+ *
+ * returns: <0 if a is shorter than b, 0 if equal, >0 if longer
+ */
+int compare_interval(const V4L2Rational &a, const V4L2Rational &b);
+
+/*
+ * fit a frame size to a stream capability
+ * args:
+ *   stream_cap - stream capability (discrete size or size range)
+ *   width - minimum frame width
+ *   height - minimum frame height
+ *   fit_width - pointer to the returned frame width
+ *   fit_height - pointer to the returned frame height
+ *
+ * returns: true if the capability has a size at or above width x height
+ *          (the smallest one is returned, rounded to the range step)
+ */
+bool fit_frame_size(const V4l2StreamCapability &stream_cap, int32_t width, int32_t height,
+                    int32_t *fit_width, int32_t *fit_height);
+
+/*
+ * find the best mode for a format near a target (indexed lookup)
+ * args:
+ *   context - pointer to V4L2Context
+ *   pixelformat - v4l2 pixel format (0 - any format supported by the decoder)
+ *   width - minimum frame width
+ *   height - minimum frame height
+ *   fps - wanted frame rate (0 - fastest)
+ *   mode - pointer to the returned mode
+ *
+ * notes:
+ *   picks the smallest size at or above width x height, then the slowest
+ *   frame interval that still reaches fps (the fastest one if none does)
+ *
+ * returns: error code (E_OK or E_FORMAT_ERR if no mode matches)
+ */
+int find_stream_mode(V4L2Context *context, int pixelformat, int32_t width, int32_t height,
+                     double fps, V4L2StreamMode *mode);
+
 }  // namespace uvc
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+#include "v4l2_context.h"
+
+namespace uvc {
+
+/*
+ * lock-free single producer / single consumer ring of frame views
+ *
+ * the capture thread is the only producer (push) and the application
+ * consumer the only reader (pop), neither of them ever takes a lock
+ */
+class V4L2FrameRing final {
+public:
+    /*
+    * size is rounded up to a power of 2
+    */
+    explicit V4L2FrameRing(uint32_t size) : _head(0), _tail(0), _cached_head(0), _cached_tail(0) {
+        uint32_t capacity = 1;
+        while (capacity < size) {
+            capacity <<= 1;
+        }
+        _slots.resize(capacity, nullptr);
+        _mask = capacity - 1;
+    }
+
+    V4L2FrameRing(const V4L2FrameRing &) = delete;
+    void operator=(const V4L2FrameRing &) = delete;
+
+    /*
+    * add a frame to the ring (producer only)
+    * return: false if the ring is full
+    */
+    bool push(V4L2FrameBuff *frame) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head - _cached_tail > _mask) {
+            _cached_tail = _tail.load(std::memory_order_acquire);
+            if (head - _cached_tail > _mask) {
+                return false;
+            }
+        }
+        _slots[head & _mask] = frame;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*
+    * take the oldest frame from the ring (consumer only)
+    * return: false if the ring is empty
+    */
+    bool pop(V4L2FrameBuff **frame) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _cached_head) {
+            _cached_head = _head.load(std::memory_order_acquire);
+            if (tail == _cached_head) {
+                return false;
+            }
+        }
+        *frame = _slots[tail & _mask];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint32_t get_capacity() const { return _mask + 1; }
+private:
+    std::vector<V4L2FrameBuff *> _slots;
+    uint32_t _mask;
+    alignas(64) std::atomic<uint32_t> _head;  // next slot to write (written by the producer)
+    alignas(64) std::atomic<uint32_t> _tail;  // next slot to read (written by the consumer)
+    alignas(64) uint32_t _cached_head;        // consumer copy of _head
+    alignas(64) uint32_t _cached_tail;        // producer copy of _tail
+};
+
+}  // namespace uvc
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "v4l2_ioctl_stats.h"
+
+#include <errno.h>
+#include <linux/videodev2.h>
+#include <time.h>
+
+#include <atomic>
+
+namespace uvc {
+
+/*
+ * statistics slot of one ioctl request
+ */
+struct IoctlSlot {
+    std::atomic<uint32_t> request;                //ioctl request code (0 - free slot)
+    std::atomic<uint64_t> calls;                  //number of calls
+    std::atomic<uint64_t> retries;                //number of retried attempts
+    std::atomic<uint64_t> errors;                 //number of failed calls
+    std::atomic<uint64_t> no_data;                //number of non blocking calls with nothing ready
+    std::atomic<V4L2LatencyHistogram *> latency;  //call latency (allocated on first call)
+};
+
+static IoctlSlot ioctl_slots[IOCTL_STATS_SLOTS];
+
+struct IoctlName {
+    uint32_t request;
+    const char *name;
+};
+
+#define IOCTL_NAME(request) {request, #request}
+
+static const IoctlName ioctl_names[] = {
+    IOCTL_NAME(VIDIOC_QUERYCAP),
+    IOCTL_NAME(VIDIOC_ENUM_FMT),
+    IOCTL_NAME(VIDIOC_G_FMT),
+    IOCTL_NAME(VIDIOC_S_FMT),
+    IOCTL_NAME(VIDIOC_TRY_FMT),
+    IOCTL_NAME(VIDIOC_REQBUFS),
+    IOCTL_NAME(VIDIOC_QUERYBUF),
+    IOCTL_NAME(VIDIOC_CREATE_BUFS),
+    IOCTL_NAME(VIDIOC_QBUF),
+    IOCTL_NAME(VIDIOC_DQBUF),
+    IOCTL_NAME(VIDIOC_EXPBUF),
+    IOCTL_NAME(VIDIOC_STREAMON),
+    IOCTL_NAME(VIDIOC_STREAMOFF),
+    IOCTL_NAME(VIDIOC_G_PARM),
+    IOCTL_NAME(VIDIOC_S_PARM),
+    IOCTL_NAME(VIDIOC_ENUM_FRAMESIZES),
+    IOCTL_NAME(VIDIOC_ENUM_FRAMEINTERVALS),
+    IOCTL_NAME(VIDIOC_QUERYCTRL),
+    IOCTL_NAME(VIDIOC_QUERY_EXT_CTRL),
+    IOCTL_NAME(VIDIOC_QUERYMENU),
+    IOCTL_NAME(VIDIOC_G_CTRL),
+    IOCTL_NAME(VIDIOC_S_CTRL),
+    IOCTL_NAME(VIDIOC_G_EXT_CTRLS),
+    IOCTL_NAME(VIDIOC_S_EXT_CTRLS),
+    IOCTL_NAME(VIDIOC_TRY_EXT_CTRLS),
+    IOCTL_NAME(VIDIOC_SUBSCRIBE_EVENT),
+    IOCTL_NAME(VIDIOC_UNSUBSCRIBE_EVENT),
+    IOCTL_NAME(VIDIOC_DQEVENT),
+    IOCTL_NAME(VIDIOC_ENUMINPUT),
+    IOCTL_NAME(VIDIOC_G_INPUT),
+    IOCTL_NAME(VIDIOC_S_INPUT),
+    /*last one*/
+    {0, NULL}};
+
+/*
+ * find (or claim) the slot of an ioctl request
+ * args:
+ *   request - ioctl request code
+ *
+ * returns: pointer to the slot (NULL if the table is full)
+ */
+static IoctlSlot *find_slot(uint32_t request) {
+    uint32_t first = _IOC_NR(request) % IOCTL_STATS_SLOTS;
+    for (uint32_t i = 0; i < IOCTL_STATS_SLOTS; i++) {
+        IoctlSlot *slot = &ioctl_slots[(first + i) % IOCTL_STATS_SLOTS];
+        uint32_t slot_request = slot->request.load(std::memory_order_acquire);
+        if (slot_request == request) {
+            return slot;
+        }
+        if (slot_request == 0) {
+            uint32_t expected = 0;
+            if (slot->request.compare_exchange_strong(expected, request,
+                                                      std::memory_order_acq_rel) ||
+                expected == request) {
+                return slot;
+            }
+        }
+    }
+    return NULL;
+}
+
+uint64_t ioctl_stats_begin() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+void record_ioctl(uint32_t request, uint64_t begin, uint32_t retries, int ret) {
+    int error = errno;
+    uint64_t latency = ioctl_stats_begin() - begin;
+
+    IoctlSlot *slot = find_slot(request);
+    if (slot != NULL) {
+        slot->calls.fetch_add(1, std::memory_order_relaxed);
+        if (retries > 0) {
+            slot->retries.fetch_add(retries, std::memory_order_relaxed);
+        }
+        if (ret != 0 && request == VIDIOC_DQBUF && error == EAGAIN) {
+            /*non blocking dequeue with no buffer ready: the normal idle case*/
+            slot->no_data.fetch_add(1, std::memory_order_relaxed);
+        } else if (ret != 0) {
+            slot->errors.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        V4L2LatencyHistogram *histogram = slot->latency.load(std::memory_order_acquire);
+        if (histogram == NULL) {
+            V4L2LatencyHistogram *new_histogram = new V4L2LatencyHistogram();
+            if (slot->latency.compare_exchange_strong(histogram, new_histogram,
+                                                      std::memory_order_acq_rel)) {
+                histogram = new_histogram;
+            } else {
+                /*another thread won the race, histogram holds its pointer*/
+                delete new_histogram;
+            }
+        }
+        histogram->record(latency);
+    }
+
+    errno = error;
+}
+
+void get_ioctl_stats(std::vector<V4L2IoctlStats> &stats) {
+    stats.clear();
+    for (uint32_t i = 0; i < IOCTL_STATS_SLOTS; i++) {
+        const IoctlSlot &slot = ioctl_slots[i];
+        uint32_t request = slot.request.load(std::memory_order_acquire);
+        V4L2LatencyHistogram *histogram = slot.latency.load(std::memory_order_acquire);
+        if (request == 0 || histogram == NULL) {
+            continue;
+        }
+
+        V4L2IoctlStats request_stats;
+        request_stats.request = request;
+        request_stats.name = ioctl_name(request);
+        request_stats.calls = slot.calls.load(std::memory_order_relaxed);
+        request_stats.retries = slot.retries.load(std::memory_order_relaxed);
+        request_stats.errors = slot.errors.load(std::memory_order_relaxed);
+        request_stats.no_data = slot.no_data.load(std::memory_order_relaxed);
+        request_stats.latency = histogram;
+        stats.push_back(request_stats);
+    }
+}
+
+void reset_ioctl_stats() {
+    for (uint32_t i = 0; i < IOCTL_STATS_SLOTS; i++) {
+        IoctlSlot &slot = ioctl_slots[i];
+        slot.calls.store(0, std::memory_order_relaxed);
+        slot.retries.store(0, std::memory_order_relaxed);
+        slot.errors.store(0, std::memory_order_relaxed);
+        slot.no_data.store(0, std::memory_order_relaxed);
+        V4L2LatencyHistogram *histogram = slot.latency.load(std::memory_order_acquire);
+        if (histogram != NULL) {
+            histogram->reset();
+        }
+    }
+}
+
+const char *ioctl_name(uint32_t request) {
+    for (int i = 0; ioctl_names[i].name != NULL; i++) {
+        if (ioctl_names[i].request == request) {
+            return ioctl_names[i].name;
+        }
+    }
+    return "UNKNOWN";
+}
+
+}  // namespace uvc
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "v4l2_latency.h"
+
+namespace uvc {
+
+/*
+ * maximum number of distinct ioctl requests with statistics
+ */
+#define IOCTL_STATS_SLOTS 128
+
+/*
+ * statistics of one ioctl request (process wide, every device)
+ */
+struct V4L2IoctlStats {
+    uint32_t request;                     //ioctl request code (VIDIOC_*)
+    const char *name;                     //request name (e.g. "VIDIOC_DQBUF")
+    uint64_t calls;                       //number of calls
+    uint64_t retries;                     //number of retried attempts (EINTR, ETIMEDOUT, ...)
+    uint64_t errors;                      //number of calls that failed (after the retries)
+    uint64_t no_data;                     //number of VIDIOC_DQBUF calls with no buffer (EAGAIN)
+    const V4L2LatencyHistogram *latency;  //call latency, retries included (ns)
+};
+
+/*
+ * start timing an ioctl call
+ * returns: start timestamp for record_ioctl
+ */
+uint64_t ioctl_stats_begin();
+
+/*
+ * record an ioctl call
+ * args:
+ *   request - ioctl request code
+ *   begin - start timestamp (from ioctl_stats_begin)
+ *   retries - number of retried attempts
+ *   ret - ioctl result
+ *
+ * notes:
+ *   lock-free, errno is preserved; a VIDIOC_DQBUF failing with EAGAIN is
+ *   counted as no data, not as an error
+ *
+ * returns: void
+ */
+void record_ioctl(uint32_t request, uint64_t begin, uint32_t retries, int ret);
+
+/*
+ * get the statistics of every ioctl request called so far
+ * args:
+ *   stats - returned statistics
+ *
+ * returns: void
+ */
+void get_ioctl_stats(std::vector<V4L2IoctlStats> &stats);
+
+/*
+ * clear the ioctl statistics (not atomic with respect to concurrent calls)
+ *
+ * returns: void
+ */
+void reset_ioctl_stats();
+
+/*
+ * get the name of an ioctl request
+ * args:
+ *   request - ioctl request code
+ *
+ * returns: request name ("VIDIOC_..." or "UNKNOWN")
+ */
+const char *ioctl_name(uint32_t request);
+
+}  // namespace uvc
\ No newline at end of file
@@ -0,0 +1,1194 @@
+#include "v4l2_jpeg.h"
+
+#include <base/log.h>
+#include <linux/videodev2.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "v4l2_define.h"
+
+namespace uvc {
+
+/*
+ * jpeg markers
+ */
+#define M_SOF0 0xC0
+#define M_SOF1 0xC1
+#define M_DHT 0xC4
+#define M_JPG 0xC8
+#define M_DAC 0xCC
+#define M_SOF15 0xCF
+#define M_RST0 0xD0
+#define M_RST7 0xD7
+#define M_SOI 0xD8
+#define M_EOI 0xD9
+#define M_SOS 0xDA
+#define M_DQT 0xDB
+#define M_DRI 0xDD
+#define M_TEM 0x01
+
+/*
+ * fixed point idct (LLM, as the libjpeg "islow" idct)
+ */
+#define IDCT_CONST_BITS 13
+#define IDCT_PASS1_BITS 2
+#define FIX_0_298631336 2446
+#define FIX_0_390180644 3196
+#define FIX_0_541196100 4433
+#define FIX_0_765366865 6270
+#define FIX_0_899976223 7373
+#define FIX_1_175875602 9633
+#define FIX_1_501321110 12299
+#define FIX_1_847759065 15137
+#define FIX_1_961570560 16069
+#define FIX_2_053119869 16819
+#define FIX_2_562915447 20995
+#define FIX_3_072711026 25172
+
+/*
+ * reduced (4 and 2 point) idct constants
+ */
+#define FIX_0_382683433 3135
+#define FIX_0_707106781 5793
+#define FIX_0_923879533 7568
+
+/*
+ * restart interval chunks per decode thread
+ */
+#define SLICE_CHUNKS_PER_THREAD 4
+
+/*
+ * zigzag index -> natural (row major) index, padded for corrupt run lengths
+ */
+static const uint8_t zigzag_order[64 + 16] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,  12, 19, 26, 33,
+    40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54,
+    47, 55, 62, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63};
+
+/*
+ * last zigzag index inside the top left block kept at scale 1, 2, 4 and 8
+ * (indexed by scale / 2)
+ */
+static const int32_t last_coef[5] = {63, 24, 4, 0, 0};
+
+/*
+ * standard huffman tables (JPEG Annex K.3), used by UVC MJPEG frames without DHT
+ */
+static const uint8_t default_dc_luma_bits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t default_dc_chroma_bits[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t default_dc_symbols[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+static const uint8_t default_ac_luma_bits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const uint8_t default_ac_luma_symbols[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61,
+    0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52,
+    0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25,
+    0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64,
+    0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83,
+    0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99,
+    0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+    0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3,
+    0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8,
+    0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa};
+
+static const uint8_t default_ac_chroma_bits[16] = {0, 2, 1, 2, 4, 4, 3, 4,
+                                                  7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t default_ac_chroma_symbols[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61,
+    0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33,
+    0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18,
+    0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44,
+    0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63,
+    0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a,
+    0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97,
+    0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+    0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca,
+    0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7,
+    0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa};
+
+static inline uint8_t clamp_pixel(int32_t value) {
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+static inline uint32_t read_u16(const uint8_t *data) {
+    return (data[0] << 8) | data[1];
+}
+
+V4L2JpegDecoder::V4L2JpegDecoder() {
+    memset(_huff_defined, 0, sizeof(_huff_defined));
+    memset(_quant_defined, 0, sizeof(_quant_defined));
+    memset(_staged, 0, sizeof(_staged));
+    _width = 0;
+    _height = 0;
+    _component_count = 0;
+    _scan_components = 0;
+    _h_max = 1;
+    _v_max = 1;
+    _restart_interval = 0;
+    _block_size = 8;
+    _last_coef = 63;
+    _threads = 1;
+    _slice_job = 0;
+    _slice_busy = 0;
+    _slice_stop = false;
+}
+
+V4L2JpegDecoder::~V4L2JpegDecoder() { stop_slice_threads(); }
+
+/*
+ * build the lookup tables of a huffman table
+ * args:
+ *   bits - number of codes of each length (1 to 16)
+ *   symbols - symbols in code order
+ *   table - pointer to the derived table
+ *
+ * returns: error code (E_OK or E_BAD_TABLES_ERR)
+ */
+int V4L2JpegDecoder::build_huff_table(const uint8_t *bits, const uint8_t *symbols,
+                                      JpegHuffTable *table) {
+    int count = 0;
+    for (int i = 0; i < 16; ++i) {
+        count += bits[i];
+    }
+    if (count > 256) {
+        return E_BAD_TABLES_ERR;
+    }
+    memcpy(table->symbols, symbols, count);
+    memset(table->fast_length, 0, sizeof(table->fast_length));
+
+    int32_t code = 0;
+    int index = 0;
+    for (int length = 1; length <= 16; ++length) {
+        table->value_offset[length] = index - code;
+        for (int i = 0; i < bits[length - 1]; ++i, ++index, ++code) {
+            if (code >= (1 << length)) {
+                return E_BAD_TABLES_ERR;
+            }
+            if (length <= JPEG_FAST_BITS) {
+                int shift = JPEG_FAST_BITS - length;
+                for (int j = 0; j < (1 << shift); ++j) {
+                    table->fast_length[(code << shift) + j] = length;
+                    table->fast_symbol[(code << shift) + j] = symbols[index];
+                }
+            }
+        }
+        table->max_code[length] = bits[length - 1] ? code - 1 : -1;
+        code <<= 1;
+    }
+    table->max_code[17] = INT32_MAX;
+    return E_OK;
+}
+
+/*
+ * load a standard (Annex K.3) huffman table, index 0 gets the luma table
+ * and the others the chroma table
+ */
+void V4L2JpegDecoder::load_default_huff_table(int table_class, int index) {
+    if (table_class == 0) {
+        build_huff_table(index == 0 ? default_dc_luma_bits : default_dc_chroma_bits,
+                         default_dc_symbols, &_huff_tables[0][index]);
+    } else {
+        build_huff_table(index == 0 ? default_ac_luma_bits : default_ac_chroma_bits,
+                         index == 0 ? default_ac_luma_symbols : default_ac_chroma_symbols,
+                         &_huff_tables[1][index]);
+    }
+    _huff_defined[table_class][index] = 1;
+}
+
+int V4L2JpegDecoder::parse_sof(const uint8_t *segment, uint32_t length) {
+    if (length < 6) {
+        return E_DECODE_ERR;
+    }
+    if (segment[0] != 8) {
+        return E_NOT_8BIT_ERR;
+    }
+    _height = read_u16(segment + 1);
+    _width = read_u16(segment + 3);
+    if (_width == 0 || _height == 0) {
+        return E_BAD_WIDTH_OR_HEIGHT_ERR;
+    }
+
+    int count = segment[5];
+    if (count > 3) {
+        return E_TOO_MANY_COMPPS_ERR;
+    }
+    if (count != 1 && count != 3) {
+        return E_NOT_YCBCR_ERR;
+    }
+    if (length < 6 + 3 * (uint32_t)count) {
+        return E_DECODE_ERR;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        const uint8_t *spec = segment + 6 + 3 * i;
+        JpegComponent &component = _components[i];
+        component.id = spec[0];
+        component.h_samp = spec[1] >> 4;
+        component.v_samp = spec[1] & 0x0F;
+        component.quant_table = spec[2];
+        if (component.quant_table > 3) {
+            return E_QUANT_TBL_SEL_ERR;
+        }
+        if (count == 1) {
+            /*the sampling factors of a single component don't matter*/
+            component.h_samp = 1;
+            component.v_samp = 1;
+        }
+    }
+
+    if (count == 3) {
+        if (_components[0].id == 'R' && _components[1].id == 'G' && _components[2].id == 'B') {
+            return E_NOT_YCBCR_ERR;
+        }
+        /*chroma 1x1, luma 1x1, 2x1, 1x2 or 2x2*/
+        for (int i = 0; i < count; ++i) {
+            int max_samp = i == 0 ? 2 : 1;
+            if (_components[i].h_samp < 1 || _components[i].h_samp > max_samp ||
+                _components[i].v_samp < 1 || _components[i].v_samp > max_samp) {
+                return E_ILLEGAL_HV_ERR;
+            }
+        }
+    }
+
+    _component_count = count;
+    _h_max = _components[0].h_samp;
+    _v_max = _components[0].v_samp;
+    for (int i = 0; i < count; ++i) {
+        JpegComponent &component = _components[i];
+        component.width = (_width * component.h_samp + _h_max - 1) / _h_max;
+        component.height = (_height * component.v_samp + _v_max - 1) / _v_max;
+    }
+    return E_OK;
+}
+
+int V4L2JpegDecoder::parse_dht(const uint8_t *segment, uint32_t length) {
+    while (length > 0) {
+        if (length < 17) {
+            return E_BAD_TABLES_ERR;
+        }
+        int table_class = segment[0] >> 4;
+        int index = segment[0] & 0x0F;
+        if (table_class > 1 || index > 3) {
+            return E_BAD_TABLES_ERR;
+        }
+        uint32_t count = 0;
+        for (int i = 0; i < 16; ++i) {
+            count += segment[1 + i];
+        }
+        if (length < 17 + count) {
+            return E_BAD_TABLES_ERR;
+        }
+
+        int ret = build_huff_table(segment + 1, segment + 17, &_huff_tables[table_class][index]);
+        if (ret != E_OK) {
+            return ret;
+        }
+        _huff_defined[table_class][index] = 1;
+
+        segment += 17 + count;
+        length -= 17 + count;
+    }
+    return E_OK;
+}
+
+int V4L2JpegDecoder::parse_dqt(const uint8_t *segment, uint32_t length) {
+    while (length > 0) {
+        int precision = segment[0] >> 4;
+        int index = segment[0] & 0x0F;
+        if (index > 3) {
+            return E_QUANT_TBL_SEL_ERR;
+        }
+        if (precision > 1) {
+            return E_DECODE_ERR;
+        }
+        uint32_t table_length = 1 + 64 * (precision + 1);
+        if (length < table_length) {
+            return E_DECODE_ERR;
+        }
+
+        for (int i = 0; i < 64; ++i) {
+            _quant_tables[index][i] =
+                precision ? read_u16(segment + 1 + 2 * i) : segment[1 + i];
+        }
+        _quant_defined[index] = 1;
+
+        segment += table_length;
+        length -= table_length;
+    }
+    return E_OK;
+}
+
+int V4L2JpegDecoder::parse_sos(const uint8_t *segment, uint32_t length) {
+    if (_component_count == 0) {
+        /*scan before the frame header*/
+        return E_WRONG_MARKER_ERR;
+    }
+    if (length < 1) {
+        return E_DECODE_ERR;
+    }
+    int count = segment[0];
+    if (count < 1 || count > _component_count || length < 4 + 2 * (uint32_t)count) {
+        return E_DECODE_ERR;
+    }
+    if (count != _component_count) {
+        base::LogError() << "V4L2_JPEG: non interleaved scans are not supported";
+        return E_DECODE_ERR;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        uint8_t id = segment[1 + 2 * i];
+        int index = 0;
+        while (index < _component_count && _components[index].id != id) {
+            index++;
+        }
+        if (index == _component_count) {
+            return E_UNKNOWN_CID_ERR;
+        }
+        JpegComponent &component = _components[index];
+        component.dc_table = segment[2 + 2 * i] >> 4;
+        component.ac_table = segment[2 + 2 * i] & 0x0F;
+        if (component.dc_table > 3 || component.ac_table > 3) {
+            return E_BAD_TABLES_ERR;
+        }
+        if (!_quant_defined[component.quant_table]) {
+            return E_QUANT_TBL_SEL_ERR;
+        }
+        /*MJPEG frames usually leave the huffman tables out*/
+        if (!_huff_defined[0][component.dc_table]) {
+            load_default_huff_table(0, component.dc_table);
+        }
+        if (!_huff_defined[1][component.ac_table]) {
+            load_default_huff_table(1, component.ac_table);
+        }
+        _scan_order[i] = index;
+    }
+    _scan_components = count;
+
+    /*baseline: one sequential scan with all the coefficients*/
+    const uint8_t *spectral = segment + 1 + 2 * count;
+    if (spectral[0] != 0 || spectral[1] != 63 || spectral[2] != 0) {
+        return E_DECODE_ERR;
+    }
+    return E_OK;
+}
+
+/*
+ * parse the markers up to the start of scan
+ * args:
+ *   data - jpeg frame
+ *   size - frame size
+ *   scan_offset - pointer to the returned offset of the entropy coded data
+ *
+ * returns: error code (E_OK)
+ */
+int V4L2JpegDecoder::parse_header(const uint8_t *data, size_t size, size_t *scan_offset) {
+    if (size < 4 || data[0] != 0xFF || data[1] != M_SOI) {
+        return E_NO_SOI_ERR;
+    }
+    _component_count = 0;
+    _restart_interval = 0;
+
+    size_t pos = 2;
+    while (true) {
+        if (pos >= size) {
+            return E_NO_EOI_ERR;
+        }
+        if (data[pos] != 0xFF) {
+            return E_WRONG_MARKER_ERR;
+        }
+        /*skip fill bytes*/
+        while (pos < size && data[pos] == 0xFF) {
+            pos++;
+        }
+        if (pos >= size) {
+            return E_NO_EOI_ERR;
+        }
+
+        uint8_t marker = data[pos++];
+        if (marker == M_EOI || marker == M_SOI || marker == M_TEM ||
+            (marker >= M_RST0 && marker <= M_RST7)) {
+            return E_WRONG_MARKER_ERR;
+        }
+        if (pos + 2 > size) {
+            return E_NO_EOI_ERR;
+        }
+        uint32_t length = read_u16(data + pos);
+        if (length < 2 || pos + length > size) {
+            return E_NO_EOI_ERR;
+        }
+        const uint8_t *segment = data + pos + 2;
+        uint32_t segment_length = length - 2;
+
+        int ret = E_OK;
+        switch (marker) {
+            case M_SOF0:
+            case M_SOF1:
+                ret = parse_sof(segment, segment_length);
+                break;
+            case M_DHT:
+                ret = parse_dht(segment, segment_length);
+                break;
+            case M_DQT:
+                ret = parse_dqt(segment, segment_length);
+                break;
+            case M_DRI:
+                if (segment_length < 2) {
+                    return E_DECODE_ERR;
+                }
+                _restart_interval = read_u16(segment);
+                break;
+            case M_SOS:
+                ret = parse_sos(segment, segment_length);
+                if (ret == E_OK) {
+                    *scan_offset = pos + length;
+                    return E_OK;
+                }
+                break;
+            default:
+                if (marker > M_SOF1 && marker <= M_SOF15 && marker != M_DHT && marker != M_JPG &&
+                    marker != M_DAC) {
+                    base::LogError() << "V4L2_JPEG: unsupported jpeg process (SOF"
+                                     << marker - M_SOF0 << "), only baseline is decoded";
+                    return E_DECODE_ERR;
+                }
+                /*APPn, COM, ...*/
+                break;
+        }
+        if (ret != E_OK) {
+            return ret;
+        }
+        pos += length;
+    }
+}
+
+/*
+ * remove the 0xFF00 stuffing and the restart markers from the scan, the
+ * unstuffed start of each restart interval goes to _segments
+ */
+size_t V4L2JpegDecoder::unstuff_scan(const uint8_t *data, size_t size, uint8_t *scratch,
+                                     int *eoi_found) {
+    _segments.clear();
+    _segments.push_back(0);
+    *eoi_found = FALSE;
+
+    size_t out = 0;
+    size_t pos = 0;
+    while (pos < size) {
+        const uint8_t *marker = (const uint8_t *)memchr(data + pos, 0xFF, size - pos);
+        size_t run = marker ? marker - (data + pos) : size - pos;
+        memcpy(scratch + out, data + pos, run);
+        out += run;
+        pos += run;
+        if (marker == NULL) {
+            break;
+        }
+
+        size_t next = pos + 1;
+        while (next < size && data[next] == 0xFF) {
+            next++;
+        }
+        if (next >= size) {
+            break;
+        }
+        if (data[next] == 0x00) {
+            scratch[out++] = 0xFF;
+        } else if (data[next] >= M_RST0 && data[next] <= M_RST7) {
+            _segments.push_back(out);
+        } else {
+            /*EOI (or any other marker) ends the scan*/
+            *eoi_found = data[next] == M_EOI;
+            break;
+        }
+        pos = next + 1;
+    }
+    return out;
+}
+
+/*
+ * fill the bit buffer with at least 57 bits (zero bytes past the end)
+ */
+static inline void fill_bits(JpegBitReader &reader) {
+    if (reader.pos + 8 <= reader.size) {
+        uint64_t word;
+        memcpy(&word, reader.data + reader.pos, 8);
+        word = __builtin_bswap64(word);
+        int bytes = (64 - reader.count) >> 3;
+        int unused = 64 - reader.count - 8 * bytes;
+        reader.bits |= (word >> reader.count) & ~((1ULL << unused) - 1);
+        reader.pos += bytes;
+        reader.count += 8 * bytes;
+        return;
+    }
+    while (reader.count <= 56) {
+        uint64_t byte = 0;
+        if (reader.pos < reader.size) {
+            byte = reader.data[reader.pos++];
+        } else {
+            reader.overrun++;
+        }
+        reader.bits |= byte << (56 - reader.count);
+        reader.count += 8;
+    }
+}
+
+/*
+ * check if the reader consumed bits past the end of its data
+ */
+static inline int bits_overrun(const JpegBitReader &reader) {
+    return 8 * (reader.pos + reader.overrun) - reader.count > 8 * reader.size;
+}
+
+/*
+ * decode a huffman symbol (the buffer must hold 16 bits)
+ * returns: symbol (-1 on a code not in the table)
+ */
+static inline int decode_huff(JpegBitReader &reader, const JpegHuffTable &table) {
+    uint32_t look = reader.bits >> (64 - JPEG_FAST_BITS);
+    int length = table.fast_length[look];
+    if (length) {
+        reader.bits <<= length;
+        reader.count -= length;
+        return table.fast_symbol[look];
+    }
+
+    uint32_t code16 = reader.bits >> 48;
+    for (length = JPEG_FAST_BITS + 1; length <= 16; ++length) {
+        int32_t code = code16 >> (16 - length);
+        if (code <= table.max_code[length]) {
+            reader.bits <<= length;
+            reader.count -= length;
+            return table.symbols[code + table.value_offset[length]];
+        }
+    }
+    return -1;
+}
+
+/*
+ * read a size bits value and extend its sign (JPEG F.2.2.1)
+ */
+static inline int32_t receive_extend(JpegBitReader &reader, int size) {
+    if (size == 0) {
+        return 0;
+    }
+    int32_t value = reader.bits >> (64 - size);
+    reader.bits <<= size;
+    reader.count -= size;
+    if (value < (1 << (size - 1))) {
+        value -= (1 << size) - 1;
+    }
+    return value;
+}
+
+/*
+ * decode and dequantize one block (natural order)
+ * returns: 1 if the block has ac coefficients, 0 if not, error code (<0) on errors
+ */
+int V4L2JpegDecoder::decode_block(JpegBitReader &reader, const JpegComponent &component,
+                                  int32_t *dc_pred, int32_t *coefs) {
+    const JpegHuffTable &dc_table = _huff_tables[0][component.dc_table];
+    const JpegHuffTable &ac_table = _huff_tables[1][component.ac_table];
+    const uint16_t *quant = _quant_tables[component.quant_table];
+
+    memset(coefs, 0, 64 * sizeof(int32_t));
+    if (reader.count < 32) {
+        fill_bits(reader);
+    }
+    int size = decode_huff(reader, dc_table);
+    if (size < 0 || size > 11) {
+        return E_DECODE_ERR;
+    }
+    *dc_pred += receive_extend(reader, size);
+    coefs[0] = *dc_pred * quant[0];
+
+    int ac_present = 0;
+    for (int k = 1; k < 64;) {
+        if (reader.count < 32) {
+            fill_bits(reader);
+        }
+        int symbol = decode_huff(reader, ac_table);
+        if (symbol < 0) {
+            return E_DECODE_ERR;
+        }
+        int run = symbol >> 4;
+        size = symbol & 0x0F;
+        if (size == 0) {
+            if (run != 15) {
+                /*end of block*/
+                break;
+            }
+            k += 16;
+            continue;
+        }
+        k += run;
+        if (k > 63) {
+            return E_DECODE_ERR;
+        }
+        if (k > _last_coef) {
+            /*dropped by a scaled decode: skip the bits*/
+            reader.bits <<= size;
+            reader.count -= size;
+        } else {
+            coefs[zigzag_order[k]] = receive_extend(reader, size) * quant[k];
+            ac_present = 1;
+        }
+        k++;
+    }
+    return ac_present;
+}
+
+/*
+ * inverse dct of a dequantized block to 8x8 pixels
+ */
+void V4L2JpegDecoder::idct_block(const int32_t *coefs, int ac_present, uint8_t *pixels) {
+    if (!ac_present) {
+        memset(pixels, clamp_pixel(((coefs[0] + 4) >> 3) + 128), 64);
+        return;
+    }
+
+    int32_t workspace[64];
+    /*pass 1: columns, results scaled up by 2^IDCT_PASS1_BITS*/
+    for (int column = 0; column < 8; ++column) {
+        const int32_t *in = coefs + column;
+        int32_t *ws = workspace + column;
+        if (in[8] == 0 && in[16] == 0 && in[24] == 0 && in[32] == 0 && in[40] == 0 &&
+            in[48] == 0 && in[56] == 0) {
+            int32_t dc = in[0] * (1 << IDCT_PASS1_BITS);
+            for (int row = 0; row < 8; ++row) {
+                ws[row * 8] = dc;
+            }
+            continue;
+        }
+
+        int32_t z2 = in[16];
+        int32_t z3 = in[48];
+        int32_t z1 = (z2 + z3) * FIX_0_541196100;
+        int32_t tmp2 = z1 - z3 * FIX_1_847759065;
+        int32_t tmp3 = z1 + z2 * FIX_0_765366865;
+        int32_t tmp0 = (in[0] + in[32]) * (1 << IDCT_CONST_BITS);
+        int32_t tmp1 = (in[0] - in[32]) * (1 << IDCT_CONST_BITS);
+        int32_t tmp10 = tmp0 + tmp3;
+        int32_t tmp13 = tmp0 - tmp3;
+        int32_t tmp11 = tmp1 + tmp2;
+        int32_t tmp12 = tmp1 - tmp2;
+
+        tmp0 = in[56];
+        tmp1 = in[40];
+        tmp2 = in[24];
+        tmp3 = in[8];
+        z1 = tmp0 + tmp3;
+        z2 = tmp1 + tmp2;
+        z3 = tmp0 + tmp2;
+        int32_t z4 = tmp1 + tmp3;
+        int32_t z5 = (z3 + z4) * FIX_1_175875602;
+        tmp0 *= FIX_0_298631336;
+        tmp1 *= FIX_2_053119869;
+        tmp2 *= FIX_3_072711026;
+        tmp3 *= FIX_1_501321110;
+        z1 *= -FIX_0_899976223;
+        z2 *= -FIX_2_562915447;
+        z3 = z3 * -FIX_1_961570560 + z5;
+        z4 = z4 * -FIX_0_390180644 + z5;
+        tmp0 += z1 + z3;
+        tmp1 += z2 + z4;
+        tmp2 += z2 + z3;
+        tmp3 += z1 + z4;
+
+        const int shift = IDCT_CONST_BITS - IDCT_PASS1_BITS;
+        const int32_t round = 1 << (shift - 1);
+        ws[0] = (tmp10 + tmp3 + round) >> shift;
+        ws[56] = (tmp10 - tmp3 + round) >> shift;
+        ws[8] = (tmp11 + tmp2 + round) >> shift;
+        ws[48] = (tmp11 - tmp2 + round) >> shift;
+        ws[16] = (tmp12 + tmp1 + round) >> shift;
+        ws[40] = (tmp12 - tmp1 + round) >> shift;
+        ws[24] = (tmp13 + tmp0 + round) >> shift;
+        ws[32] = (tmp13 - tmp0 + round) >> shift;
+    }
+
+    /*pass 2: rows, remove the pass 1 scale and the 8x8 dct scale (3 bits)*/
+    for (int row = 0; row < 8; ++row) {
+        const int32_t *ws = workspace + row * 8;
+        uint8_t *out = pixels + row * 8;
+        if (ws[1] == 0 && ws[2] == 0 && ws[3] == 0 && ws[4] == 0 && ws[5] == 0 && ws[6] == 0 &&
+            ws[7] == 0) {
+            memset(out, clamp_pixel(((ws[0] + (1 << (IDCT_PASS1_BITS + 2))) >>
+                                     (IDCT_PASS1_BITS + 3)) + 128),
+                   8);
+            continue;
+        }
+
+        int32_t z2 = ws[2];
+        int32_t z3 = ws[6];
+        int32_t z1 = (z2 + z3) * FIX_0_541196100;
+        int32_t tmp2 = z1 - z3 * FIX_1_847759065;
+        int32_t tmp3 = z1 + z2 * FIX_0_765366865;
+        int32_t tmp0 = (ws[0] + ws[4]) * (1 << IDCT_CONST_BITS);
+        int32_t tmp1 = (ws[0] - ws[4]) * (1 << IDCT_CONST_BITS);
+        int32_t tmp10 = tmp0 + tmp3;
+        int32_t tmp13 = tmp0 - tmp3;
+        int32_t tmp11 = tmp1 + tmp2;
+        int32_t tmp12 = tmp1 - tmp2;
+
+        tmp0 = ws[7];
+        tmp1 = ws[5];
+        tmp2 = ws[3];
+        tmp3 = ws[1];
+        z1 = tmp0 + tmp3;
+        z2 = tmp1 + tmp2;
+        z3 = tmp0 + tmp2;
+        int32_t z4 = tmp1 + tmp3;
+        int32_t z5 = (z3 + z4) * FIX_1_175875602;
+        tmp0 *= FIX_0_298631336;
+        tmp1 *= FIX_2_053119869;
+        tmp2 *= FIX_3_072711026;
+        tmp3 *= FIX_1_501321110;
+        z1 *= -FIX_0_899976223;
+        z2 *= -FIX_2_562915447;
+        z3 = z3 * -FIX_1_961570560 + z5;
+        z4 = z4 * -FIX_0_390180644 + z5;
+        tmp0 += z1 + z3;
+        tmp1 += z2 + z4;
+        tmp2 += z2 + z3;
+        tmp3 += z1 + z4;
+
+        const int shift = IDCT_CONST_BITS + IDCT_PASS1_BITS + 3;
+        const int32_t round = 1 << (shift - 1);
+        out[0] = clamp_pixel(((tmp10 + tmp3 + round) >> shift) + 128);
+        out[7] = clamp_pixel(((tmp10 - tmp3 + round) >> shift) + 128);
+        out[1] = clamp_pixel(((tmp11 + tmp2 + round) >> shift) + 128);
+        out[6] = clamp_pixel(((tmp11 - tmp2 + round) >> shift) + 128);
+        out[2] = clamp_pixel(((tmp12 + tmp1 + round) >> shift) + 128);
+        out[5] = clamp_pixel(((tmp12 - tmp1 + round) >> shift) + 128);
+        out[3] = clamp_pixel(((tmp13 + tmp0 + round) >> shift) + 128);
+        out[4] = clamp_pixel(((tmp13 - tmp0 + round) >> shift) + 128);
+    }
+}
+
+/*
+ * 4x4 inverse dct of the top left 4x4 coefficients (1/2 scale block), the
+ * pixels keep the 8 byte row stride
+ */
+void V4L2JpegDecoder::idct_4x4(const int32_t *coefs, uint8_t *pixels) {
+    int32_t workspace[16];
+    /*pass 1: columns, results scaled up by 2^IDCT_PASS1_BITS (and 2)*/
+    for (int column = 0; column < 4; ++column) {
+        const int32_t *in = coefs + column;
+        int32_t even0 = (in[0] + in[16]) * FIX_0_707106781;
+        int32_t even1 = (in[0] - in[16]) * FIX_0_707106781;
+        int32_t odd0 = in[8] * FIX_0_923879533 + in[24] * FIX_0_382683433;
+        int32_t odd1 = in[8] * FIX_0_382683433 - in[24] * FIX_0_923879533;
+
+        const int shift = IDCT_CONST_BITS - IDCT_PASS1_BITS;
+        const int32_t round = 1 << (shift - 1);
+        workspace[column] = (even0 + odd0 + round) >> shift;
+        workspace[12 + column] = (even0 - odd0 + round) >> shift;
+        workspace[4 + column] = (even1 + odd1 + round) >> shift;
+        workspace[8 + column] = (even1 - odd1 + round) >> shift;
+    }
+
+    /*pass 2: rows, remove the pass 1 scale and the 4x4 dct scale (2 bits)*/
+    for (int row = 0; row < 4; ++row) {
+        const int32_t *ws = workspace + row * 4;
+        uint8_t *out = pixels + row * 8;
+        int32_t even0 = (ws[0] + ws[2]) * FIX_0_707106781;
+        int32_t even1 = (ws[0] - ws[2]) * FIX_0_707106781;
+        int32_t odd0 = ws[1] * FIX_0_923879533 + ws[3] * FIX_0_382683433;
+        int32_t odd1 = ws[1] * FIX_0_382683433 - ws[3] * FIX_0_923879533;
+
+        const int shift = IDCT_CONST_BITS + IDCT_PASS1_BITS + 2;
+        const int32_t round = 1 << (shift - 1);
+        out[0] = clamp_pixel(((even0 + odd0 + round) >> shift) + 128);
+        out[3] = clamp_pixel(((even0 - odd0 + round) >> shift) + 128);
+        out[1] = clamp_pixel(((even1 + odd1 + round) >> shift) + 128);
+        out[2] = clamp_pixel(((even1 - odd1 + round) >> shift) + 128);
+    }
+}
+
+/*
+ * 2x2 inverse dct of the top left 2x2 coefficients (1/4 scale block), the
+ * pixels keep the 8 byte row stride
+ */
+void V4L2JpegDecoder::idct_2x2(const int32_t *coefs, uint8_t *pixels) {
+    int32_t workspace[4];
+    /*pass 1: columns, results scaled up by 2^IDCT_PASS1_BITS (and 2)*/
+    for (int column = 0; column < 2; ++column) {
+        const int32_t *in = coefs + column;
+        int32_t even = in[0] * FIX_0_707106781;
+        int32_t odd = in[8] * FIX_0_707106781;
+
+        const int shift = IDCT_CONST_BITS - IDCT_PASS1_BITS;
+        const int32_t round = 1 << (shift - 1);
+        workspace[column] = (even + odd + round) >> shift;
+        workspace[2 + column] = (even - odd + round) >> shift;
+    }
+
+    /*pass 2: rows, remove the pass 1 scale and the 2x2 dct scale (2 bits)*/
+    for (int row = 0; row < 2; ++row) {
+        const int32_t *ws = workspace + row * 2;
+        uint8_t *out = pixels + row * 8;
+        int32_t even = ws[0] * FIX_0_707106781;
+        int32_t odd = ws[1] * FIX_0_707106781;
+
+        const int shift = IDCT_CONST_BITS + IDCT_PASS1_BITS + 2;
+        const int32_t round = 1 << (shift - 1);
+        out[0] = clamp_pixel(((even + odd + round) >> shift) + 128);
+        out[1] = clamp_pixel(((even - odd + round) >> shift) + 128);
+    }
+}
+
+/*
+ * inverse dct of a dequantized block to size x size pixels (8 byte row
+ * stride), the coefficients past size x size are dropped
+ */
+void V4L2JpegDecoder::transform_block(const int32_t *coefs, int ac_present, int32_t size,
+                                      uint8_t *pixels) {
+    if (size == 8) {
+        idct_block(coefs, ac_present, pixels);
+    } else if (!ac_present || size == 1) {
+        /*the dc alone, 1/8 scale blocks are just their average*/
+        memset(pixels, clamp_pixel(((coefs[0] + 4) >> 3) + 128), 64);
+    } else if (size == 4) {
+        idct_4x4(coefs, pixels);
+    } else {
+        idct_2x2(coefs, pixels);
+    }
+}
+
+/*
+ * store a size x size block at component sample (x, y), averaging it down
+ * to the plane sampling and clipping it to the plane
+ */
+void V4L2JpegDecoder::store_block(const uint8_t *pixels, const Plane &plane, int32_t size,
+                                  int32_t x, int32_t y) {
+    int32_t out_x = x >> plane.h_shift;
+    int32_t out_y = y >> plane.v_shift;
+    int32_t columns = std::min(size >> plane.h_shift, plane.width - out_x);
+    int32_t rows = std::min(size >> plane.v_shift, plane.height - out_y);
+    if (columns <= 0 || rows <= 0) {
+        /*MCU padding*/
+        return;
+    }
+
+    for (int32_t j = 0; j < rows; ++j) {
+        uint8_t *dst = plane.data + (size_t)(out_y + j) * plane.stride + out_x * plane.step;
+        const uint8_t *src = pixels + (j << plane.v_shift) * 8;
+        switch (plane.h_shift | (plane.v_shift << 1)) {
+            case 0:
+                if (plane.step == 1) {
+                    memcpy(dst, src, columns);
+                } else {
+                    for (int32_t i = 0; i < columns; ++i) {
+                        dst[i * plane.step] = src[i];
+                    }
+                }
+                break;
+            case 1:
+                for (int32_t i = 0; i < columns; ++i) {
+                    dst[i * plane.step] = (src[2 * i] + src[2 * i + 1] + 1) >> 1;
+                }
+                break;
+            case 2:
+                for (int32_t i = 0; i < columns; ++i) {
+                    dst[i * plane.step] = (src[i] + src[i + 8] + 1) >> 1;
+                }
+                break;
+            default:
+                for (int32_t i = 0; i < columns; ++i) {
+                    dst[i * plane.step] =
+                        (src[2 * i] + src[2 * i + 1] + src[2 * i + 8] + src[2 * i + 9] + 2) >> 2;
+                }
+                break;
+        }
+    }
+}
+
+/*
+ * point the component planes at the output frame
+ */
+void V4L2JpegDecoder::setup_planes(int width, int height, uint8_t *out, uint32_t out_format) {
+    int32_t chroma_width = (width + 1) / 2;
+    int32_t chroma_height = (height + 1) / 2;
+
+    _planes[0] = {out, width, 1, width, height, 0, 0};
+    uint8_t *chroma = out + (size_t)width * height;
+    for (int i = 1; i < 3; ++i) {
+        Plane &plane = _planes[i];
+        if (out_format == V4L2_PIX_FMT_NV12) {
+            plane.data = chroma + (i - 1);
+            plane.stride = 2 * chroma_width;
+            plane.step = 2;
+        } else {
+            plane.data = chroma + (size_t)(i - 1) * chroma_width * chroma_height;
+            plane.stride = chroma_width;
+            plane.step = 1;
+        }
+        plane.width = chroma_width;
+        plane.height = chroma_height;
+        /*chroma sampled as the luma (4:4:4, 4:2:2 rows, 4:4:0 columns) is averaged*/
+        plane.h_shift = _h_max == 1;
+        plane.v_shift = _v_max == 1;
+        _staged[i] = FALSE;
+    }
+
+    if (_block_size > 1 || _component_count == 1 || (_h_max > 1 && _v_max > 1)) {
+        return;
+    }
+    /*
+     * a 1/8 scale block is half a plane sample: the averaged chroma is
+     * staged at the component sampling and averaged once the scan is done
+     */
+    int32_t mcus_x = (_width + 8 * _h_max - 1) / (8 * _h_max);
+    int32_t mcus_y = (_height + 8 * _v_max - 1) / (8 * _v_max);
+    size_t staging_size = 0;
+    for (int i = 1; i < 3; ++i) {
+        staging_size += (size_t)mcus_x * _components[i].h_samp * mcus_y * _components[i].v_samp;
+    }
+    _staging.resize(staging_size);
+
+    uint8_t *staging = _staging.data();
+    for (int i = 1; i < 3; ++i) {
+        int32_t blocks_x = mcus_x * _components[i].h_samp;
+        int32_t blocks_y = mcus_y * _components[i].v_samp;
+        _staged_planes[i] = _planes[i];
+        _planes[i] = {staging, blocks_x, 1, blocks_x, blocks_y, 0, 0};
+        _staged[i] = TRUE;
+        staging += (size_t)blocks_x * blocks_y;
+    }
+}
+
+/*
+ * average the staged 1/8 scale chroma down to the output planes
+ */
+void V4L2JpegDecoder::finish_staged_planes() {
+    for (int i = 1; i < 3; ++i) {
+        if (!_staged[i]) {
+            continue;
+        }
+        const Plane &src = _planes[i];
+        const Plane &dst = _staged_planes[i];
+        for (int32_t y = 0; y < dst.height; ++y) {
+            int32_t y0 = y << dst.v_shift;
+            int32_t y1 = std::min(y0 + dst.v_shift, src.height - 1);
+            const uint8_t *row0 = src.data + (size_t)y0 * src.stride;
+            const uint8_t *row1 = src.data + (size_t)y1 * src.stride;
+            uint8_t *out = dst.data + (size_t)y * dst.stride;
+            for (int32_t x = 0; x < dst.width; ++x) {
+                int32_t x0 = x << dst.h_shift;
+                int32_t x1 = std::min(x0 + dst.h_shift, src.width - 1);
+                out[x * dst.step] = (row0[x0] + row0[x1] + row1[x0] + row1[x1] + 2) >> 2;
+            }
+        }
+    }
+}
+
+/*
+ * decode restart intervals [first, last) of the unstuffed scan into the planes
+ * returns: error code (E_OK, E_DECODE_ERR or E_NO_EOI_ERR if the data ran out)
+ */
+int V4L2JpegDecoder::decode_intervals(const uint8_t *data, size_t size, int32_t first,
+                                      int32_t last) {
+    int32_t coefs[64];
+    uint8_t pixels[64];
+    for (int32_t interval = first; interval < last; ++interval) {
+        if ((size_t)interval >= _segments.size()) {
+            /*restart marker missing, the frame was cut*/
+            return E_NO_EOI_ERR;
+        }
+        size_t begin = _segments[interval];
+        size_t end = (size_t)interval + 1 < _segments.size() ? _segments[interval + 1] : size;
+        JpegBitReader reader = {data + begin, end - begin, 0, 0, 0, 0};
+        int32_t dc_pred[3] = {0, 0, 0};
+
+        int32_t mcu_end = std::min((interval + 1) * _interval_mcus, _mcus);
+        for (int32_t mcu = interval * _interval_mcus; mcu < mcu_end; ++mcu) {
+            int32_t mcu_x = mcu % _mcus_x;
+            int32_t mcu_y = mcu / _mcus_x;
+            for (int32_t c = 0; c < _scan_components; ++c) {
+                int index = _scan_order[c];
+                const JpegComponent &component = _components[index];
+                for (int32_t v = 0; v < component.v_samp; ++v) {
+                    for (int32_t h = 0; h < component.h_samp; ++h) {
+                        int ret = decode_block(reader, component, &dc_pred[c], coefs);
+                        if (ret < 0) {
+                            return ret;
+                        }
+                        transform_block(coefs, ret, _block_size, pixels);
+                        store_block(pixels, _planes[index], _block_size,
+                                    (mcu_x * component.h_samp + h) * _block_size,
+                                    (mcu_y * component.v_samp + v) * _block_size);
+                    }
+                }
+            }
+        }
+
+        if (bits_overrun(reader)) {
+            /*the last interval runs out with the data, the others into the next marker*/
+            return interval + 1 == _intervals ? E_NO_EOI_ERR : E_DECODE_ERR;
+        }
+    }
+    return E_OK;
+}
+
+/*
+ * decode the pending chunks of the current job (caller and slice threads)
+ */
+void V4L2JpegDecoder::run_chunks() {
+    for (;;) {
+        int32_t chunk = _next_chunk.fetch_add(1);
+        if (chunk >= (int32_t)_chunk_results.size()) {
+            return;
+        }
+        int32_t first = chunk * _chunk_intervals;
+        int32_t last = std::min(first + _chunk_intervals, _intervals);
+        _chunk_results[chunk] = decode_intervals(_scan_data, _scan_size, first, last);
+    }
+}
+
+void V4L2JpegDecoder::slice_thread_loop(uint64_t done_job) {
+    std::unique_lock<std::mutex> lock(_slice_mutex);
+    for (;;) {
+        _slice_start.wait(lock, [&] { return _slice_stop || _slice_job != done_job; });
+        if (_slice_stop) {
+            return;
+        }
+        done_job = _slice_job;
+
+        lock.unlock();
+        run_chunks();
+        lock.lock();
+        if (--_slice_busy == 0) {
+            _slice_done.notify_one();
+        }
+    }
+}
+
+void V4L2JpegDecoder::stop_slice_threads() {
+    {
+        std::lock_guard<std::mutex> lock(_slice_mutex);
+        _slice_stop = true;
+    }
+    _slice_start.notify_all();
+    for (std::thread &thread : _slice_threads) {
+        thread.join();
+    }
+    _slice_threads.clear();
+    _slice_stop = false;
+}
+
+void V4L2JpegDecoder::set_threads(int threads) {
+    stop_slice_threads();
+    _threads = std::max(threads, 1);
+    /*taken here: the next decode may arm a job before a new thread first locks*/
+    for (int i = 1; i < _threads; ++i) {
+        _slice_threads.emplace_back(&V4L2JpegDecoder::slice_thread_loop, this, _slice_job);
+    }
+}
+
+/*
+ * decode the MCUs of the unstuffed scan into the planes, the restart
+ * intervals are spread over the slice threads when there are several
+ * returns: error code (E_OK, E_DECODE_ERR or E_NO_EOI_ERR if the data ran out)
+ */
+int V4L2JpegDecoder::decode_scan(const uint8_t *data, size_t size) {
+    int32_t mcu_width = 8 * _h_max;
+    int32_t mcu_height = 8 * _v_max;
+    if (_component_count == 1) {
+        mcu_width = 8;
+        mcu_height = 8;
+    }
+    _mcus_x = (_width + mcu_width - 1) / mcu_width;
+    _mcus = _mcus_x * ((_height + mcu_height - 1) / mcu_height);
+    _interval_mcus = _restart_interval > 0 ? _restart_interval : _mcus;
+    _intervals = (_mcus + _interval_mcus - 1) / _interval_mcus;
+
+    if (_slice_threads.empty() || _intervals < 2) {
+        return decode_intervals(data, size, 0, _intervals);
+    }
+
+    /*a few chunks per thread even out intervals of uneven cost*/
+    int32_t chunks = std::min(_intervals, SLICE_CHUNKS_PER_THREAD * _threads);
+    _chunk_intervals = (_intervals + chunks - 1) / chunks;
+    _chunk_results.assign((_intervals + _chunk_intervals - 1) / _chunk_intervals, E_OK);
+    _scan_data = data;
+    _scan_size = size;
+    _next_chunk = 0;
+    {
+        std::lock_guard<std::mutex> lock(_slice_mutex);
+        _slice_busy = _slice_threads.size();
+        _slice_job++;
+    }
+    _slice_start.notify_all();
+
+    run_chunks();
+    {
+        std::unique_lock<std::mutex> lock(_slice_mutex);
+        _slice_done.wait(lock, [&] { return _slice_busy == 0; });
+    }
+
+    /*the first failing chunk is the error a serial decode stops at*/
+    for (int ret : _chunk_results) {
+        if (ret != E_OK) {
+            return ret;
+        }
+    }
+    return E_OK;
+}
+
+int V4L2JpegDecoder::decode(const uint8_t *data, size_t size, int width, int height,
+                            uint8_t *out, uint32_t out_format, uint8_t *scratch,
+                            size_t scratch_length) {
+    return decode_scaled(data, size, width, height, 1, out, out_format, scratch, scratch_length);
+}
+
+int V4L2JpegDecoder::decode_scaled(const uint8_t *data, size_t size, int width, int height,
+                                   int scale, uint8_t *out, uint32_t out_format,
+                                   uint8_t *scratch, size_t scratch_length) {
+    if (out_format != V4L2_PIX_FMT_YUV420 && out_format != V4L2_PIX_FMT_NV12) {
+        return E_FORMAT_ERR;
+    }
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8) {
+        return E_FORMAT_ERR;
+    }
+
+    size_t scan_offset = 0;
+    int ret = parse_header(data, size, &scan_offset);
+    if (ret != E_OK) {
+        return ret;
+    }
+    if (_width != width || _height != height) {
+        base::LogError() << "V4L2_JPEG: frame is " << _width << "x" << _height << ", expected "
+                         << width << "x" << height;
+        return E_BAD_WIDTH_OR_HEIGHT_ERR;
+    }
+    if (scratch_length < get_scratch_size(size - scan_offset)) {
+        return E_ALLOC_ERR;
+    }
+
+    int eoi_found = FALSE;
+    size_t scan_size = unstuff_scan(data + scan_offset, size - scan_offset, scratch, &eoi_found);
+
+    /*the planes are laid out at the output size, the blocks shrink to match*/
+    width = get_scaled_size(width, scale);
+    height = get_scaled_size(height, scale);
+    _block_size = 8 / scale;
+    _last_coef = last_coef[scale >> 1];
+    setup_planes(width, height, out, out_format);
+    if (_component_count == 1) {
+        /*grey: neutral chroma*/
+        memset(out + (size_t)width * height, 128,
+               2 * (size_t)((width + 1) / 2) * ((height + 1) / 2));
+    }
+
+    ret = decode_scan(scratch, scan_size);
+    finish_staged_planes();
+    if (ret == E_NO_EOI_ERR && eoi_found) {
+        /*complete frame with too little entropy coded data*/
+        ret = E_DECODE_ERR;
+    }
+    return ret;
+}
+
+}  // namespace uvc
\ No newline at end of file
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace uvc {
+
+#define JPEG_FAST_BITS 9  //huffman codes up to this length are decoded with one lookup
+
+/*
+ * derived huffman table (JPEG Annex C)
+ */
+struct JpegHuffTable {
+    uint8_t fast_length[1 << JPEG_FAST_BITS];  //code length of a JPEG_FAST_BITS prefix (0 - longer)
+    uint8_t fast_symbol[1 << JPEG_FAST_BITS];  //symbol of a JPEG_FAST_BITS prefix
+    int32_t max_code[18];                      //largest code of each length (-1 - none)
+    int32_t value_offset[17];                  //symbol index minus first code of each length
+    uint8_t symbols[256];                      //symbols in code order
+};
+
+/*
+ * bit reader over unstuffed entropy coded data
+ */
+struct JpegBitReader {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+    uint64_t bits;   //left aligned bit buffer
+    int32_t count;   //valid bits in the buffer
+    size_t overrun;  //zero bytes fed past the end of the data
+};
+
+/*
+ * image component (SOF and SOS)
+ */
+struct JpegComponent {
+    uint8_t id;           //component id
+    uint8_t h_samp;       //horizontal sampling factor
+    uint8_t v_samp;       //vertical sampling factor
+    uint8_t quant_table;  //quantization table index
+    uint8_t dc_table;     //dc huffman table index
+    uint8_t ac_table;     //ac huffman table index
+    int32_t width;        //component width (samples)
+    int32_t height;       //component height (samples)
+};
+
+/*
+ * baseline (sequential huffman, 8 bit) jpeg decoder for MJPEG frames
+ *
+ * decodes grey and YCbCr 4:4:4, 4:2:2, 4:2:0 and 4:4:0 frames straight
+ * into I420 or NV12, the chroma is averaged down to 4:2:0 while storing
+ * the blocks; frames without DHT (most UVC cameras) get the standard
+ * huffman tables of JPEG Annex K.3
+ *
+ * one decoder per thread, the tables are kept between frames; with
+ * set_threads the restart intervals (DRI/RSTn) of a frame are decoded in
+ * parallel, frames without restart markers are decoded serially;
+ * decode_scaled makes 1/2, 1/4 and 1/8 size frames in the dct domain,
+ * transforming only the low frequency coefficients of each block
+ */
+class V4L2JpegDecoder final {
+public:
+    V4L2JpegDecoder();
+    ~V4L2JpegDecoder();
+
+    V4L2JpegDecoder(const V4L2JpegDecoder &) = delete;
+    void operator=(const V4L2JpegDecoder &) = delete;
+    /*
+    * decode the restart intervals of a frame on up to threads threads, the
+    * caller included (1 - serial, the default)
+    */
+    void set_threads(int threads);
+    /*
+    * scratch bytes needed to decode a frame of size bytes
+    */
+    static size_t get_scratch_size(size_t size) { return size; }
+    /*
+    * decode a frame to V4L2_PIX_FMT_YUV420 (I420) or V4L2_PIX_FMT_NV12
+    * (width x height must match the frame, scratch holds the unstuffed
+    * entropy coded data, get_scratch_size(size) bytes)
+    * returns: error code (E_OK, E_NO_SOI_ERR, E_BAD_TABLES_ERR, ...)
+    */
+    int decode(const uint8_t *data, size_t size, int width, int height, uint8_t *out,
+               uint32_t out_format, uint8_t *scratch, size_t scratch_length);
+    /*
+    * size of a frame dimension decoded at 1/scale
+    */
+    static int get_scaled_size(int size, int scale) { return (size + scale - 1) / scale; }
+    /*
+    * decode a frame at 1/scale (1, 2, 4 or 8) of width x height, out holds
+    * get_scaled_size(width, scale) x get_scaled_size(height, scale)
+    * returns: error code (E_OK, E_FORMAT_ERR for other scales, as decode)
+    */
+    int decode_scaled(const uint8_t *data, size_t size, int width, int height, int scale,
+                      uint8_t *out, uint32_t out_format, uint8_t *scratch, size_t scratch_length);
+private:
+    /*
+    * output plane of one component
+    */
+    struct Plane {
+        uint8_t *data;
+        int32_t stride;   //line stride (bytes)
+        int32_t step;     //distance between samples (1 - planar, 2 - NV12 chroma)
+        int32_t width;    //plane width (samples)
+        int32_t height;   //plane height (samples)
+        uint8_t h_shift;  //average 2 samples horizontally (component wider than the plane)
+        uint8_t v_shift;  //average 2 samples vertically (component taller than the plane)
+    };
+
+    int parse_header(const uint8_t *data, size_t size, size_t *scan_offset);
+    int parse_sof(const uint8_t *segment, uint32_t length);
+    int parse_dht(const uint8_t *segment, uint32_t length);
+    int parse_dqt(const uint8_t *segment, uint32_t length);
+    int parse_sos(const uint8_t *segment, uint32_t length);
+    /*
+    * remove the 0xFF00 stuffing and the restart markers from the scan
+    * returns: size of the unstuffed data (bytes)
+    */
+    size_t unstuff_scan(const uint8_t *data, size_t size, uint8_t *scratch, int *eoi_found);
+    void setup_planes(int width, int height, uint8_t *out, uint32_t out_format);
+    void finish_staged_planes();
+    int decode_scan(const uint8_t *data, size_t size);
+    int decode_intervals(const uint8_t *data, size_t size, int32_t first, int32_t last);
+    void run_chunks();
+    void slice_thread_loop(uint64_t done_job);
+    void stop_slice_threads();
+    int decode_block(JpegBitReader &reader, const JpegComponent &component, int32_t *dc_pred,
+                     int32_t *coefs);
+
+    void load_default_huff_table(int table_class, int index);
+
+    static int build_huff_table(const uint8_t *bits, const uint8_t *symbols, JpegHuffTable *table);
+    static void idct_block(const int32_t *coefs, int ac_present, uint8_t *pixels);
+    static void idct_4x4(const int32_t *coefs, uint8_t *pixels);
+    static void idct_2x2(const int32_t *coefs, uint8_t *pixels);
+    static void transform_block(const int32_t *coefs, int ac_present, int32_t size,
+                                uint8_t *pixels);
+    static void store_block(const uint8_t *pixels, const Plane &plane, int32_t size, int32_t x,
+                            int32_t y);
+private:
+    JpegHuffTable _huff_tables[2][4];  //[dc, ac][table index]
+    uint8_t _huff_defined[2][4];
+    uint16_t _quant_tables[4][64];  //quantization tables (zigzag order)
+    uint8_t _quant_defined[4];
+
+    int32_t _width;
+    int32_t _height;
+    int32_t _component_count;
+    JpegComponent _components[3];
+    int32_t _scan_components;  //components in the scan
+    uint8_t _scan_order[3];    //scan component -> _components index
+    uint8_t _h_max;
+    uint8_t _v_max;
+    int32_t _restart_interval;      //MCUs between restart markers (0 - none)
+    std::vector<size_t> _segments;  //unstuffed offset of each restart interval
+    Plane _planes[3];
+
+    int32_t _mcus_x;         //MCUs per row
+    int32_t _mcus;           //MCUs in the frame
+    int32_t _interval_mcus;  //MCUs per restart interval (all of them without DRI)
+    int32_t _intervals;      //restart intervals in the frame
+    int32_t _block_size;     //decoded block size (8 / scale)
+    int32_t _last_coef;      //last zigzag coefficient the block transform reads
+
+    std::vector<uint8_t> _staging;  //1/8 scale chroma at the component sampling
+    Plane _staged_planes[3];        //output planes of the staged components
+    uint8_t _staged[3];             //component is staged (1/8 scale, averaged chroma)
+
+    int _threads;                             //decode threads (set_threads)
+    std::vector<std::thread> _slice_threads;  //helpers of the decoding thread
+    std::mutex _slice_mutex;                  //protects the job and busy count
+    std::condition_variable _slice_start;     //new job or stop
+    std::condition_variable _slice_done;      //every helper finished the job
+    uint64_t _slice_job;                      //current job number
+    size_t _slice_busy;                       //helpers still on the current job
+    bool _slice_stop;                         //helpers exit when set
+    const uint8_t *_scan_data;                //unstuffed scan of the current job
+    size_t _scan_size;                        //unstuffed scan size (bytes)
+    int32_t _chunk_intervals;                 //restart intervals per chunk
+    std::atomic<int32_t> _next_chunk;         //next chunk to decode
+    std::vector<int> _chunk_results;          //error code of each chunk
+};
+
+}  // namespace uvc
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "v4l2_latency.h"
+
+namespace uvc {
+
+V4L2LatencyHistogram::V4L2LatencyHistogram() {
+    reset();
+}
+
+/*
+ * values below LATENCY_SUB_BUCKETS get a bucket each, larger values share
+ * LATENCY_SUB_BUCKETS buckets per power of two
+ */
+uint32_t V4L2LatencyHistogram::bucket_index(uint64_t value) {
+    if (value < LATENCY_SUB_BUCKETS) {
+        return value;
+    }
+
+    uint32_t msb = 63 - __builtin_clzll(value);
+    if (msb >= LATENCY_MAX_BITS) {
+        return LATENCY_BUCKETS - 1;
+    }
+    uint32_t shift = msb - LATENCY_SUB_BITS;
+    uint32_t sub_bucket = (value >> shift) - LATENCY_SUB_BUCKETS;
+    return (shift + 1) * LATENCY_SUB_BUCKETS + sub_bucket;
+}
+
+/*
+ * upper bound of the values that fall in a bucket
+ */
+uint64_t V4L2LatencyHistogram::bucket_value(uint32_t index) {
+    if (index < LATENCY_SUB_BUCKETS) {
+        return index;
+    }
+
+    uint32_t shift = index / LATENCY_SUB_BUCKETS - 1;
+    uint64_t sub_bucket = index % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS;
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+void V4L2LatencyHistogram::record(uint64_t value) {
+    _buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t max = _max.load(std::memory_order_relaxed);
+    while (value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t V4L2LatencyHistogram::value_at_percentile(double percentile) const {
+    uint64_t count = get_count();
+    if (count == 0) {
+        return 0;
+    }
+
+    if (percentile < 0) {
+        percentile = 0;
+    } else if (percentile > 100) {
+        percentile = 100;
+    }
+
+    uint64_t target = (uint64_t)(percentile / 100.0 * count + 0.5);
+    if (target == 0) {
+        target = 1;
+    }
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += _buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            uint64_t value = bucket_value(i);
+            return value < get_max() ? value : get_max();
+        }
+    }
+    return get_max();
+}
+
+uint64_t V4L2LatencyHistogram::get_mean() const {
+    uint64_t count = get_count();
+    return count ? _sum.load(std::memory_order_relaxed) / count : 0;
+}
+
+void V4L2LatencyHistogram::reset() {
+    for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+        _buckets[i].store(0, std::memory_order_relaxed);
+    }
+    _count.store(0, std::memory_order_relaxed);
+    _sum.store(0, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace uvc
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+namespace uvc {
+
+/*
+ * latency stages recorded for every frame
+ */
+#define LATENCY_DRIVER_TO_DEQUEUE 0   //driver timestamp -> VIDIOC_DQBUF returned
+#define LATENCY_DEQUEUE_TO_RELEASE 1  //VIDIOC_DQBUF returned -> last lease released
+#define LATENCY_DRIVER_TO_RELEASE 2   //driver timestamp -> last lease released
+#define LATENCY_STAGES 3
+
+/*
+ * histogram resolution: 2^LATENCY_SUB_BITS buckets per power of two (~6% error)
+ */
+#define LATENCY_SUB_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+#define LATENCY_MAX_BITS 40  //values up to 2^40 ns (~18 minutes)
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+/*
+ * fixed bucket log-linear (HDR style) histogram of nanosecond values
+ *
+ * record() is lock-free and may run concurrently with the queries,
+ * queries see a consistent enough snapshot for monitoring
+ */
+class V4L2LatencyHistogram final {
+public:
+    V4L2LatencyHistogram();
+
+    V4L2LatencyHistogram(const V4L2LatencyHistogram &) = delete;
+    void operator=(const V4L2LatencyHistogram &) = delete;
+    /*
+    * add a value (ns)
+    */
+    void record(uint64_t value);
+    /*
+    * value (ns) below which the given percentage (0-100) of the values fall
+    */
+    uint64_t value_at_percentile(double percentile) const;
+    uint64_t get_count() const { return _count.load(std::memory_order_relaxed); };
+    uint64_t get_max() const { return _max.load(std::memory_order_relaxed); };
+    /*
+    * mean value (ns)
+    */
+    uint64_t get_mean() const;
+    /*
+    * clear all values (not atomic with respect to concurrent record calls)
+    */
+    void reset();
+private:
+    static uint32_t bucket_index(uint64_t value);
+    static uint64_t bucket_value(uint32_t index);
+private:
+    std::atomic<uint64_t> _buckets[LATENCY_BUCKETS];
+    std::atomic<uint64_t> _count;
+    std::atomic<uint64_t> _sum;
+    std::atomic<uint64_t> _max;
+};
+
+}  // namespace uvc
\ No newline at end of file
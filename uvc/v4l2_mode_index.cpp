@@ -0,0 +1,203 @@
+#include "v4l2_mode_index.h"
+
+#include <base/log.h>
+#include <math.h>
+
+#include <algorithm>
+#include <numeric>
+
+#include "v4l2_define.h"
+#include "v4l2_format.h"
+
+namespace uvc {
+
+void V4L2ModeIndex::sort_intervals(V4l2StreamCapability &stream_cap) {
+    std::sort(stream_cap.framerates.begin(), stream_cap.framerates.end(),
+              [](const V4L2Rational &a, const V4L2Rational &b) {
+                  return compare_interval(a, b) < 0;
+              });
+}
+
+void V4L2ModeIndex::build(const std::vector<V4L2StreamFormat> &stream_formats) {
+    _formats.clear();
+    _formats.reserve(stream_formats.size());
+
+    for (size_t i = 0; i < stream_formats.size(); i++) {
+        const V4L2StreamFormat &stream_format = stream_formats[i];
+
+        FormatEntry format;
+        format.pixel_format = stream_format.pixel_format;
+        format.dec_support = stream_format.dec_support;
+        format.caps = stream_format.list_stream_cap;
+
+        for (size_t j = 0; j < format.caps.size(); j++) {
+            V4l2StreamCapability &stream_cap = format.caps[j];
+            sort_intervals(stream_cap);
+
+            if (stream_cap.size_type == V4L2_FRMSIZE_TYPE_DISCRETE) {
+                SizeEntry size;
+                size.width = stream_cap.width;
+                size.height = stream_cap.height;
+                size.cap_index = j;
+                format.sizes.push_back(size);
+            } else {
+                format.ranges.push_back(j);
+            }
+        }
+
+        std::sort(format.sizes.begin(), format.sizes.end(),
+                  [](const SizeEntry &a, const SizeEntry &b) {
+                      return a.width != b.width ? a.width < b.width : a.height < b.height;
+                  });
+        _formats.push_back(std::move(format));
+    }
+
+    std::sort(_formats.begin(), _formats.end(), [](const FormatEntry &a, const FormatEntry &b) {
+        return a.pixel_format < b.pixel_format;
+    });
+}
+
+V4L2Rational V4L2ModeIndex::pick_interval(const V4l2StreamCapability &stream_cap, double fps) {
+    if (stream_cap.interval_type != V4L2_FRMIVAL_TYPE_DISCRETE) {
+        if (fps <= 0) {
+            return stream_cap.min_interval;
+        }
+        /*the driver rounds to the closest interval of the range on S_PARM*/
+        int32_t denominator = std::max((int32_t)lround(fps * 1000), 1);
+        int32_t divisor = std::gcd(1000, denominator);
+        V4L2Rational interval = {1000 / divisor, denominator / divisor};
+        if (compare_interval(interval, stream_cap.min_interval) < 0) {
+            return stream_cap.min_interval;
+        }
+        if (compare_interval(interval, stream_cap.max_interval) > 0) {
+            return stream_cap.max_interval;
+        }
+        return interval;
+    }
+
+    const std::vector<V4L2Rational> &intervals = stream_cap.framerates;
+    if (intervals.empty()) {
+        return {0, 0};
+    }
+    if (fps <= 0) {
+        return intervals[0];
+    }
+
+    /*intervals are sorted shortest first, so the frame rate goes down along the list*/
+    auto it = std::partition_point(intervals.begin(), intervals.end(),
+                                   [fps](const V4L2Rational &interval) {
+                                       return interval.denominator >= fps * interval.numerator;
+                                   });
+    return it == intervals.begin() ? intervals[0] : *(it - 1);
+}
+
+bool V4L2ModeIndex::find_format_mode(const FormatEntry &format, int32_t width, int32_t height,
+                                     double fps, V4L2StreamMode *mode,
+                                     const V4l2StreamCapability **stream_cap) const {
+    /*smallest discrete size covering the target: lowest height reaching it in each width*/
+    const SizeEntry *best = NULL;
+    int64_t best_area = 0;
+    auto it = std::lower_bound(
+        format.sizes.begin(), format.sizes.end(), width,
+        [](const SizeEntry &size, int32_t value) { return size.width < value; });
+    while (it != format.sizes.end()) {
+        /*the sizes of every wider width are at least it->width x height*/
+        if (best != NULL && (int64_t)it->width * height >= best_area) {
+            break;
+        }
+        auto width_end = std::upper_bound(
+            it, format.sizes.end(), it->width,
+            [](int32_t value, const SizeEntry &size) { return value < size.width; });
+        auto size = std::lower_bound(
+            it, width_end, height,
+            [](const SizeEntry &entry, int32_t value) { return entry.height < value; });
+        if (size != width_end) {
+            int64_t area = (int64_t)size->width * size->height;
+            if (best == NULL || area < best_area) {
+                best = &*size;
+                best_area = area;
+            }
+        }
+        it = width_end;
+    }
+
+    bool found = best != NULL;
+    if (found) {
+        mode->pixel_format = format.pixel_format;
+        mode->width = best->width;
+        mode->height = best->height;
+        mode->frame_interval = pick_interval(format.caps[best->cap_index], fps);
+        if (stream_cap != NULL) {
+            *stream_cap = &format.caps[best->cap_index];
+        }
+    }
+
+    for (size_t i = 0; i < format.ranges.size(); i++) {
+        const V4l2StreamCapability &range_cap = format.caps[format.ranges[i]];
+        int32_t fit_width = 0;
+        int32_t fit_height = 0;
+        if (!fit_frame_size(range_cap, width, height, &fit_width, &fit_height)) {
+            continue;
+        }
+        if (found && (int64_t)fit_width * fit_height >= (int64_t)mode->width * mode->height) {
+            continue;
+        }
+        mode->pixel_format = format.pixel_format;
+        mode->width = fit_width;
+        mode->height = fit_height;
+        mode->frame_interval = pick_interval(range_cap, fps);
+        if (stream_cap != NULL) {
+            *stream_cap = &range_cap;
+        }
+        found = true;
+    }
+
+    return found;
+}
+
+int V4L2ModeIndex::find_mode(int pixelformat, int32_t width, int32_t height, double fps,
+                             V4L2StreamMode *mode, const V4l2StreamCapability **stream_cap) const {
+    if (pixelformat != 0) {
+        auto it = std::lower_bound(
+            _formats.begin(), _formats.end(), pixelformat,
+            [](const FormatEntry &format, int value) { return format.pixel_format < value; });
+        if (it != _formats.end() && it->pixel_format == pixelformat &&
+            find_format_mode(*it, width, height, fps, mode, stream_cap)) {
+            return E_OK;
+        }
+        base::LogDebug() << "V4L2_CORE: no mode for format " << pixelformat << " at or above "
+                         << width << "x" << height;
+        return E_FORMAT_ERR;
+    }
+
+    /*any decodable format: the smallest frame wins, then the shorter interval*/
+    bool found = false;
+    for (size_t i = 0; i < _formats.size(); i++) {
+        V4L2StreamMode candidate;
+        const V4l2StreamCapability *candidate_cap = NULL;
+        if (!_formats[i].dec_support ||
+            !find_format_mode(_formats[i], width, height, fps, &candidate, &candidate_cap)) {
+            continue;
+        }
+
+        int64_t candidate_area = (int64_t)candidate.width * candidate.height;
+        int64_t mode_area = found ? (int64_t)mode->width * mode->height : 0;
+        if (!found || candidate_area < mode_area ||
+            (candidate_area == mode_area &&
+             compare_interval(candidate.frame_interval, mode->frame_interval) < 0)) {
+            *mode = candidate;
+            if (stream_cap != NULL) {
+                *stream_cap = candidate_cap;
+            }
+            found = true;
+        }
+    }
+
+    if (!found) {
+        base::LogDebug() << "V4L2_CORE: no mode at or above " << width << "x" << height;
+        return E_FORMAT_ERR;
+    }
+    return E_OK;
+}
+
+}  // namespace uvc
\ No newline at end of file
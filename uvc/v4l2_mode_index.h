@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+#include "v4l2_context.h"
+
+namespace uvc {
+
+/*
+ * lookup index over the enumerated stream formats
+ *
+ * formats are sorted by pixel format and their discrete sizes by width,
+ * then height, each size keeps its frame intervals sorted shortest first;
+ * a query binary searches the height in each width at or above the target
+ * and stops at the first width that can't beat the best area found, instead
+ * of a walk over the nested lists; size ranges (stepwise/continuous) are
+ * few and solved directly
+ */
+class V4L2ModeIndex final {
+public:
+    V4L2ModeIndex() = default;
+
+    V4L2ModeIndex(const V4L2ModeIndex &) = delete;
+    void operator=(const V4L2ModeIndex &) = delete;
+    /*
+    * (re)build the index from the enumerated formats
+    */
+    void build(const std::vector<V4L2StreamFormat> &stream_formats);
+    /*
+    * find the best mode for a format near a target
+    * args:
+    *   pixelformat - v4l2 pixel format (0 - any format supported by the decoder)
+    *   width - minimum frame width
+    *   height - minimum frame height
+    *   fps - wanted frame rate (0 - fastest)
+    *   mode - pointer to the returned mode
+    *   stream_cap - pointer to the returned capability of the mode (NULL - not needed)
+    *
+    * notes:
+    *   picks the smallest size at or above width x height, then the slowest
+    *   interval that still reaches fps (the fastest one if none does); a
+    *   size range only holds the intervals of its largest size, the caller
+    *   may query the ones of the picked size and pick again
+    *
+    * returns: error code (E_OK or E_FORMAT_ERR if no mode matches)
+    */
+    int find_mode(int pixelformat, int32_t width, int32_t height, double fps,
+                  V4L2StreamMode *mode, const V4l2StreamCapability **stream_cap = NULL) const;
+    /*
+    * sort the discrete intervals of a capability shortest first
+    */
+    static void sort_intervals(V4l2StreamCapability &stream_cap);
+    /*
+    * slowest interval of a capability that still reaches fps (the fastest if none does)
+    */
+    static V4L2Rational pick_interval(const V4l2StreamCapability &stream_cap, double fps);
+private:
+    struct SizeEntry {
+        int32_t width;
+        int32_t height;
+        size_t cap_index;  //index in FormatEntry::caps
+    };
+    struct FormatEntry {
+        int pixel_format;
+        uint8_t dec_support;
+        std::vector<V4l2StreamCapability> caps;  //capabilities, discrete intervals shortest first
+        std::vector<SizeEntry> sizes;            //discrete sizes by width, then height
+        std::vector<size_t> ranges;              //stepwise/continuous sizes (index in caps)
+    };
+private:
+    bool find_format_mode(const FormatEntry &format, int32_t width, int32_t height, double fps,
+                          V4L2StreamMode *mode, const V4l2StreamCapability **stream_cap) const;
+private:
+    std::vector<FormatEntry> _formats;  //sorted by pixel format
+};
+
+}  // namespace uvc
\ No newline at end of file
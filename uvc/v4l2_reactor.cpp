@@ -0,0 +1,198 @@
+#include "v4l2_reactor.h"
+
+#include <base/log.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "v4l2_core.h"
+#include "v4l2_define.h"
+
+namespace uvc {
+
+/*
+ * max number of epoll events handled per wakeup
+ */
+#define REACTOR_MAX_EVENTS 32
+
+V4l2Reactor::V4l2Reactor() : _running(true) {
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epoll_fd < 0) {
+        base::LogError() << "epoll_create1 failed: " << strerror(errno);
+    }
+
+    _wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (_wake_fd < 0) {
+        base::LogError() << "eventfd failed: " << strerror(errno);
+    } else if (_epoll_fd >= 0) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = _wake_fd;
+        epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wake_fd, &event);
+    }
+}
+
+V4l2Reactor::~V4l2Reactor() {
+    if (_wake_fd >= 0) {
+        close(_wake_fd);
+    }
+    if (_epoll_fd >= 0) {
+        close(_epoll_fd);
+    }
+}
+
+int V4l2Reactor::add_context(V4L2Context *context, const V4L2FrameCallback &callback) {
+    if (_epoll_fd < 0) {
+        return E_DEVICE_ERR;
+    }
+    if (context->streaming != STRM_OK) {
+        base::LogError() << "Reactor: stream of " << context->videodevice << " is not on";
+        return E_NO_STREAM_ERR;
+    }
+    if (_sources.count(context->fd) != 0) {
+        base::LogWarn() << "Reactor: " << context->videodevice << " already added";
+        return E_OK;
+    }
+    /*one dequeuer per stream: the capture thread and decode pool also take frames*/
+    if (context->capture_thread.joinable() || context->decode_pool != NULL) {
+        base::LogError() << "Reactor: a capture thread or decode pool owns the stream of "
+                         << context->videodevice;
+        return E_BUSY_ERR;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;  // level triggered: one dequeue per ready event
+    event.data.fd = context->fd;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, context->fd, &event) < 0) {
+        base::LogError() << "Reactor: couldn't watch " << context->videodevice << ": "
+                         << strerror(errno);
+        return E_DEVICE_ERR;
+    }
+
+    _sources[context->fd] = std::make_shared<Source>(Source{context, callback});
+    context->reactor_watched = 1;
+    return E_OK;
+}
+
+int V4l2Reactor::remove_context(V4L2Context *context) {
+    auto it = _sources.find(context->fd);
+    if (it == _sources.end()) {
+        return E_OK;
+    }
+
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, context->fd, NULL);
+    _sources.erase(it);
+    context->reactor_watched = 0;
+    return E_OK;
+}
+
+int V4l2Reactor::watch_device_list(V4l2Device *device, const V4L2DeviceListCallback &callback) {
+    if (_epoll_fd < 0 || device->get_udev_fd() < 0) {
+        base::LogError() << "Reactor: no udev monitor to watch";
+        return E_DEVICE_ERR;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = device->get_udev_fd();
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, device->get_udev_fd(), &event) < 0) {
+        base::LogError() << "Reactor: couldn't watch udev monitor: " << strerror(errno);
+        return E_DEVICE_ERR;
+    }
+
+    _device = device;
+    _device_list_callback = callback;
+    return E_OK;
+}
+
+int V4l2Reactor::run_once(int timeout_ms) {
+    if (_epoll_fd < 0) {
+        return E_DEVICE_ERR;
+    }
+
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    int count = epoll_wait(_epoll_fd, events, REACTOR_MAX_EVENTS, timeout_ms);
+    if (count < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        base::LogError() << "Reactor: epoll_wait failed: " << strerror(errno);
+        return E_SELECT_ERR;
+    }
+
+    int frames = 0;
+    for (int i = 0; i < count; i++) {
+        int fd = events[i].data.fd;
+
+        if (fd == _wake_fd) {
+            uint64_t value;
+            if (read(_wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+                base::LogError() << "Reactor: wake read failed: " << strerror(errno);
+            }
+            continue;
+        }
+
+        if (_device != NULL && fd == _device->get_udev_fd()) {
+            if (_device->check_device_list_events() && _device_list_callback) {
+                _device_list_callback(_device);
+            }
+            continue;
+        }
+
+        /*the source may have been removed by a callback earlier in this batch*/
+        auto it = _sources.find(fd);
+        if (it == _sources.end()) {
+            continue;
+        }
+        /*keep the source alive even if its callback removes it*/
+        std::shared_ptr<Source> source = it->second;
+        V4L2Context *context = source->context;
+
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+            base::LogError() << "Reactor: device error on " << context->videodevice
+                             << ", removing it";
+            remove_context(context);
+            source->callback(context, NULL);
+            continue;
+        }
+
+        V4L2FrameBuff *frame = NULL;
+        int ret = v4l2core_dequeue_frame(context, &frame);
+        if (ret == E_NO_DATA) {
+            continue;
+        } else if (ret != E_OK) {
+            base::LogError() << "Reactor: dequeue failed on " << context->videodevice << ": "
+                             << ret;
+            continue;
+        }
+
+        source->callback(context, frame);
+        v4l2core_release_frame(context, frame);
+        frames++;
+    }
+
+    return frames;
+}
+
+void V4l2Reactor::run() {
+    /*a stop() that came before run() is not lost, run() returns at once*/
+    while (_running) {
+        if (run_once(-1) < 0) {
+            break;
+        }
+    }
+}
+
+void V4l2Reactor::stop() {
+    _running = false;
+    uint64_t value = 1;
+    if (_wake_fd >= 0 && write(_wake_fd, &value, sizeof(value)) < 0) {
+        base::LogError() << "Reactor: wake write failed: " << strerror(errno);
+    }
+}
+
+}  // namespace uvc
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+#include "v4l2_context.h"
+#include "v4l2_device.h"
+
+namespace uvc {
+
+/*
+ * frame callback: frame is only valid during the call (take a lease with
+ * v4l2core_frame_ref to keep it), frame is NULL when the device failed and
+ * was removed from the reactor
+ */
+using V4L2FrameCallback = std::function<void(V4L2Context *context, V4L2FrameBuff *frame)>;
+
+/*
+ * device list callback: called after a udev event updated the device list
+ */
+using V4L2DeviceListCallback = std::function<void(V4l2Device *device)>;
+
+/*
+ * single thread epoll loop servicing many capture devices and udev hotplug
+ */
+class V4l2Reactor final {
+public:
+    V4l2Reactor();
+    ~V4l2Reactor();
+
+    V4l2Reactor(const V4l2Reactor &) = delete;
+    void operator=(const V4l2Reactor &) = delete;
+    /*
+    * add a streaming context, callback is called for every dequeued frame
+    * (E_BUSY_ERR while its capture thread or decode pool runs; until it is
+    * removed, neither of them can be started on it)
+    */
+    int add_context(V4L2Context *context, const V4L2FrameCallback &callback);
+    /*
+    * remove a context (call from the reactor thread or while it is not running)
+    */
+    int remove_context(V4L2Context *context);
+    /*
+    * watch the device list udev monitor for hotplug events
+    */
+    int watch_device_list(V4l2Device *device, const V4L2DeviceListCallback &callback);
+    /*
+    * wait for events and dispatch them
+    * return: number of frames dispatched or error code
+    */
+    int run_once(int timeout_ms);
+    /*
+    * dispatch events until stop() is called (a stopped reactor stays stopped)
+    */
+    void run();
+    /*
+    * ask run() to return, or not to start if it is not running yet (thread safe)
+    */
+    void stop();
+private:
+    struct Source {
+        V4L2Context *context;
+        V4L2FrameCallback callback;
+    };
+private:
+    int _epoll_fd;               // epoll set of device, udev and wake fds
+    int _wake_fd;                // eventfd used by stop() to wake epoll_wait
+    std::atomic<bool> _running;  // run() keeps dispatching while set (cleared by stop())
+    std::unordered_map<int, std::shared_ptr<Source>> _sources;  // capture sources by device fd
+    V4l2Device *_device = NULL;                    // watched device list (if any)
+    V4L2DeviceListCallback _device_list_callback;  // called when the device list changes
+};
+
+}  // namespace uvc
\ No newline at end of file
@@ -1,9 +1,13 @@
 #include "v4l2_util.h"
 
 #include <base/log.h>
-#include <libv4l2.h>
 #include <string.h>
-#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "v4l2_backend.h"
+#include "v4l2_context.h"
+#include "v4l2_ioctl_stats.h"
 
 namespace uvc {
 
@@ -14,6 +18,56 @@ bool disable_libv4l2 = false;
  */
 #define IOCTL_RETRY 4
 
+/*
+ * first backoff delay after a timed out ioctl (doubles on every retry)
+ */
+#define IOCTL_BACKOFF_US 1000
+
+void ioctl_retry_backoff(int error, uint32_t retry) {
+    /*a timed out usb transfer needs the device to settle, EINTR can retry at once*/
+    if (error == ETIMEDOUT || error == EIO) {
+        usleep(IOCTL_BACKOFF_US << retry);
+    }
+}
+
+/*
+ * ioctl with a number of retries in the case of I/O failure
+ * args:
+ *   fd - device descriptor
+ *   IOCTL_X - ioctl reference
+ *   arg - pointer to ioctl data
+ *   backend - device backend
+ *
+ * notes:
+ *   EAGAIN is not retried: on the non blocking fd it means "no data yet"
+ *   (e.g. VIDIOC_DQBUF), which the callers handle
+ *
+ * returns - ioctl result
+ */
+static int retry_ioctl(int fd, int IOCTL_X, void *arg, V4L2Backend *backend) {
+    uint64_t begin = ioctl_stats_begin();
+    uint32_t retries = 0;
+    int ret = 0;
+    while (true) {
+        ret = backend->ioctl(fd, IOCTL_X, arg);
+        if (ret == 0 || (errno != EINTR && errno != ETIMEDOUT)) {
+            break;
+        }
+        if (retries == IOCTL_RETRY) {
+            int error = errno;
+            base::LogError() << "ioctl (" << ioctl_name(IOCTL_X) << ") retried " << IOCTL_RETRY
+                             << " times - giving up:" << strerror(error);
+            errno = error;
+            break;
+        }
+        ioctl_retry_backoff(errno, retries);
+        retries++;
+    }
+
+    record_ioctl(IOCTL_X, begin, retries, ret);
+    return (ret);
+}
+
 /*
  * ioctl with a number of retries in the case of I/O failure
  * args:
@@ -27,21 +81,42 @@ bool disable_libv4l2 = false;
  * returns - ioctl result
  */
 int xioctl(int fd, int IOCTL_X, void *arg) {
-    int ret = 0;
-    int tries = IOCTL_RETRY;
-    do {
-        if (!disable_libv4l2) {
-            ret = v4l2_ioctl(fd, IOCTL_X, arg);
-        } else {
-            ret = ioctl(fd, IOCTL_X, arg);
-        }
-    } while (ret && tries-- && ((errno == EINTR) || (errno == EAGAIN) || (errno == ETIMEDOUT)));
+    return retry_ioctl(fd, IOCTL_X, arg, disable_libv4l2 ? direct_backend() : libv4l2_backend());
+}
 
-    if (ret && (tries <= 0))
-        base::LogError() << "ioctl (" << IOCTL_X << ") retried " << IOCTL_RETRY
-                         << " times - giving up:" << strerror(errno);
+int xioctl(V4L2Context *context, int IOCTL_X, void *arg) {
+    return retry_ioctl(context->fd, IOCTL_X, arg, context->backend);
+}
 
-    return (ret);
+int xopen(V4L2Context *context, int flags) {
+    return context->backend->open(context->videodevice.c_str(), flags);
+}
+
+int xclose(V4L2Context *context) {
+    return context->backend->close(context->fd);
+}
+
+void *xmmap(V4L2Context *context, size_t length, int64_t offset) {
+    return context->backend->mmap(length, PROT_READ | PROT_WRITE, MAP_SHARED, context->fd, offset);
+}
+
+int xmunmap(V4L2Context *context, void *start, size_t length) {
+    return context->backend->munmap(start, length);
+}
+
+ssize_t xread(V4L2Context *context, void *buffer, size_t size) {
+    return context->backend->read(context->fd, buffer, size);
+}
+
+int xpoll(V4L2Context *context, short events, int timeout_ms, short *revents) {
+    struct pollfd poll_fd;
+    poll_fd.fd = context->fd;
+    poll_fd.events = events;
+    poll_fd.revents = 0;
+
+    int ret = context->backend->poll(&poll_fd, 1, timeout_ms);
+    *revents = poll_fd.revents;
+    return ret;
 }
 
 }  // namespace uvc
\ No newline at end of file
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
 namespace uvc {
 
+struct V4L2Context;
+
 /*
  * ioctl with a number of retries in the case of I/O failure
  * args:
@@ -16,4 +22,97 @@ namespace uvc {
  */
 int xioctl(int fd, int IOCTL_X, void *arg);
 
+/*
+ * ioctl on the context device with a number of retries in the case of I/O failure
+ * args:
+ *   context - pointer to V4L2Context
+ *   IOCTL_X - ioctl reference
+ *   arg - pointer to ioctl data
+ *
+ * notes:
+ *   goes through the context backend (libv4l2, direct or the one given
+ *   in V4L2InitOptions::backend), like the other context wrappers below
+ *
+ * returns - ioctl result
+ */
+int xioctl(V4L2Context *context, int IOCTL_X, void *arg);
+
+/*
+ * wait before retrying a failed ioctl
+ * args:
+ *   error - errno of the failed attempt
+ *   retry - number of attempts already retried
+ *
+ * notes:
+ *   timed out (ETIMEDOUT, EIO) usb transfers back off exponentially,
+ *   other errors are retried at once
+ *
+ * returns: void
+ */
+void ioctl_retry_backoff(int error, uint32_t retry);
+
+/*
+ * open the context device (context->videodevice)
+ * args:
+ *   context - pointer to V4L2Context
+ *   flags - open flags
+ *
+ * returns: device descriptor (or -1 on error)
+ */
+int xopen(V4L2Context *context, int flags);
+
+/*
+ * close the context device
+ * args:
+ *   context - pointer to V4L2Context
+ *
+ * returns: close result
+ */
+int xclose(V4L2Context *context);
+
+/*
+ * map a driver buffer of the context device (read/write, shared)
+ * args:
+ *   context - pointer to V4L2Context
+ *   length - buffer length
+ *   offset - buffer offset (from VIDIOC_QUERYBUF)
+ *
+ * returns: pointer to the mapped buffer (or MAP_FAILED on error)
+ */
+void *xmmap(V4L2Context *context, size_t length, int64_t offset);
+
+/*
+ * unmap a driver buffer of the context device
+ * args:
+ *   context - pointer to V4L2Context
+ *   start - pointer to the mapped buffer
+ *   length - buffer length
+ *
+ * returns: munmap result
+ */
+int xmunmap(V4L2Context *context, void *start, size_t length);
+
+/*
+ * read a frame from the context device (read i/o)
+ * args:
+ *   context - pointer to V4L2Context
+ *   buffer - pointer to the frame buffer
+ *   size - buffer size
+ *
+ * returns: number of bytes read (or -1 on error)
+ */
+ssize_t xread(V4L2Context *context, void *buffer, size_t size);
+
+/*
+ * wait for an event on the context device
+ * args:
+ *   context - pointer to V4L2Context
+ *   events - poll events to wait for (e.g. POLLIN)
+ *   timeout_ms - timeout in ms (-1 - no timeout)
+ *   revents - pointer to the returned events
+ *
+ * returns: poll result (1 - event, 0 - timeout, -1 - error)
+ */
+int xpoll(V4L2Context *context, short events, int timeout_ms, short *revents);
+
 }  // namespace uvc
\ No newline at end of file